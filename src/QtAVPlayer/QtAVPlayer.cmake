@@ -41,6 +41,15 @@ set(QtAVPlayer_PRIVATE_HEADERS
     ${QT_AVPLAYER_DIR}/qavvideobuffer_p.h
     ${QT_AVPLAYER_DIR}/qavvideobuffer_cpu_p.h
     ${QT_AVPLAYER_DIR}/qavvideobuffer_gpu_p.h
+    ${QT_AVPLAYER_DIR}/qavvideoframepool_p.h
+    ${QT_AVPLAYER_DIR}/qavvideoframering_p.h
+    ${QT_AVPLAYER_DIR}/qavtimestretch_p.h
+    ${QT_AVPLAYER_DIR}/qavaudiomixer_p.h
+    ${QT_AVPLAYER_DIR}/qavreadaheadcache_p.h
+    ${QT_AVPLAYER_DIR}/qavpushdevice_p.h
+    ${QT_AVPLAYER_DIR}/qavtimeshiftbuffer_p.h
+    ${QT_AVPLAYER_DIR}/qavrecorder_p.h
+    ${QT_AVPLAYER_DIR}/qavseekindex_p.h
     ${QT_AVPLAYER_DIR}/qavfilter_p.h
     ${QT_AVPLAYER_DIR}/qavfilter_p_p.h
     ${QT_AVPLAYER_DIR}/qavvideofilter_p.h
@@ -61,12 +70,18 @@ set(QtAVPlayer_PUBLIC_HEADERS
     ${QT_AVPLAYER_DIR}/qavstreamframe.h
     ${QT_AVPLAYER_DIR}/qavframe.h
     ${QT_AVPLAYER_DIR}/qavvideoframe.h
+    ${QT_AVPLAYER_DIR}/qavvideoframeallocator.h
+    ${QT_AVPLAYER_DIR}/qavvideoframeexporter.h
+    ${QT_AVPLAYER_DIR}/qavvideoframeimporter.h
     ${QT_AVPLAYER_DIR}/qavaudioframe.h
     ${QT_AVPLAYER_DIR}/qavsubtitleframe.h
     ${QT_AVPLAYER_DIR}/qtavplayerglobal.h
     ${QT_AVPLAYER_DIR}/qavstream.h
     ${QT_AVPLAYER_DIR}/qavplayer.h
     ${QT_AVPLAYER_DIR}/qavaudioconverter.h
+    ${QT_AVPLAYER_DIR}/qavaudiometer.h
+    ${QT_AVPLAYER_DIR}/qavaudiowaveform.h
+    ${QT_AVPLAYER_DIR}/qavsegmentdecoder.h
 )
 
 set(QtAVPlayer_SOURCES
@@ -85,6 +100,11 @@ set(QtAVPlayer_SOURCES
     ${QT_AVPLAYER_DIR}/qavsubtitleframe.cpp
     ${QT_AVPLAYER_DIR}/qavvideobuffer_cpu.cpp
     ${QT_AVPLAYER_DIR}/qavvideobuffer_gpu.cpp
+    ${QT_AVPLAYER_DIR}/qavvideoframepool.cpp
+    ${QT_AVPLAYER_DIR}/qavvideoframeexporter.cpp
+    ${QT_AVPLAYER_DIR}/qavvideoframeimporter.cpp
+    ${QT_AVPLAYER_DIR}/qavtimestretch.cpp
+    ${QT_AVPLAYER_DIR}/qavaudiomixer.cpp
     ${QT_AVPLAYER_DIR}/qavfilter.cpp
     ${QT_AVPLAYER_DIR}/qavvideofilter.cpp
     ${QT_AVPLAYER_DIR}/qavaudiofilter.cpp
@@ -95,9 +115,17 @@ set(QtAVPlayer_SOURCES
     ${QT_AVPLAYER_DIR}/qavvideooutputfilter.cpp
     ${QT_AVPLAYER_DIR}/qavaudiooutputfilter.cpp
     ${QT_AVPLAYER_DIR}/qaviodevice.cpp
+    ${QT_AVPLAYER_DIR}/qavreadaheadcache.cpp
+    ${QT_AVPLAYER_DIR}/qavpushdevice.cpp
+    ${QT_AVPLAYER_DIR}/qavtimeshiftbuffer.cpp
+    ${QT_AVPLAYER_DIR}/qavrecorder.cpp
+    ${QT_AVPLAYER_DIR}/qavseekindex.cpp
     ${QT_AVPLAYER_DIR}/qavstream.cpp
     ${QT_AVPLAYER_DIR}/qavfilters.cpp
     ${QT_AVPLAYER_DIR}/qavaudioconverter.cpp
+    ${QT_AVPLAYER_DIR}/qavaudiometer.cpp
+    ${QT_AVPLAYER_DIR}/qavaudiowaveform.cpp
+    ${QT_AVPLAYER_DIR}/qavsegmentdecoder.cpp
 )
 
 if(WIN32)
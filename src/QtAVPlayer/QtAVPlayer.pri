@@ -18,6 +18,15 @@ PRIVATE_HEADERS += \
     $$PWD/qavvideobuffer_p.h \
     $$PWD/qavvideobuffer_cpu_p.h \
     $$PWD/qavvideobuffer_gpu_p.h \
+    $$PWD/qavvideoframepool_p.h \
+    $$PWD/qavvideoframering_p.h \
+    $$PWD/qavtimestretch_p.h \
+    $$PWD/qavaudiomixer_p.h \
+    $$PWD/qavreadaheadcache_p.h \
+    $$PWD/qavpushdevice_p.h \
+    $$PWD/qavtimeshiftbuffer_p.h \
+    $$PWD/qavrecorder_p.h \
+    $$PWD/qavseekindex_p.h \
     $$PWD/qavfilter_p.h \
     $$PWD/qavfilter_p_p.h \
     $$PWD/qavvideofilter_p.h \
@@ -37,12 +46,18 @@ PUBLIC_HEADERS += \
     $$PWD/qavstreamframe.h \
     $$PWD/qavframe.h \
     $$PWD/qavvideoframe.h \
+    $$PWD/qavvideoframeallocator.h \
+    $$PWD/qavvideoframeexporter.h \
+    $$PWD/qavvideoframeimporter.h \
     $$PWD/qavaudioframe.h \
     $$PWD/qavsubtitleframe.h \
     $$PWD/qtavplayerglobal.h \
     $$PWD/qavstream.h \
     $$PWD/qavplayer.h \
     $$PWD/qavaudioconverter.h \
+    $$PWD/qavaudiometer.h \
+    $$PWD/qavaudiowaveform.h \
+    $$PWD/qavsegmentdecoder.h \
 
 SOURCES += \
     $$PWD/qavplayer.cpp \
@@ -60,6 +75,11 @@ SOURCES += \
     $$PWD/qavsubtitleframe.cpp \
     $$PWD/qavvideobuffer_cpu.cpp \
     $$PWD/qavvideobuffer_gpu.cpp \
+    $$PWD/qavvideoframepool.cpp \
+    $$PWD/qavvideoframeexporter.cpp \
+    $$PWD/qavvideoframeimporter.cpp \
+    $$PWD/qavtimestretch.cpp \
+    $$PWD/qavaudiomixer.cpp \
     $$PWD/qavfilter.cpp \
     $$PWD/qavvideofilter.cpp \
     $$PWD/qavaudiofilter.cpp \
@@ -70,9 +90,17 @@ SOURCES += \
     $$PWD/qavvideooutputfilter.cpp \
     $$PWD/qavaudiooutputfilter.cpp \
     $$PWD/qaviodevice.cpp \
+    $$PWD/qavreadaheadcache.cpp \
+    $$PWD/qavpushdevice.cpp \
+    $$PWD/qavtimeshiftbuffer.cpp \
+    $$PWD/qavrecorder.cpp \
+    $$PWD/qavseekindex.cpp \
     $$PWD/qavstream.cpp \
     $$PWD/qavfilters.cpp \
     $$PWD/qavaudioconverter.cpp \
+    $$PWD/qavaudiometer.cpp \
+    $$PWD/qavaudiowaveform.cpp \
+    $$PWD/qavsegmentdecoder.cpp \
 
 contains(DEFINES, QT_AVPLAYER_MULTIMEDIA) {
     QT += multimedia
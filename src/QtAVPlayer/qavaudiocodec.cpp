@@ -7,7 +7,11 @@
 
 #include "qavaudiocodec_p.h"
 #include "qavcodec_p_p.h"
+#include "qavaudioconverter.h"
 #include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -15,10 +19,15 @@ extern "C" {
 
 QT_BEGIN_NAMESPACE
 
+// Resamplers kept per stream, e.g. for a few consumers in different formats
+static const size_t maxConverters = 4;
+
 QAVAudioCodec::QAVAudioCodec()
 {
 }
 
+QAVAudioCodec::~QAVAudioCodec() = default;
+
 QAVAudioFormat QAVAudioCodec::audioFormat() const
 {
     Q_D(const QAVCodec);
@@ -26,15 +35,7 @@ QAVAudioFormat QAVAudioCodec::audioFormat() const
     if (!d->avctx)
         return format;
 
-    auto fmt = AVSampleFormat(d->avctx->sample_fmt);
-    if (fmt == AV_SAMPLE_FMT_U8)
-        format.setSampleFormat(QAVAudioFormat::UInt8);
-    else if (fmt == AV_SAMPLE_FMT_S16)
-        format.setSampleFormat(QAVAudioFormat::Int16);
-    else if (fmt == AV_SAMPLE_FMT_S32)
-        format.setSampleFormat(QAVAudioFormat::Int32);
-    else if (fmt == AV_SAMPLE_FMT_FLT)
-        format.setSampleFormat(QAVAudioFormat::Float);
+    format.setSampleFormat(sampleFormat(d->avctx->sample_fmt));
 
     format.setSampleRate(d->avctx->sample_rate);
 #if LIBAVCODEC_VERSION_INT <= AV_VERSION_INT(59, 23, 0)
@@ -46,4 +47,65 @@ QAVAudioFormat QAVAudioCodec::audioFormat() const
     return format;
 }
 
+QAVAudioFormat::SampleFormat QAVAudioCodec::sampleFormat(int fmt)
+{
+    switch (fmt) {
+    case AV_SAMPLE_FMT_U8:
+        return QAVAudioFormat::UInt8;
+    case AV_SAMPLE_FMT_S16:
+        return QAVAudioFormat::Int16;
+    case AV_SAMPLE_FMT_S32:
+        return QAVAudioFormat::Int32;
+    case AV_SAMPLE_FMT_FLT:
+        return QAVAudioFormat::Float;
+    case AV_SAMPLE_FMT_S16P:
+        return QAVAudioFormat::Int16Planar;
+    case AV_SAMPLE_FMT_S32P:
+        return QAVAudioFormat::Int32Planar;
+    case AV_SAMPLE_FMT_FLTP:
+        return QAVAudioFormat::FloatPlanar;
+    default:
+        return QAVAudioFormat::Unknown;
+    }
+}
+
+QByteArray QAVAudioCodec::convert(const QAVAudioFrame &frame) const
+{
+    // In seconds, stretched and mixed frames of the stream use other time bases
+    const double pts = frame.pts();
+    const auto format = frame.format();
+    QMutexLocker locker(&m_converterMutex);
+    // Frames converted again or out of order would corrupt the resampler's state,
+    // the converter which the frame continues is used
+    auto found = m_converters.end();
+    for (auto it = m_converters.begin(); it != m_converters.end(); ++it) {
+        if (it->format != format || (!std::isnan(pts) && pts <= it->pts))
+            continue;
+        if (found == m_converters.end() || it->pts > found->pts)
+            found = it;
+    }
+
+    if (found == m_converters.end()) {
+        if (m_converters.size() >= maxConverters)
+            m_converters.erase(m_converters.begin());
+        m_converters.push_back({format, std::unique_ptr<QAVAudioConverter>(new QAVAudioConverter),
+                                -std::numeric_limits<double>::infinity()});
+    } else {
+        std::rotate(found, found + 1, m_converters.end());
+    }
+
+    auto &c = m_converters.back();
+    if (!std::isnan(pts))
+        c.pts = pts;
+    return c.converter->data(frame);
+}
+
+void QAVAudioCodec::flushBuffers()
+{
+    QAVFrameCodec::flushBuffers();
+    // Samples buffered by the resamplers belong to the position before the seek
+    QMutexLocker locker(&m_converterMutex);
+    m_converters.clear();
+}
+
 QT_END_NAMESPACE
@@ -21,17 +21,42 @@
 
 #include "qavframecodec_p.h"
 #include "qavaudioformat.h"
+#include <QMutex>
+#include <limits>
+#include <memory>
+#include <vector>
 
 QT_BEGIN_NAMESPACE
 
+class QAVAudioConverter;
+class QAVAudioFrame;
 class QAVAudioCodec : public QAVFrameCodec
 {
 public:
     QAVAudioCodec();
+    ~QAVAudioCodec();
     QAVAudioFormat audioFormat() const;
+    // Maps AVSampleFormat, returns Unknown if not supported
+    static QAVAudioFormat::SampleFormat sampleFormat(int fmt);
+
+    // Converts the frames of the stream reusing the resampler of the output format.
+    // Each consumer reading the frames in order, e.g. the audio output and the app, keeps its own resampler.
+    QByteArray convert(const QAVAudioFrame &frame) const;
+    void flushBuffers() override;
 
 private:
     Q_DISABLE_COPY(QAVAudioCodec)
+    struct Converter
+    {
+        QAVAudioFormat format;
+        std::unique_ptr<QAVAudioConverter> converter;
+        // Pts of the last converted frame in seconds
+        double pts = 0;
+    };
+
+    mutable QMutex m_converterMutex;
+    // The least recently used first
+    mutable std::vector<Converter> m_converters;
 };
 
 QT_END_NAMESPACE
@@ -6,6 +6,7 @@
  *********************************************************/
 
 #include "qavaudioconverter.h"
+#include <QVarLengthArray>
 #include <QDebug>
 
 extern "C" {
@@ -20,13 +21,19 @@ public:
     SwrContext *swr_ctx = nullptr;
 #if LIBAVUTIL_VERSION_INT <= AV_VERSION_INT(57, 23, 0)
     int64_t outChannelLayout = 0;
+    int64_t inChannelLayout = 0;
 #else
-    AVChannelLayout outChannelLayout;
+    AVChannelLayout outChannelLayout{};
+    AVChannelLayout inChannelLayout{};
 #endif
     AVSampleFormat outFormat = AV_SAMPLE_FMT_NONE;
     int outSampleRate = 0;
+    AVSampleFormat inFormat = AV_SAMPLE_FMT_NONE;
+    int inSampleRate = 0;
 
+    // Scratch buffer only grows, reused by all frames
     uint8_t *audioBuf = nullptr;
+    unsigned audioBufSize = 0;
 };
 
 QAVAudioConverter::QAVAudioConverter()
@@ -39,6 +46,10 @@ QAVAudioConverter::~QAVAudioConverter()
     Q_D(QAVAudioConverter);
     swr_free(&d->swr_ctx);
     av_freep(&d->audioBuf);
+#if LIBAVUTIL_VERSION_INT > AV_VERSION_INT(57, 23, 0)
+    av_channel_layout_uninit(&d->outChannelLayout);
+    av_channel_layout_uninit(&d->inChannelLayout);
+#endif
 }
 
 QByteArray QAVAudioConverter::data(const QAVAudioFrame &audioFrame)
@@ -72,84 +83,132 @@ QByteArray QAVAudioConverter::data(const QAVAudioFrame &audioFrame)
     case QAVAudioFormat::Float:
         outFormat = AV_SAMPLE_FMT_FLT;
         break;
+    case QAVAudioFormat::Int16Planar:
+        outFormat = AV_SAMPLE_FMT_S16P;
+        break;
+    case QAVAudioFormat::Int32Planar:
+        outFormat = AV_SAMPLE_FMT_S32P;
+        break;
+    case QAVAudioFormat::FloatPlanar:
+        outFormat = AV_SAMPLE_FMT_FLTP;
+        break;
     default:
         qWarning() << "Could not negotiate output format:" << fmt.sampleFormat();
         return {};
     }
 
+    const AVSampleFormat inFormat = AVSampleFormat(frame->format);
 #if LIBAVUTIL_VERSION_INT <= AV_VERSION_INT(57, 23, 0)
     int64_t channelLayout = (frame->channel_layout && frame->channels == av_get_channel_layout_nb_channels(frame->channel_layout))
         ? frame->channel_layout
         : av_get_default_channel_layout(frame->channels);
-    bool needsConvert = frame->format != outFormat || channelLayout != outChannelLayout || frame->sample_rate != d->outSampleRate;
+    bool needsConvert = inFormat != outFormat || channelLayout != outChannelLayout || frame->sample_rate != outSampleRate;
+    bool needsCtxChange = outFormat != d->outFormat || outSampleRate != d->outSampleRate
+        || outChannelLayout != d->outChannelLayout || inFormat != d->inFormat
+        || frame->sample_rate != d->inSampleRate || channelLayout != d->inChannelLayout;
 #else
     AVChannelLayout channelLayout = frame->ch_layout;
-    bool needsConvert = frame->format != outFormat || av_channel_layout_compare(&channelLayout, &outChannelLayout) || frame->sample_rate != outSampleRate;
+    bool needsConvert = inFormat != outFormat || av_channel_layout_compare(&channelLayout, &outChannelLayout) || frame->sample_rate != outSampleRate;
+    bool needsCtxChange = outFormat != d->outFormat || outSampleRate != d->outSampleRate
+        || av_channel_layout_compare(&outChannelLayout, &d->outChannelLayout) || inFormat != d->inFormat
+        || frame->sample_rate != d->inSampleRate || av_channel_layout_compare(&channelLayout, &d->inChannelLayout);
 #endif
 
-    if (needsConvert) {
-        bool needsCtxChange = outFormat != d->outFormat || outSampleRate != d->outSampleRate ||
-#if LIBAVUTIL_VERSION_INT <= AV_VERSION_INT(57, 23, 0)
-            outChannelLayout != d->outChannelLayout;
+    // The context is kept while the formats are the same to carry the resampler's state between frames
+    if (!needsConvert) {
+        swr_free(&d->swr_ctx);
+    } else if (needsCtxChange || !d->swr_ctx) {
+        swr_free(&d->swr_ctx);
+#if LIBSWRESAMPLE_VERSION_INT <= AV_VERSION_INT(4, 4, 0)
+        d->swr_ctx = swr_alloc_set_opts(nullptr,
+                                        outChannelLayout, outFormat, outSampleRate,
+                                        channelLayout, inFormat, frame->sample_rate,
+                                        0, nullptr);
 #else
-            av_channel_layout_compare(&outChannelLayout, &d->outChannelLayout);
+        swr_alloc_set_opts2(&d->swr_ctx,
+                            &outChannelLayout, outFormat, outSampleRate,
+                            &channelLayout, inFormat, frame->sample_rate,
+                            0, nullptr);
 #endif
-        if (needsCtxChange || !d->swr_ctx) {
+        int ret = d->swr_ctx ? swr_init(d->swr_ctx) : AVERROR(ENOMEM);
+        if (ret < 0) {
+            qWarning() << "Could not init SwrContext:" << ret;
             swr_free(&d->swr_ctx);
-#if LIBSWRESAMPLE_VERSION_INT <= AV_VERSION_INT(4, 4, 0)
-            d->swr_ctx = swr_alloc_set_opts(nullptr,
-                                            outChannelLayout, outFormat, outSampleRate,
-                                            channelLayout, AVSampleFormat(frame->format), frame->sample_rate,
-                                            0, nullptr);
+            return {};
+        }
+#if LIBAVUTIL_VERSION_INT <= AV_VERSION_INT(57, 23, 0)
+        d->outChannelLayout = outChannelLayout;
+        d->inChannelLayout = channelLayout;
 #else
-            swr_alloc_set_opts2(&d->swr_ctx,
-                                &outChannelLayout, outFormat, outSampleRate,
-                                &channelLayout, AVSampleFormat(frame->format), frame->sample_rate,
-                                0, nullptr);
+        av_channel_layout_uninit(&d->outChannelLayout);
+        av_channel_layout_copy(&d->outChannelLayout, &outChannelLayout);
+        av_channel_layout_uninit(&d->inChannelLayout);
+        av_channel_layout_copy(&d->inChannelLayout, &channelLayout);
 #endif
-            int ret = swr_init(d->swr_ctx);
-            if (!d->swr_ctx || ret < 0) {
-                qWarning() << "Could not init SwrContext:" << ret;
-                return {};
-            }
-            d->outChannelLayout = outChannelLayout;
-            d->outFormat = outFormat;
-            d->outSampleRate = outSampleRate;
-        }
+        d->outFormat = outFormat;
+        d->outSampleRate = outSampleRate;
+        d->inFormat = inFormat;
+        d->inSampleRate = frame->sample_rate;
     }
 
     if (d->swr_ctx) {
         const uint8_t **in = (const uint8_t **)frame->extended_data;
-        int outCount = (int64_t)frame->nb_samples * outSampleRate / frame->sample_rate + 256;
-        int outSize = av_samples_get_buffer_size(nullptr, fmt.channelCount(), outCount, outFormat, 0);
+        // Includes the samples buffered by the resampler from previous frames
+        int outCount = swr_get_out_samples(d->swr_ctx, frame->nb_samples);
+        if (outCount < 0)
+            outCount = (int64_t)frame->nb_samples * outSampleRate / frame->sample_rate + 256;
+        const int channels = fmt.channelCount();
+        int outSize = av_samples_get_buffer_size(nullptr, channels, outCount, outFormat, 1);
+        if (outSize < 0) {
+            qWarning() << "Could not get buffer size:" << outSize;
+            return {};
+        }
 
-        av_freep(&d->audioBuf);
-        uint8_t **out = &d->audioBuf;
-        unsigned bufSize = 0;
-        av_fast_malloc(&d->audioBuf, &bufSize, outSize);
+        av_fast_malloc(&d->audioBuf, &d->audioBufSize, outSize);
+        if (!d->audioBuf) {
+            d->audioBufSize = 0;
+            return {};
+        }
 
-        int samples = swr_convert(d->swr_ctx, out, outCount, in, frame->nb_samples);
+        QVarLengthArray<uint8_t *, 8> out(channels);
+        av_samples_fill_arrays(out.data(), nullptr, d->audioBuf, channels, outCount, outFormat, 1);
+        int samples = swr_convert(d->swr_ctx, out.data(), outCount, in, frame->nb_samples);
         if (samples < 0) {
             qWarning() << "Could not convert audio samples";
             return {};
         }
 
-        int size = samples * fmt.channelCount() * av_get_bytes_per_sample(outFormat);
-        // Make deep copy
-        audioData = QByteArray((const char *)d->audioBuf, size);
+        const int bps = av_get_bytes_per_sample(outFormat);
+        if (av_sample_fmt_is_planar(outFormat)) {
+            // Planes are spaced by outCount samples, pack them one after another
+            audioData.resize(samples * channels * bps);
+            for (int i = 0; i < channels; ++i)
+                memcpy(audioData.data() + i * samples * bps, out[i], samples * bps);
+        } else {
+            // Make deep copy
+            audioData = QByteArray((const char *)d->audioBuf, samples * channels * bps);
+        }
     } else {
-        int size = av_samples_get_buffer_size(nullptr,
 #if LIBAVUTIL_VERSION_INT <= AV_VERSION_INT(57, 23, 0)
-                                              frame->channels,
+        const int channels = frame->channels;
 #else
-                                              outChannelLayout.nb_channels,
+        const int channels = outChannelLayout.nb_channels;
 #endif
-                                              frame->nb_samples,
-                                              AVSampleFormat(frame->format), 1);
-        // Return data from the frame
-        audioData = QByteArray::fromRawData((const char *)frame->data[0], size);
+        if (av_sample_fmt_is_planar(AVSampleFormat(frame->format)) && channels > 1) {
+            const int planeSize = frame->nb_samples * av_get_bytes_per_sample(AVSampleFormat(frame->format));
+            audioData.resize(planeSize * channels);
+            for (int i = 0; i < channels; ++i)
+                memcpy(audioData.data() + i * planeSize, frame->extended_data[i], planeSize);
+        } else {
+            int size = av_samples_get_buffer_size(nullptr, channels, frame->nb_samples, AVSampleFormat(frame->format), 1);
+            // Return data from the frame
+            audioData = QByteArray::fromRawData((const char *)frame->data[0], size);
+        }
     }
 
+#if LIBAVUTIL_VERSION_INT > AV_VERSION_INT(57, 23, 0)
+    av_channel_layout_uninit(&outChannelLayout);
+#endif
     return audioData;
 }
 
@@ -21,12 +21,21 @@ public:
         UInt8,
         Int16,
         Int32,
-        Float
+        Float,
+        // Each channel is stored in its own plane, one after another
+        Int16Planar,
+        Int32Planar,
+        FloatPlanar
     };
 
     SampleFormat sampleFormat() const { return m_sampleFormat; }
     void setSampleFormat(SampleFormat f) { m_sampleFormat = f; }
 
+    bool isPlanar() const
+    {
+        return m_sampleFormat == Int16Planar || m_sampleFormat == Int32Planar || m_sampleFormat == FloatPlanar;
+    }
+
     int sampleRate() const { return m_sampleRate; }
     void setSampleRate(int sampleRate) { m_sampleRate = sampleRate; }
 
@@ -18,6 +18,7 @@ class QAVAudioFramePrivate : public QAVFramePrivate
 public:
     QAVAudioFormat outAudioFormat;
     QByteArray data;
+    QList<QAVAudioFormat::SampleFormat> preferredFormats;
 };
 
 QAVAudioFrame::QAVAudioFrame()
@@ -50,6 +51,7 @@ QAVAudioFrame &QAVAudioFrame::operator=(const QAVFrame &other)
     Q_D(QAVAudioFrame);
     QAVFrame::operator=(other);
     d->data.clear();
+    d->outAudioFormat = {};
 
     return *this;
 }
@@ -61,6 +63,7 @@ QAVAudioFrame &QAVAudioFrame::operator=(const QAVAudioFrame &other)
     auto rhs = reinterpret_cast<QAVAudioFramePrivate *>(other.d_ptr.get());
     d->outAudioFormat = rhs->outAudioFormat;
     d->data = rhs->data;
+    d->preferredFormats = rhs->preferredFormats;
 
     return *this;
 }
@@ -82,16 +85,30 @@ QAVAudioFormat QAVAudioFrame::format() const
     if (d->outAudioFormat)
         return d->outAudioFormat;
 
-    if (!d->stream)
-        return {};
-
-    auto c = audioCodec(d->stream.codec().data());
-    if (!c)
+    QAVAudioFormat format;
+    auto c = d->stream ? audioCodec(d->stream.codec().data()) : nullptr;
+    if (c) {
+        format = c->audioFormat();
+    } else if (d->frame && d->frame->sample_rate > 0) {
+        // Frames produced without a codec, e.g. mixed audio
+        format.setSampleRate(d->frame->sample_rate);
+#if LIBAVUTIL_VERSION_INT <= AV_VERSION_INT(57, 23, 0)
+        format.setChannelCount(d->frame->channels);
+#else
+        format.setChannelCount(d->frame->ch_layout.nb_channels);
+#endif
+    } else {
         return {};
+    }
 
-    auto format = c->audioFormat();
-    if (format.sampleFormat() != QAVAudioFormat::Int32)
+    // Filters might change the sample format
+    auto native = QAVAudioCodec::sampleFormat(d->frame->format);
+    if (d->preferredFormats.isEmpty())
         format.setSampleFormat(QAVAudioFormat::Int32);
+    else if (d->preferredFormats.contains(native))
+        format.setSampleFormat(native);
+    else
+        format.setSampleFormat(d->preferredFormats.first());
 
     return format;
 }
@@ -101,9 +118,29 @@ QByteArray QAVAudioFrame::data() const
     auto d = const_cast<QAVAudioFramePrivate *>(reinterpret_cast<QAVAudioFramePrivate *>(d_ptr.get()));
     if (d->data.isEmpty()) {
         d->outAudioFormat = format();
-        d->data = QAVAudioConverter().data(*this);
+        auto c = d->stream ? audioCodec(d->stream.codec().data()) : nullptr;
+        d->data = c ? c->convert(*this) : QAVAudioConverter().data(*this);
     }
     return d->data;
 }
 
+void QAVAudioFrame::setPreferredSampleFormats(const QList<QAVAudioFormat::SampleFormat> &formats)
+{
+    Q_D(QAVAudioFrame);
+    if (d->preferredFormats == formats)
+        return;
+
+    d->preferredFormats = formats;
+    // Frames created from the data keep their format
+    if (QAVFrame::operator bool()) {
+        d->data.clear();
+        d->outAudioFormat = {};
+    }
+}
+
+QList<QAVAudioFormat::SampleFormat> QAVAudioFrame::preferredSampleFormats() const
+{
+    return d_func()->preferredFormats;
+}
+
 QT_END_NAMESPACE
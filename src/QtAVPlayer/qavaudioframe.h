@@ -10,6 +10,7 @@
 
 #include <QtAVPlayer/qavframe.h>
 #include <QtAVPlayer/qavaudioformat.h>
+#include <QList>
 
 QT_BEGIN_NAMESPACE
 
@@ -29,6 +30,11 @@ public:
     QAVAudioFormat format() const;
     QByteArray data() const;
 
+    // Sample formats accepted by the consumer, the first one is used if the decoded format is not in the list.
+    // Matching frames are returned without conversion. Int32 is used if empty.
+    void setPreferredSampleFormats(const QList<QAVAudioFormat::SampleFormat> &formats);
+    QList<QAVAudioFormat::SampleFormat> preferredSampleFormats() const;
+
 private:
     Q_DECLARE_PRIVATE(QAVAudioFrame)
 };
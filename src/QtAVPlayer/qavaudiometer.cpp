@@ -0,0 +1,455 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavaudiometer.h"
+#include <QDebug>
+#include <cmath>
+#include <deque>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QAV_AUDIOMETER_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define QAV_AUDIOMETER_NEON
+#include <arm_neon.h>
+#endif
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/samplefmt.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+static const double pi = 3.14159265358979323846;
+// Gating block and the window of the momentary loudness
+static const double blockDuration = 0.1;
+static const int momentaryBlocks = 4;
+
+// Biquad in transposed direct form II
+struct Biquad
+{
+    double b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+    double z1 = 0, z2 = 0;
+
+    double process(double x)
+    {
+        const double y = b0 * x + z1;
+        z1 = b1 * x - a1 * y + z2;
+        z2 = b2 * x - a2 * y;
+        return y;
+    }
+};
+
+struct ChannelState
+{
+    float peak = 0;
+    double sum = 0;
+    // K-weighting filter
+    Biquad shelf;
+    Biquad highPass;
+};
+
+class QAVAudioMeterPrivate
+{
+public:
+    void setFormat(int format, int rate, int channels);
+
+    int format = -1;
+    int rate = 0;
+    int channels = 0;
+    std::vector<ChannelState> state;
+    qint64 samples = 0;
+    double pts = 0;
+    QAVStream stream;
+
+    bool loudness = false;
+    std::vector<double> weights;
+    double blockEnergy = 0;
+    int blockFill = 0;
+    std::deque<double> blocks;
+    std::vector<float> scratch;
+};
+
+void QAVAudioMeterPrivate::setFormat(int f, int r, int ch)
+{
+    format = f;
+    rate = r;
+    channels = ch;
+    state.assign(ch, {});
+    samples = 0;
+    blockEnergy = 0;
+    blockFill = 0;
+    blocks.clear();
+
+    // ITU-R BS.1770 K-weighting, the coefficients are derived for any sample rate
+    Biquad shelf;
+    {
+        const double f0 = 1681.974450955533;
+        const double gain = 3.999843853973347;
+        const double q = 0.7071752369554196;
+        const double k = std::tan(pi * f0 / r);
+        const double vh = std::pow(10.0, gain / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+        shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        shelf.b1 = 2.0 * (k * k - vh) / a0;
+        shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        shelf.a2 = (1.0 - k / q + k * k) / a0;
+    }
+    Biquad highPass;
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+        const double k = std::tan(pi * f0 / r);
+        const double a0 = 1.0 + k / q + k * k;
+        highPass.b0 = 1.0;
+        highPass.b1 = -2.0;
+        highPass.b2 = 1.0;
+        highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+        highPass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    // Channel weights of 5.1: LFE is excluded, surrounds are boosted
+    weights.assign(ch, 1.0);
+    for (auto &s : state) {
+        s.shelf = shelf;
+        s.highPass = highPass;
+    }
+    if (ch == 6) {
+        weights[3] = 0.0;
+        weights[4] = 1.41;
+        weights[5] = 1.41;
+    }
+}
+
+template <class T>
+static float toFloat(T v);
+template <> float toFloat(uint8_t v) { return (int(v) - 128) / 128.0f; }
+template <> float toFloat(int16_t v) { return v / 32768.0f; }
+template <> float toFloat(int32_t v) { return float(v / 2147483648.0); }
+template <> float toFloat(int64_t v) { return float(v / 9223372036854775808.0); }
+template <> float toFloat(float v) { return v; }
+template <> float toFloat(double v) { return float(v); }
+
+// Loads 4 samples converted to float
+#if defined(QAV_AUDIOMETER_SSE)
+static inline __m128 load4(const float *p)
+{
+    return _mm_loadu_ps(p);
+}
+
+static inline __m128 load4(const int16_t *p)
+{
+    const __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+    // Sign extended to 32 bits
+    const __m128i w = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    return _mm_mul_ps(_mm_cvtepi32_ps(w), _mm_set1_ps(1.0f / 32768.0f));
+}
+
+static inline __m128 load4(const int32_t *p)
+{
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / 2147483648.0f));
+}
+#elif defined(QAV_AUDIOMETER_NEON)
+static inline float32x4_t load4(const float *p)
+{
+    return vld1q_f32(p);
+}
+
+static inline float32x4_t load4(const int16_t *p)
+{
+    return vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vld1_s16(p))), 1.0f / 32768.0f);
+}
+
+static inline float32x4_t load4(const int32_t *p)
+{
+    return vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(p)), 1.0f / 2147483648.0f);
+}
+#endif
+
+// Peak and sum of squares of contiguous samples, lanes are the interleaved channels (1, 2 or 4)
+template <class T>
+static void measureLanes(const T *p, int count, int lanes, float *peak, double *sum)
+{
+    int i = 0;
+    float lanePeak[4] = {0, 0, 0, 0};
+    float laneSum[4] = {0, 0, 0, 0};
+#if defined(QAV_AUDIOMETER_SSE)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 vp = _mm_setzero_ps();
+    __m128 vs = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        const __m128 v = load4(p + i);
+        vp = _mm_max_ps(vp, _mm_andnot_ps(sign, v));
+        vs = _mm_add_ps(vs, _mm_mul_ps(v, v));
+    }
+    _mm_storeu_ps(lanePeak, vp);
+    _mm_storeu_ps(laneSum, vs);
+#elif defined(QAV_AUDIOMETER_NEON)
+    float32x4_t vp = vdupq_n_f32(0);
+    float32x4_t vs = vdupq_n_f32(0);
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t v = load4(p + i);
+        vp = vmaxq_f32(vp, vabsq_f32(v));
+        vs = vmlaq_f32(vs, v, v);
+    }
+    vst1q_f32(lanePeak, vp);
+    vst1q_f32(laneSum, vs);
+#endif
+    for (int l = 0; l < 4; ++l) {
+        const int ch = l % lanes;
+        peak[ch] = qMax(peak[ch], lanePeak[l]);
+        sum[ch] += laneSum[l];
+    }
+    for (; i < count; ++i) {
+        const int ch = i % lanes;
+        const float v = toFloat(p[i]);
+        peak[ch] = qMax(peak[ch], std::fabs(v));
+        sum[ch] += double(v) * v;
+    }
+}
+
+// Float, Int16 and Int32 samples are measured in 4 lanes, false if the format is not supported
+static bool measureVector(AVSampleFormat fmt, const uint8_t *data, int count, int lanes, float *peak, double *sum)
+{
+    switch (av_get_packed_sample_fmt(fmt)) {
+    case AV_SAMPLE_FMT_S16:
+        measureLanes(reinterpret_cast<const int16_t *>(data), count, lanes, peak, sum);
+        return true;
+    case AV_SAMPLE_FMT_S32:
+        measureLanes(reinterpret_cast<const int32_t *>(data), count, lanes, peak, sum);
+        return true;
+    case AV_SAMPLE_FMT_FLT:
+        measureLanes(reinterpret_cast<const float *>(data), count, lanes, peak, sum);
+        return true;
+    default:
+        return false;
+    }
+}
+
+template <class T>
+static void measureSamples(const uint8_t *data, int count, int stride, float &peak, double &sum)
+{
+    const T *p = reinterpret_cast<const T *>(data);
+    float pk = peak;
+    double s = 0;
+    for (int i = 0; i < count; ++i) {
+        const float v = toFloat(p[i * stride]);
+        pk = qMax(pk, std::fabs(v));
+        s += double(v) * v;
+    }
+    peak = pk;
+    sum += s;
+}
+
+template <class T>
+static void readSamples(const uint8_t *data, int count, int stride, float *out)
+{
+    const T *p = reinterpret_cast<const T *>(data);
+    for (int i = 0; i < count; ++i)
+        out[i] = toFloat(p[i * stride]);
+}
+
+using MeasureFn = void (*)(const uint8_t *, int, int, float &, double &);
+using ReadFn = void (*)(const uint8_t *, int, int, float *);
+
+static bool sampleFunctions(AVSampleFormat fmt, MeasureFn &m, ReadFn &r)
+{
+    switch (av_get_packed_sample_fmt(fmt)) {
+    case AV_SAMPLE_FMT_U8:
+        m = measureSamples<uint8_t>;
+        r = readSamples<uint8_t>;
+        return true;
+    case AV_SAMPLE_FMT_S16:
+        m = measureSamples<int16_t>;
+        r = readSamples<int16_t>;
+        return true;
+    case AV_SAMPLE_FMT_S32:
+        m = measureSamples<int32_t>;
+        r = readSamples<int32_t>;
+        return true;
+    case AV_SAMPLE_FMT_S64:
+        m = measureSamples<int64_t>;
+        r = readSamples<int64_t>;
+        return true;
+    case AV_SAMPLE_FMT_FLT:
+        m = measureSamples<float>;
+        r = readSamples<float>;
+        return true;
+    case AV_SAMPLE_FMT_DBL:
+        m = measureSamples<double>;
+        r = readSamples<double>;
+        return true;
+    default:
+        return false;
+    }
+}
+
+QAVAudioMeter::QAVAudioMeter()
+    : d_ptr(new QAVAudioMeterPrivate)
+{
+}
+
+QAVAudioMeter::~QAVAudioMeter() = default;
+
+bool QAVAudioMeter::isLoudnessEnabled() const
+{
+    return d_func()->loudness;
+}
+
+void QAVAudioMeter::setLoudnessEnabled(bool enabled)
+{
+    Q_D(QAVAudioMeter);
+    if (d->loudness == enabled)
+        return;
+    d->loudness = enabled;
+    d->blocks.clear();
+    d->blockEnergy = 0;
+    d->blockFill = 0;
+}
+
+void QAVAudioMeter::process(const QAVFrame &frame)
+{
+    Q_D(QAVAudioMeter);
+    const AVFrame *f = frame.frame();
+    if (!f || f->nb_samples <= 0 || f->sample_rate <= 0)
+        return;
+
+#if LIBAVUTIL_VERSION_INT <= AV_VERSION_INT(57, 23, 0)
+    const int channels = f->channels;
+#else
+    const int channels = f->ch_layout.nb_channels;
+#endif
+    const AVSampleFormat fmt = AVSampleFormat(f->format);
+    MeasureFn measureFn = nullptr;
+    ReadFn readFn = nullptr;
+    if (channels <= 0 || !sampleFunctions(fmt, measureFn, readFn)) {
+        qWarning() << "Could not measure audio format:" << f->format;
+        return;
+    }
+
+    if (fmt != d->format || f->sample_rate != d->rate || channels != d->channels)
+        d->setFormat(fmt, f->sample_rate, channels);
+
+    const bool planar = av_sample_fmt_is_planar(fmt);
+    const int n = f->nb_samples;
+    const int stride = planar ? 1 : channels;
+    auto plane = [&](int ch) {
+        const int bps = av_get_bytes_per_sample(fmt);
+        return planar ? f->extended_data[ch] : f->data[0] + ch * bps;
+    };
+
+    // Peak and RMS
+    std::vector<float> peak(channels);
+    std::vector<double> sum(channels);
+    for (int ch = 0; ch < channels; ++ch) {
+        peak[ch] = d->state[ch].peak;
+        sum[ch] = 0;
+    }
+    bool measured = false;
+    if (planar) {
+        measured = true;
+        for (int ch = 0; ch < channels && measured; ++ch)
+            measured = measureVector(fmt, f->extended_data[ch], n, 1, &peak[ch], &sum[ch]);
+    } else if (4 % channels == 0) {
+        measured = measureVector(fmt, f->data[0], n * channels, channels, peak.data(), sum.data());
+    }
+    if (!measured) {
+        for (int ch = 0; ch < channels; ++ch)
+            measureFn(plane(ch), n, stride, peak[ch], sum[ch]);
+    }
+    for (int ch = 0; ch < channels; ++ch) {
+        d->state[ch].peak = peak[ch];
+        d->state[ch].sum += sum[ch];
+    }
+
+    // Momentary loudness in 100 ms blocks
+    if (d->loudness) {
+        const int blockSize = qMax(1, int(d->rate * blockDuration));
+        d->scratch.resize(n);
+        int pos = 0;
+        while (pos < n) {
+            const int chunk = qMin(n - pos, blockSize - d->blockFill);
+            for (int ch = 0; ch < channels; ++ch) {
+                if (!d->weights[ch])
+                    continue;
+                const int bps = av_get_bytes_per_sample(fmt);
+                readFn(plane(ch) + size_t(pos) * stride * bps, chunk, stride, d->scratch.data());
+                auto &s = d->state[ch];
+                double e = 0;
+                for (int i = 0; i < chunk; ++i) {
+                    const double y = s.highPass.process(s.shelf.process(d->scratch[i]));
+                    e += y * y;
+                }
+                d->blockEnergy += d->weights[ch] * e;
+            }
+            d->blockFill += chunk;
+            pos += chunk;
+            if (d->blockFill == blockSize) {
+                d->blocks.push_back(d->blockEnergy / blockSize);
+                if (int(d->blocks.size()) > momentaryBlocks)
+                    d->blocks.pop_front();
+                d->blockEnergy = 0;
+                d->blockFill = 0;
+            }
+        }
+    }
+
+    d->samples += n;
+    d->pts = frame.pts();
+    d->stream = frame.stream();
+}
+
+double QAVAudioMeter::duration() const
+{
+    Q_D(const QAVAudioMeter);
+    return d->rate ? double(d->samples) / d->rate : 0.0;
+}
+
+QAVAudioLevels QAVAudioMeter::takeLevels()
+{
+    Q_D(QAVAudioMeter);
+    QAVAudioLevels levels;
+    levels.stream = d->stream;
+    levels.pts = d->pts;
+    for (auto &s : d->state) {
+        levels.peak.append(s.peak);
+        levels.rms.append(d->samples ? float(std::sqrt(s.sum / d->samples)) : 0.0f);
+        s.peak = 0;
+        s.sum = 0;
+    }
+
+    if (d->loudness && int(d->blocks.size()) == momentaryBlocks) {
+        double energy = 0;
+        for (double e : d->blocks)
+            energy += e;
+        energy /= momentaryBlocks;
+        levels.momentaryLoudness = energy > 0 ? -0.691 + 10.0 * std::log10(energy) : -HUGE_VAL;
+    }
+
+    d->samples = 0;
+    return levels;
+}
+
+void QAVAudioMeter::reset()
+{
+    Q_D(QAVAudioMeter);
+    d->format = -1;
+    d->rate = 0;
+    d->channels = 0;
+    d->state.clear();
+    d->samples = 0;
+    d->blocks.clear();
+    d->blockEnergy = 0;
+    d->blockFill = 0;
+}
+
+QT_END_NAMESPACE
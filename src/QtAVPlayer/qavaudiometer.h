@@ -0,0 +1,61 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVAUDIOMETER_H
+#define QAVAUDIOMETER_H
+
+#include <QtAVPlayer/qavframe.h>
+#include <QtAVPlayer/qavstream.h>
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <QList>
+#include <QtCore/qnumeric.h>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+// Levels of the audio since the previous measurement
+struct QAVAudioLevels
+{
+    QAVStream stream;
+    // Pts of the last measured frame
+    double pts = 0;
+    // Linear amplitude per channel, 1.0 is full scale
+    QList<float> peak;
+    QList<float> rms;
+    // EBU R128 momentary loudness over the last 400 ms in LUFS, NAN if disabled or not enough audio
+    double momentaryLoudness = qQNaN();
+};
+
+class QAVAudioMeterPrivate;
+// Measures decoded frames directly on the planes of AVFrame without conversion,
+// all packed and planar sample formats are supported.
+class QAVAudioMeter
+{
+public:
+    QAVAudioMeter();
+    ~QAVAudioMeter();
+
+    bool isLoudnessEnabled() const;
+    void setLoudnessEnabled(bool enabled);
+
+    void process(const QAVFrame &frame);
+    // Duration of the audio measured since the last takeLevels()
+    double duration() const;
+    QAVAudioLevels takeLevels();
+    void reset();
+
+private:
+    Q_DISABLE_COPY(QAVAudioMeter)
+    Q_DECLARE_PRIVATE(QAVAudioMeter)
+    std::unique_ptr<QAVAudioMeterPrivate> d_ptr;
+};
+
+Q_DECLARE_METATYPE(QAVAudioLevels)
+
+QT_END_NAMESPACE
+
+#endif
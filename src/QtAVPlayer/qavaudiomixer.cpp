@@ -0,0 +1,300 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavaudiomixer_p.h"
+#include <QDebug>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define QAV_AUDIOMIXER_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define QAV_AUDIOMIXER_NEON
+#include <arm_neon.h>
+#endif
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/frame.h>
+#include <libswresample/swresample.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+// Streams behind the others by more than this are mixed as silence
+static const double maxLatency = 0.5;
+// Pts jumps bigger than this restart the mixing, e.g. after seek
+static const double maxPtsGap = 1.0;
+// Gaps in a stream bigger than this are filled with silence
+static const double minSilence = 0.02;
+
+static int frameChannels(const AVFrame *frame)
+{
+#if LIBAVUTIL_VERSION_INT <= AV_VERSION_INT(57, 23, 0)
+    return frame->channels;
+#else
+    return frame->ch_layout.nb_channels;
+#endif
+}
+
+QAVAudioMixer::QAVAudioMixer() = default;
+
+QAVAudioMixer::~QAVAudioMixer()
+{
+    clearInputs();
+}
+
+void QAVAudioMixer::mix(float *dst, const float *src, int count, float gain)
+{
+    int i = 0;
+#if defined(QAV_AUDIOMIXER_SSE)
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+#elif defined(QAV_AUDIOMIXER_NEON)
+    const float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(dst + i, vmlaq_f32(vld1q_f32(dst + i), vld1q_f32(src + i), g));
+#endif
+    for (; i < count; ++i)
+        dst[i] += src[i] * gain;
+}
+
+void QAVAudioMixer::setStreams(const QList<QAVStream> &streams)
+{
+    m_streams.clear();
+    for (const auto &s : streams)
+        m_streams.append(s.index());
+
+    for (auto it = m_inputs.begin(); it != m_inputs.end();) {
+        if (!m_streams.contains(it->first)) {
+            swr_free(&it->second.swr);
+            it = m_inputs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void QAVAudioMixer::setGains(const QMap<int, double> &gains)
+{
+    m_gains = gains;
+}
+
+void QAVAudioMixer::clearInputs()
+{
+    for (auto &in : m_inputs)
+        swr_free(&in.second.swr);
+    m_inputs.clear();
+}
+
+void QAVAudioMixer::reset()
+{
+    clearInputs();
+    m_rate = 0;
+    m_channels = 0;
+    m_outStream = {};
+    m_startPts = 0;
+    m_started = false;
+    m_mixed = 0;
+}
+
+bool QAVAudioMixer::convert(Input &in, const AVFrame *frame, std::vector<float> &out)
+{
+    const int channels = frameChannels(frame);
+    if (!in.swr || in.inFormat != frame->format || in.inRate != frame->sample_rate || in.inChannels != channels) {
+        swr_free(&in.swr);
+#if LIBAVUTIL_VERSION_INT <= AV_VERSION_INT(57, 23, 0)
+        int64_t inLayout = (frame->channel_layout && av_get_channel_layout_nb_channels(frame->channel_layout) == channels)
+            ? frame->channel_layout
+            : av_get_default_channel_layout(channels);
+        int64_t outLayout = av_get_default_channel_layout(m_channels);
+#else
+        AVChannelLayout inLayout = frame->ch_layout;
+        AVChannelLayout outLayout;
+        av_channel_layout_default(&outLayout, m_channels);
+#endif
+#if LIBSWRESAMPLE_VERSION_INT <= AV_VERSION_INT(4, 4, 0)
+        in.swr = swr_alloc_set_opts(nullptr,
+                                    outLayout, AV_SAMPLE_FMT_FLT, m_rate,
+                                    inLayout, AVSampleFormat(frame->format), frame->sample_rate,
+                                    0, nullptr);
+#else
+        swr_alloc_set_opts2(&in.swr,
+                            &outLayout, AV_SAMPLE_FMT_FLT, m_rate,
+                            &inLayout, AVSampleFormat(frame->format), frame->sample_rate,
+                            0, nullptr);
+        av_channel_layout_uninit(&outLayout);
+#endif
+        int ret = in.swr ? swr_init(in.swr) : AVERROR(ENOMEM);
+        if (ret < 0) {
+            qWarning() << "Could not init SwrContext for mixing:" << ret;
+            swr_free(&in.swr);
+            return false;
+        }
+        in.inFormat = frame->format;
+        in.inRate = frame->sample_rate;
+        in.inChannels = channels;
+    }
+
+    int outCount = swr_get_out_samples(in.swr, frame->nb_samples);
+    if (outCount < 0)
+        outCount = int((int64_t)frame->nb_samples * m_rate / frame->sample_rate + 256);
+    out.resize(size_t(outCount) * m_channels);
+    uint8_t *dst = reinterpret_cast<uint8_t *>(out.data());
+    int samples = swr_convert(in.swr, &dst, outCount, (const uint8_t **)frame->extended_data, frame->nb_samples);
+    if (samples < 0) {
+        qWarning() << "Could not convert audio samples for mixing:" << samples;
+        return false;
+    }
+    out.resize(size_t(samples) * m_channels);
+    return true;
+}
+
+QList<QAVFrame> QAVAudioMixer::write(const QAVFrame &frame)
+{
+    const AVFrame *f = frame.frame();
+    if (!f || f->nb_samples <= 0 || f->sample_rate <= 0 || frameChannels(f) <= 0)
+        return {};
+
+    const int index = frame.stream().index();
+    if (!m_streams.isEmpty() && !m_streams.contains(index))
+        return {};
+
+    double pts = frame.pts();
+    auto it = m_inputs.find(index);
+    if (m_started && it != m_inputs.end() && it->second.aligned && !std::isnan(pts)) {
+        const double diff = pts - it->second.expectedPts;
+        if (diff < -maxPtsGap || diff > maxPtsGap) {
+            // Seeked, all streams are realigned
+            reset();
+            it = m_inputs.end();
+        }
+    }
+
+    if (!m_rate) {
+        m_rate = f->sample_rate;
+        m_channels = frameChannels(f);
+        m_outStream = frame.stream();
+    }
+
+    if (!m_started) {
+        m_startPts = std::isnan(pts) ? 0 : pts;
+        m_started = true;
+    }
+
+    auto &in = m_inputs[index];
+    if (!convert(in, f, m_converted))
+        return {};
+
+    const int ch = m_channels;
+    const qint64 target = std::isnan(pts) ? in.end(ch) : std::llround((pts - m_startPts) * m_rate);
+    if (!in.aligned) {
+        in.pos = target;
+        in.samples.clear();
+        in.aligned = true;
+    } else if (target - in.end(ch) > qint64(minSilence * m_rate)) {
+        in.samples.resize(size_t(target - in.pos) * ch, 0.0f);
+    }
+    in.samples.insert(in.samples.end(), m_converted.begin(), m_converted.end());
+    in.expectedPts = (std::isnan(pts) ? in.expectedPts : pts) + double(f->nb_samples) / f->sample_rate;
+
+    // Drop the samples which are too late
+    if (in.pos < m_mixed) {
+        const qint64 late = qMin(m_mixed - in.pos, qint64(in.samples.size() / ch));
+        in.samples.erase(in.samples.begin(), in.samples.begin() + size_t(late) * ch);
+        in.pos += late;
+        if (in.pos < m_mixed)
+            in.pos = m_mixed;
+    }
+
+    return take(false);
+}
+
+QList<QAVFrame> QAVAudioMixer::flush()
+{
+    return take(true);
+}
+
+QList<QAVFrame> QAVAudioMixer::take(bool force)
+{
+    if (!m_rate || m_inputs.empty())
+        return {};
+
+    const int ch = m_channels;
+    qint64 maxEnd = m_mixed;
+    for (const auto &in : m_inputs)
+        maxEnd = qMax(maxEnd, in.second.end(ch));
+
+    qint64 available = maxEnd;
+    if (!force) {
+        const qint64 latency = qint64(maxLatency * m_rate);
+        auto endOf = [&](int index) {
+            auto it = m_inputs.find(index);
+            const qint64 end = it != m_inputs.end() ? it->second.end(ch) : m_mixed;
+            return qMax(end, maxEnd - latency);
+        };
+        if (m_streams.isEmpty()) {
+            for (const auto &in : m_inputs)
+                available = qMin(available, endOf(in.first));
+        } else {
+            for (int index : m_streams)
+                available = qMin(available, endOf(index));
+        }
+    }
+
+    if (available <= m_mixed)
+        return {};
+
+    const qint64 frames = available - m_mixed;
+    m_out.assign(size_t(frames) * ch, 0.0f);
+    for (auto &it : m_inputs) {
+        auto &in = it.second;
+        const qint64 from = qMax(in.pos, m_mixed);
+        const qint64 to = qMin(in.end(ch), available);
+        if (to > from) {
+            const float gain = float(m_gains.value(it.first, 1.0));
+            mix(m_out.data() + (from - m_mixed) * ch,
+                in.samples.data() + (from - in.pos) * ch,
+                int((to - from) * ch),
+                gain);
+        }
+        if (to > in.pos) {
+            in.samples.erase(in.samples.begin(), in.samples.begin() + size_t(to - in.pos) * ch);
+            in.pos = to;
+        }
+        if (in.pos < available && in.samples.empty())
+            in.pos = available;
+    }
+
+    const double pts = m_startPts + double(m_mixed) / m_rate;
+    m_mixed = available;
+
+    QAVFrame out;
+    out.setStream(m_outStream);
+    auto dst = out.frame();
+    dst->format = AV_SAMPLE_FMT_FLT;
+    dst->sample_rate = m_rate;
+    dst->nb_samples = int(frames);
+#if LIBAVUTIL_VERSION_INT <= AV_VERSION_INT(57, 23, 0)
+    dst->channel_layout = av_get_default_channel_layout(ch);
+    dst->channels = ch;
+#else
+    av_channel_layout_default(&dst->ch_layout, ch);
+#endif
+    int ret = av_frame_get_buffer(dst, 0);
+    if (ret < 0) {
+        qWarning() << "Could not allocate mixed frame:" << ret;
+        return {};
+    }
+    memcpy(dst->data[0], m_out.data(), m_out.size() * sizeof(float));
+    out.setTimeBase({1, m_rate});
+    dst->pts = std::llround(pts * m_rate);
+    return {out};
+}
+
+QT_END_NAMESPACE
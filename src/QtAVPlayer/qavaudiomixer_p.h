@@ -0,0 +1,94 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVAUDIOMIXER_P_H
+#define QAVAUDIOMIXER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qavframe.h"
+#include "qavstream.h"
+#include <QList>
+#include <QMap>
+#include <map>
+#include <vector>
+
+struct SwrContext;
+
+QT_BEGIN_NAMESPACE
+
+// Mixes frames of several audio streams into one interleaved float stream.
+// The streams are aligned by pts on the timeline of the first frame,
+// all inputs are resampled to the sample rate and channels of the first stream.
+class QAVAudioMixer
+{
+public:
+    QAVAudioMixer();
+    ~QAVAudioMixer();
+
+    // Streams which are waited for before mixing, inputs of other streams are dropped
+    void setStreams(const QList<QAVStream> &streams);
+    // Linear gain per stream index, 1.0 by default
+    void setGains(const QMap<int, double> &gains);
+
+    // Returns the mixed frames which are ready, empty if other streams are needed
+    QList<QAVFrame> write(const QAVFrame &frame);
+    // Mixes everything buffered, e.g. at the end of media
+    QList<QAVFrame> flush();
+    void reset();
+
+    int sampleRate() const { return m_rate; }
+    int channels() const { return m_channels; }
+
+    // dst[i] += src[i] * gain
+    static void mix(float *dst, const float *src, int count, float gain);
+
+private:
+    struct Input
+    {
+        SwrContext *swr = nullptr;
+        int inFormat = -1;
+        int inRate = 0;
+        int inChannels = 0;
+        bool aligned = false;
+        // Position of the first buffered frame on the output timeline
+        qint64 pos = 0;
+        std::vector<float> samples;
+        double expectedPts = 0;
+        qint64 end(int channels) const { return pos + qint64(samples.size() / channels); }
+    };
+
+    bool convert(Input &in, const AVFrame *frame, std::vector<float> &out);
+    QList<QAVFrame> take(bool force);
+    void clearInputs();
+
+    int m_rate = 0;
+    int m_channels = 0;
+    QAVStream m_outStream;
+    double m_startPts = 0;
+    bool m_started = false;
+    // Frames already mixed
+    qint64 m_mixed = 0;
+    std::map<int, Input> m_inputs;
+    QList<int> m_streams;
+    QMap<int, double> m_gains;
+    std::vector<float> m_converted;
+    std::vector<float> m_out;
+};
+
+QT_END_NAMESPACE
+
+#endif
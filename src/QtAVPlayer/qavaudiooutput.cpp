@@ -13,6 +13,9 @@
 #include <QWaitCondition>
 #include <QCoreApplication>
 #include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+#include <cmath>
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 #include <QAudioOutput>
 #else
@@ -77,6 +80,32 @@ static QAudioFormat format(const QAVAudioFormat &from)
     return out;
 }
 
+// The ring keeps a few sink buffers to absorb decoding jitter
+static qint64 ringCapacity(int bufferSize)
+{
+    return qint64(qMax(bufferSize, 96000)) * 4;
+}
+
+// Enough to keep the whole latency of the format,
+// up to 8 float channels at 48 kHz are expected until the format is known
+static qint64 latencyCapacity(const QAudioFormat &fmt, int ms)
+{
+    if (!fmt.isValid())
+        return qint64(ms) * 48 * 8 * 4;
+    return fmt.bytesForDuration(qint64(ms) * 1000);
+}
+
+// The latency is split equally between the ring and the sink
+static qint64 sinkLatencyBytes(const QAudioFormat &fmt, int ms)
+{
+    return qMax<qint64>(fmt.bytesForDuration(qint64(ms) * 500), fmt.bytesPerFrame());
+}
+
+static qint64 ringLatencyBytes(const QAudioFormat &fmt, int ms)
+{
+    return qMax<qint64>(fmt.bytesForDuration(qint64(ms) * 1000) - sinkLatencyBytes(fmt, ms), fmt.bytesPerFrame());
+}
+
 class QAVAudioOutputPrivate : public QObject
 {
 public:
@@ -94,29 +123,162 @@ public:
     AudioOutput *audioOutput = nullptr;
     qreal volume = 1.0;
     int bufferSize = 0;
+    // Target latency in ms, 0 if the buffers are sized by bufferSize
+    int latency = 0;
 #if QT_VERSION >= QT_VERSION_CHECK(6, 4, 0)
     QAudioFormat::ChannelConfig channelConfig = QAudioFormat::ChannelConfigUnknown;
 #endif
 
+    // Sample formats supported by the device for the rate and channels
+    QList<QAVAudioFormat::SampleFormat> sampleFormats;
+    int sampleFormatsRate = 0;
+    int sampleFormatsChannels = 0;
+
     std::unique_ptr<QAVAudioOutputDevice> device;
     std::unique_ptr<QThread> audioThread;
-    AudioDevice defaultAudioDevice;
+    // Default output device, updated only on notifications
+    AudioDevice audioDevice;
+    bool audioDeviceValid = false;
+    bool audioDeviceChanged = false;
+    // Format of the current audioOutput
+    QAudioFormat outputFormat;
+    std::atomic_bool outputStopped {false};
+    std::atomic_bool resetPending {false};
+    // Polls the data buffered by the sink on the audio thread
+    QTimer *sinkTimer = nullptr;
     mutable QMutex mutex;
 
-    void resetIfNeeded(const QAudioFormat &fmt, int bsize, qreal v)
+    static AudioDevice defaultAudioDevice()
     {
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        return QAudioDeviceInfo::defaultOutputDevice();
+#else
+        return QMediaDevices::defaultAudioOutput();
+#endif
+    }
+
+    static bool isNull(const AudioDevice &dev)
+    {
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        const auto name = dev.deviceName();
+#else
+        const auto name = dev.description();
+#endif
+        return dev.isNull() || name.toLower() == QLatin1String("null audio device");
+    }
+
+    // Must be called with the locked mutex
+    const AudioDevice &currentAudioDevice()
+    {
+        if (!audioDeviceValid) {
+            audioDevice = defaultAudioDevice();
+            audioDeviceValid = true;
+        }
+        return audioDevice;
+    }
+
+    // Called on the audio thread when the list of devices is changed
+    void updateAudioDevice()
+    {
+        const auto dev = defaultAudioDevice();
         QMutexLocker locker(&mutex);
+        if (audioDeviceValid && dev == audioDevice)
+            return;
+
+        qDebug() << "Default audio device is changed";
+        audioDevice = dev;
+        audioDeviceValid = true;
+        audioDeviceChanged = true;
+        sampleFormatsRate = 0;
+        sampleFormatsChannels = 0;
+        if (audioOutput) {
+            const auto fmt = outputFormat;
+            const int bsize = latency > 0 ? int(sinkLatencyBytes(fmt, latency)) : bufferSize;
+            const qreal v = volume;
+            locker.unlock();
+            resetIfNeeded(fmt, bsize, v);
+        }
+    }
+
+    void watchAudioDevices()
+    {
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-        auto audioDevice = QAudioDeviceInfo::defaultOutputDevice();
-        auto deviceName = audioDevice.deviceName();
+        // No notifications in Qt 5, the default device is polled on the audio thread instead of play()
+        auto timer = new QTimer(this);
+        timer->setInterval(1000);
+        QObject::connect(timer, &QTimer::timeout, this, [this] { updateAudioDevice(); });
+        timer->start();
 #else
-        auto audioDevice = QMediaDevices::defaultAudioOutput();
-        auto deviceName = audioDevice.description();
+        auto devices = new QMediaDevices(this);
+        QObject::connect(devices, &QMediaDevices::audioOutputsChanged, this, [this] { updateAudioDevice(); });
 #endif
+    }
+
+    // Returns true if the output needs to be recreated, no devices are enumerated
+    bool needsReset(const QAudioFormat &fmt)
+    {
+        if (resetPending)
+            return false;
+
+        QMutexLocker locker(&mutex);
+        if (audioDeviceChanged)
+            return true;
+        if (isNull(currentAudioDevice()))
+            return false;
+        return !audioOutput || outputFormat != fmt || outputStopped;
+    }
+
+    // Data already read from the device but not played yet
+    void updateSinkBufferSize()
+    {
+        QMutexLocker locker(&mutex);
+        if (audioOutput)
+            device->setSinkBufferSize(qMax<qint64>(audioOutput->bufferSize() - audioOutput->bytesFree(), 0));
+    }
+
+    QList<QAVAudioFormat::SampleFormat> supportedSampleFormats(const QAVAudioFormat &fmt)
+    {
+        QMutexLocker locker(&mutex);
+        if (fmt.sampleRate() == sampleFormatsRate && fmt.channelCount() == sampleFormatsChannels)
+            return sampleFormats;
+
+        const auto &audioDevice = currentAudioDevice();
+        sampleFormats.clear();
+        // Float first to keep the precision if the decoded samples need to be converted
+        for (auto f : {QAVAudioFormat::Float, QAVAudioFormat::Int16, QAVAudioFormat::Int32, QAVAudioFormat::UInt8}) {
+            QAVAudioFormat out = fmt;
+            out.setSampleFormat(f);
+            if (audioDevice.isFormatSupported(format(out)))
+                sampleFormats.append(f);
+        }
+        if (sampleFormats.isEmpty())
+            sampleFormats.append(QAVAudioFormat::Int32);
+        sampleFormatsRate = fmt.sampleRate();
+        sampleFormatsChannels = fmt.channelCount();
+        return sampleFormats;
+    }
+
+    // Sizes the ring for the buffer size and the latency of the format, only while nothing reads it.
+    // Must be called with the locked mutex
+    void resizeRing(const QAudioFormat &fmt)
+    {
+        if (audioOutput)
+            return;
+        qint64 capacity = ringCapacity(bufferSize);
+        if (latency > 0)
+            capacity = qMax(capacity, latencyCapacity(fmt, latency));
+        device->setCapacity(capacity);
+    }
+
+    void resetIfNeeded(const QAudioFormat &fmt, int bsize, qreal v)
+    {
+        QMutexLocker locker(&mutex);
+        resetPending = false;
+        const auto dev = currentAudioDevice();
         if (!audioOutput
             || audioOutput->format() != fmt
             || audioOutput->state() == QAudio::StoppedState
-            || defaultAudioDevice != audioDevice)
+            || audioDeviceChanged)
         {
             if (QThread::currentThread() != audioThread.get()) {
                 qWarning() << "QAVAudioOutput initialization must be on the audio thread";
@@ -124,27 +286,49 @@ public:
             }
 
             if (audioOutput) {
+                QObject::disconnect(audioOutput, nullptr, this, nullptr);
                 audioOutput->stop();
                 audioOutput->deleteLater();
                 audioOutput = nullptr;
+                // play() must not wait for the data to be read until the new output is started
+                device->pause();
+                device->setSinkBufferSize(0);
+                if (sinkTimer)
+                    sinkTimer->stop();
             }
-            if (audioDevice.isNull() || deviceName.toLower() == QLatin1String("null audio device")) {
-                qDebug() << "Audio device is not supported:" << deviceName;
+            resizeRing(fmt);
+            Q_ASSERT(latency <= 0 || device->capacity() >= ringLatencyBytes(fmt, latency));
+            audioDeviceChanged = false;
+            if (isNull(dev)) {
+                qDebug() << "Audio device is not supported";
                 return;
             }
 
-            audioOutput = new AudioOutput(audioDevice, fmt);
+            audioOutput = new AudioOutput(dev, fmt);
             QObject::connect(audioThread.get(), &QThread::finished, audioOutput, [o=audioOutput] {
                 o->stop();
                 o->deleteLater();
             });
-            defaultAudioDevice = audioDevice;
+            QObject::connect(audioOutput, &AudioOutput::stateChanged, this, [this](QAudio::State state) {
+                outputStopped = state == QAudio::StoppedState;
+                if (outputStopped)
+                    device->pause();
+            });
+            outputFormat = fmt;
+            outputStopped = false;
             if (bsize > 0)
                 audioOutput->setBufferSize(bsize);
             audioOutput->setVolume(v);
             // Start sending the audio frames from the queue to render
             device->start();
             audioOutput->start(device.get());
+            device->setSinkBufferSize(qMax<qint64>(audioOutput->bufferSize() - audioOutput->bytesFree(), 0));
+            if (!sinkTimer) {
+                sinkTimer = new QTimer(this);
+                sinkTimer->setInterval(10);
+                QObject::connect(sinkTimer, &QTimer::timeout, this, [this] { updateSinkBufferSize(); });
+            }
+            sinkTimer->start();
         }
     }
 };
@@ -161,6 +345,7 @@ QAVAudioOutput::QAVAudioOutput(QObject *parent)
     d->device.reset(new QAVAudioOutputDevice);
     d->device->open(QIODevice::ReadOnly);
     d->audioThread->start();
+    QMetaObject::invokeMethod(d, [d] { d->watchAudioDevices(); });
 }
 
 QAVAudioOutput::~QAVAudioOutput()
@@ -192,8 +377,13 @@ void QAVAudioOutput::setBufferSize(int bytes)
     Q_D(QAVAudioOutput);
     QMutexLocker locker(&d->mutex);
     d->bufferSize = bytes;
-    if (d->bufferSize > 0 && d->audioOutput)
-        qWarning() << "QAVAudioOutput: Cannot set buffer size after audioOutput is started";
+    // readData() copies from the ring without locks, it is resized when the output is recreated
+    if (d->audioOutput) {
+        if (bytes > 0)
+            qWarning() << "QAVAudioOutput: Cannot set buffer size after audioOutput is started";
+        return;
+    }
+    d->resizeRing(d->outputFormat);
 }
 
 int QAVAudioOutput::bufferSize() const
@@ -203,6 +393,41 @@ int QAVAudioOutput::bufferSize() const
     return d->bufferSize;
 }
 
+void QAVAudioOutput::setLatency(int ms)
+{
+    Q_D(QAVAudioOutput);
+    QMutexLocker locker(&d->mutex);
+    d->latency = qMax(ms, 0);
+    if (d->latency == 0) {
+        d->device->setLimit(0);
+        return;
+    }
+
+    if (d->audioOutput) {
+        // The ring and the sink buffer are resized when the output is recreated
+        if (latencyCapacity(d->outputFormat, d->latency) > d->device->capacity())
+            qWarning() << "QAVAudioOutput: Cannot grow the queue after audioOutput is started";
+        if (d->outputFormat.isValid())
+            d->device->setLimit(ringLatencyBytes(d->outputFormat, d->latency));
+    } else {
+        d->resizeRing(d->outputFormat);
+    }
+}
+
+int QAVAudioOutput::latency() const
+{
+    Q_D(const QAVAudioOutput);
+    QMutexLocker locker(&d->mutex);
+    return d->latency;
+}
+
+int QAVAudioOutput::measuredLatency() const
+{
+    Q_D(const QAVAudioOutput);
+    const double latency = d->device->latency();
+    return std::isnan(latency) ? -1 : int(latency * 1000);
+}
+
 #if QT_VERSION >= QT_VERSION_CHECK(6, 4, 0)
 void QAVAudioOutput::setChannelConfig(QAudioFormat::ChannelConfig config)
 {
@@ -224,7 +449,10 @@ bool QAVAudioOutput::play(const QAVAudioFrame &frame)
     Q_D(QAVAudioOutput);
     if (!frame)
         return false;
-    auto fmt = format(frame.format());
+    // Decoded samples are sent without conversion if the device supports them
+    QAVAudioFrame f = frame;
+    f.setPreferredSampleFormats(d->supportedSampleFormats(frame.format()));
+    auto fmt = format(f.format());
     if (!fmt.isValid())
         return false;
 #if QT_VERSION >= QT_VERSION_CHECK(6, 4, 0)
@@ -233,19 +461,45 @@ bool QAVAudioOutput::play(const QAVAudioFrame &frame)
     if (QThread::currentThread() == d->audioThread.get()) {
         qCritical() << "QAVAudioOutput::play() must not be called on the audio thread";
     } else {
+        const int latency = d->latency;
         quint64 bufferSize = d->bufferSize ? qMin(d->bufferSize, 96000) : 96000;
-        if (d->device->bytesInQueue() >= bufferSize) {
+        if (latency > 0) {
+            // Only the part of the latency which is not buffered by the sink is queued
+            const qint64 ringBytes = ringLatencyBytes(fmt, latency);
+            if (ringBytes > d->device->capacity()) {
+                QMutexLocker locker(&d->mutex);
+                d->resizeRing(fmt);
+            }
+            d->device->setLimit(ringBytes);
+            // The ring is grown when the output is recreated, the queue must reach its size to do it
+            bufferSize = quint64(qMin(ringBytes, d->device->capacity()));
+        }
+        if (d->device->bytesInQueue() >= bufferSize && d->needsReset(fmt)) {
             // Reset the output on QAVAudioOutput's thread
+            d->resetPending = true;
             QMetaObject::invokeMethod(d, [fmt, d] {
-                d->resetIfNeeded(fmt, d->bufferSize, d->volume);
+                const int latency = d->latency;
+                d->resetIfNeeded(fmt, latency > 0 ? int(sinkLatencyBytes(fmt, latency)) : d->bufferSize, d->volume);
             });
         }
     }
     // Add frames on current thread
-    d->device->play(frame);
+    d->device->play(f);
     return true;
 }
 
+double QAVAudioOutput::playedPts() const
+{
+    Q_D(const QAVAudioOutput);
+    return d->device->playedPts();
+}
+
+quint64 QAVAudioOutput::underruns() const
+{
+    Q_D(const QAVAudioOutput);
+    return d->device->underruns();
+}
+
 void QAVAudioOutput::stop()
 {
     Q_D(QAVAudioOutput);
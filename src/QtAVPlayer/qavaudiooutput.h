@@ -28,6 +28,12 @@ public:
     qreal volume() const;
     void setBufferSize(int bytes);
     int bufferSize() const;
+    // Target latency in ms from play() until the audio is rendered, 0 to size the buffers by bufferSize().
+    // The queue and the sink buffer are sized from the negotiated format, the sink could round its buffer up.
+    void setLatency(int ms);
+    int latency() const;
+    // Latency in ms of the audio queued now including the sink buffer, -1 if unknown
+    int measuredLatency() const;
 #if QT_VERSION >= QT_VERSION_CHECK(6, 4, 0)
     void setChannelConfig(QAudioFormat::ChannelConfig);
     QAudioFormat::ChannelConfig channelConfig() const;
@@ -35,6 +41,12 @@ public:
 
     bool play(const QAVAudioFrame &frame);
 
+    // Number of times the sink requested more data than was decoded
+    quint64 underruns() const;
+    // Pts of the audio being played by the device now, accounts the queued data.
+    // Could be used as QAVPlayer::setMasterClock(). NAN if nothing is played.
+    double playedPts() const;
+
 public Q_SLOTS:
     // No audio should be rendered if stopped even if play() is called
     void stop();
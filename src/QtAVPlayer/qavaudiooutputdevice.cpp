@@ -6,26 +6,70 @@
  *********************************************************/
 
 #include "qavaudiooutputdevice.h"
-#include "qavaudioconverter.h"
 #include <QDebug>
 #include <QMutex>
 #include <QWaitCondition>
-#include <QThread>
+#include <atomic>
+#include <cmath>
+#include <algorithm>
+#include <deque>
 
 QT_BEGIN_NAMESPACE
 
+static const qint64 defaultCapacity = 96000 * 4;
+
+// Single producer single consumer ring: play() writes, readData() reads.
+// The positions only grow, the producer owns writePos and the consumer owns readPos.
 class QAVAudioOutputDevicePrivate
 {
 public:
-    QList<QByteArray> frames;
-    qint64 offset = 0;
-    quint64 bytes = 0;
-    QAVAudioConverter conv;
-    mutable QMutex mutex;
-    QWaitCondition cond;
-    bool quit = false;
+    std::unique_ptr<char[]> buffer{new char[defaultCapacity]};
+    std::atomic<qint64> capacity{defaultCapacity};
+    // Held by play() while writing, the ring is resized only when the producer waits or is idle
+    QMutex writeMutex;
+    // Woken by stop() and pause(), play() polls readPos while the ring is full
+    QWaitCondition consumed;
+    std::atomic<qint64> readPos{0};
+    std::atomic<qint64> writePos{0};
+    std::atomic<bool> quit{false};
+    std::atomic<bool> started{false};
+    std::atomic<char> silence{0};
+    std::atomic<quint64> underruns{0};
+    bool underrun = false;
+    // Max bytes queued in the ring, 0 to use the whole capacity
+    std::atomic<qint64> limit{0};
+    std::atomic<double> bytesPerSecond{0};
+
+    // Maps the positions in the ring to pts, not used by readData()
+    struct Segment
+    {
+        qint64 pos = 0;
+        double pts = 0;
+        double secondsPerByte = 0;
+    };
+    std::deque<Segment> segments;
+    mutable QMutex segmentsMutex;
+    std::atomic<qint64> sinkBytes{0};
 };
 
+static int bytesPerSample(QAVAudioFormat::SampleFormat fmt)
+{
+    switch (fmt) {
+    case QAVAudioFormat::UInt8:
+        return 1;
+    case QAVAudioFormat::Int16:
+    case QAVAudioFormat::Int16Planar:
+        return 2;
+    case QAVAudioFormat::Int32:
+    case QAVAudioFormat::Int32Planar:
+    case QAVAudioFormat::Float:
+    case QAVAudioFormat::FloatPlanar:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
 QAVAudioOutputDevice::QAVAudioOutputDevice(QObject *parent)
     : QIODevice(parent)
     , d_ptr(new QAVAudioOutputDevicePrivate)
@@ -43,73 +87,191 @@ qint64 QAVAudioOutputDevice::readData(char *data, qint64 len)
     if (!len)
         return 0;
 
-    QMutexLocker locker(&d->mutex);
-    qint64 bytesWritten = 0;
-    while (len && !d->quit) {
-        if (d->frames.isEmpty()) {
-            d->cond.wait(&d->mutex);
-            if (d->quit || d->frames.isEmpty())
-                break;
-        }
-
-        auto &sampleData = d->frames.front();
-        const int toWrite = qMin(sampleData.size() - d->offset, len);
-        memcpy(data, sampleData.constData() + d->offset, toWrite);
-        bytesWritten += toWrite;
-        data += toWrite;
-        len -= toWrite;
-        d->offset += toWrite;
-
-        if (d->offset >= sampleData.size()) {
-            d->offset = 0;
-            d->bytes -= sampleData.size();
-            d->frames.removeFirst();
-        }
-    }
-    if (d->quit) {
+    const qint64 writePos = d->writePos.load(std::memory_order_acquire);
+    const qint64 readPos = d->readPos.load(std::memory_order_relaxed);
+    if (d->quit.load(std::memory_order_relaxed)) {
+        // Drop everything that has not been rendered yet
+        d->readPos.store(writePos, std::memory_order_release);
         memset(data, 0, static_cast<size_t>(len));
-        bytesWritten = len;
+        return len;
     }
-    return bytesWritten;
+
+    const qint64 capacity = d->capacity.load(std::memory_order_relaxed);
+    const qint64 bytes = qMin(len, writePos - readPos);
+    const qint64 offset = readPos % capacity;
+    const qint64 head = qMin(bytes, capacity - offset);
+    memcpy(data, d->buffer.get() + offset, static_cast<size_t>(head));
+    memcpy(data + head, d->buffer.get(), static_cast<size_t>(bytes - head));
+    d->readPos.store(readPos + bytes, std::memory_order_release);
+
+    if (bytes < len) {
+        // Keep the sink running with silence instead of blocking the audio callback
+        memset(data + bytes, d->silence.load(std::memory_order_relaxed), static_cast<size_t>(len - bytes));
+        if (!d->underrun)
+            d->underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    d->underrun = bytes < len;
+    return len;
 }
 
 void QAVAudioOutputDevice::play(const QAVAudioFrame &frame)
 {
     Q_D(QAVAudioOutputDevice);
-    {
-        QMutexLocker locker(&d->mutex);
-        auto data = d->conv.data(frame);
-        d->bytes += data.size();
-        d->frames.push_back(std::move(data));
+    if (d->quit.load())
+        return;
+
+    // Converted without any lock, readData() is not affected by slow conversions
+    const auto data = frame.data();
+    const auto fmt = frame.format();
+    d->silence.store(fmt.sampleFormat() == QAVAudioFormat::UInt8 ? char(0x80) : 0, std::memory_order_relaxed);
+
+    const double pts = frame.pts();
+    const double bytesPerSecond = double(fmt.sampleRate()) * fmt.channelCount() * bytesPerSample(fmt.sampleFormat());
+    d->bytesPerSecond.store(bytesPerSecond, std::memory_order_relaxed);
+    if (!std::isnan(pts) && bytesPerSecond > 0 && frame.frame()) {
+        // Sample rate of the frame is changed by the player's speed
+        const double speed = frame.frame()->sample_rate > 0 ? double(frame.frame()->sample_rate) / fmt.sampleRate() : 1.0;
+        const qint64 played = d->readPos.load(std::memory_order_acquire) - d->sinkBytes.load(std::memory_order_relaxed);
+        QMutexLocker locker(&d->segmentsMutex);
+        while (d->segments.size() > 1 && d->segments[1].pos <= played)
+            d->segments.pop_front();
+        const qint64 pos = d->writePos.load(std::memory_order_relaxed);
+        double secondsPerByte = speed / bytesPerSecond;
+        if (!d->segments.empty()) {
+            // Time-stretched frames keep the sample rate, measure the speed from the pts instead
+            auto &prev = d->segments.back();
+            const double elapsed = pts - prev.pts;
+            if (pos > prev.pos && elapsed > 0 && elapsed < 1.0) {
+                prev.secondsPerByte = elapsed / (pos - prev.pos);
+                secondsPerByte = prev.secondsPerByte;
+            }
+        }
+        d->segments.push_back({pos, pts, secondsPerByte});
+    }
+
+    const char *src = data.constData();
+    qint64 len = data.size();
+    QMutexLocker locker(&d->writeMutex);
+    while (len > 0 && !d->quit.load()) {
+        const qint64 capacity = d->capacity.load(std::memory_order_relaxed);
+        const qint64 writePos = d->writePos.load(std::memory_order_relaxed);
+        const qint64 readPos = d->readPos.load(std::memory_order_acquire);
+        const qint64 limit = d->limit.load(std::memory_order_relaxed);
+        const qint64 space = (limit > 0 ? qMin(limit, capacity) : capacity) - (writePos - readPos);
+        if (space <= 0) {
+            // Nobody reads the data, e.g. no audio device or it has been destroyed
+            if (!d->started.load())
+                return;
+            // No wakeup from readData() to keep the audio callback free of locks
+            d->consumed.wait(&d->writeMutex, 2);
+            continue;
+        }
+
+        const qint64 bytes = qMin(len, space);
+        const qint64 offset = writePos % capacity;
+        const qint64 head = qMin(bytes, capacity - offset);
+        memcpy(d->buffer.get() + offset, src, static_cast<size_t>(head));
+        memcpy(d->buffer.get(), src + head, static_cast<size_t>(bytes - head));
+        d->writePos.store(writePos + bytes, std::memory_order_release);
+        src += bytes;
+        len -= bytes;
     }
-    d->cond.wakeAll();
 }
 
 void QAVAudioOutputDevice::start()
 {
     Q_D(QAVAudioOutputDevice);
-    {
-        QMutexLocker locker(&d->mutex);
-        d->quit = false;
-    }
-    d->cond.wakeAll();
+    d->quit = false;
+    d->started = true;
 }
 
 void QAVAudioOutputDevice::stop()
 {
     Q_D(QAVAudioOutputDevice);
-    {
-        QMutexLocker locker(&d->mutex);
-        d->quit = true;
-    }
-    d->cond.wakeAll();
+    d->quit = true;
+    d->consumed.wakeAll();
+}
+
+void QAVAudioOutputDevice::pause()
+{
+    Q_D(QAVAudioOutputDevice);
+    d->started = false;
+    d->consumed.wakeAll();
 }
 
 quint64 QAVAudioOutputDevice::bytesInQueue() const
 {
     Q_D(const QAVAudioOutputDevice);
-    QMutexLocker locker(&d->mutex);
-    return d->bytes;
+    return quint64(d->writePos.load(std::memory_order_acquire) - d->readPos.load(std::memory_order_acquire));
+}
+
+void QAVAudioOutputDevice::setCapacity(qint64 bytes)
+{
+    Q_D(QAVAudioOutputDevice);
+    // play() keeps the mutex while it writes, or releases it while waiting for free space
+    QMutexLocker locker(&d->writeMutex);
+    if (bytes <= 0 || bytes == d->capacity)
+        return;
+
+    d->buffer.reset(new char[bytes]);
+    d->capacity = bytes;
+    d->readPos = 0;
+    d->writePos = 0;
+    QMutexLocker segmentsLocker(&d->segmentsMutex);
+    d->segments.clear();
+}
+
+qint64 QAVAudioOutputDevice::capacity() const
+{
+    return d_func()->capacity.load(std::memory_order_relaxed);
+}
+
+void QAVAudioOutputDevice::setLimit(qint64 bytes)
+{
+    Q_D(QAVAudioOutputDevice);
+    d->limit.store(bytes, std::memory_order_relaxed);
+}
+
+qint64 QAVAudioOutputDevice::limit() const
+{
+    return d_func()->limit.load(std::memory_order_relaxed);
+}
+
+quint64 QAVAudioOutputDevice::underruns() const
+{
+    return d_func()->underruns.load(std::memory_order_relaxed);
+}
+
+void QAVAudioOutputDevice::setSinkBufferSize(qint64 bytes)
+{
+    Q_D(QAVAudioOutputDevice);
+    d->sinkBytes = bytes;
+}
+
+double QAVAudioOutputDevice::latency() const
+{
+    Q_D(const QAVAudioOutputDevice);
+    const double bytesPerSecond = d->bytesPerSecond.load(std::memory_order_relaxed);
+    if (bytesPerSecond <= 0)
+        return NAN;
+    const qint64 queued = d->writePos.load(std::memory_order_acquire) - d->readPos.load(std::memory_order_acquire);
+    return (qMax<qint64>(queued, 0) + d->sinkBytes.load(std::memory_order_relaxed)) / bytesPerSecond;
+}
+
+double QAVAudioOutputDevice::playedPts() const
+{
+    Q_D(const QAVAudioOutputDevice);
+    const qint64 readPos = d->readPos.load(std::memory_order_acquire);
+    // Silence is played on underruns
+    const qint64 pos = qMin(readPos, d->writePos.load(std::memory_order_acquire)) - d->sinkBytes.load(std::memory_order_relaxed);
+    QMutexLocker locker(&d->segmentsMutex);
+    if (d->segments.empty() || pos < d->segments.front().pos)
+        return NAN;
+
+    auto it = std::upper_bound(d->segments.begin(), d->segments.end(), pos,
+                               [](qint64 p, const QAVAudioOutputDevicePrivate::Segment &s) { return p < s.pos; });
+    const auto &segment = *std::prev(it);
+    return segment.pts + (pos - segment.pos) * segment.secondsPerByte;
 }
 
 QT_END_NAMESPACE
@@ -30,14 +30,34 @@ public:
     bool isSequential() const override { return false; }
     bool atEnd() const override { return false; }
 
-    // Enqueues the audio frame to be sent from readData()
+    // Converts the audio frame and writes it to the ring to be sent from readData().
+    // Must be called from one thread only, waits while the ring is full and the data is being read.
     void play(const QAVAudioFrame &frame);
     // Start sending the audio data from readData()
     void start();
     // Don't send the audio data from readData()
     void stop();
+    // Nothing reads the data anymore, play() drops the data which does not fit instead of waiting
+    void pause();
     quint64 bytesInQueue() const;
 
+    // Size of the ring, drops the queued data. Must not be changed while readData() is running,
+    // waits until play() finishes writing or waits for free space.
+    void setCapacity(qint64 bytes);
+    qint64 capacity() const;
+    // Max bytes queued in the ring, could be changed any time. 0 to use the whole capacity.
+    void setLimit(qint64 bytes);
+    qint64 limit() const;
+    // Number of times readData() had not enough data and sent silence
+    quint64 underruns() const;
+
+    // Bytes already read from the device but still buffered by the sink, i.e. its buffer size minus bytesFree()
+    void setSinkBufferSize(qint64 bytes);
+    // Seconds from play() until the data is rendered by the sink, NAN if unknown
+    double latency() const;
+    // Pts of the sample being played now, NAN if unknown
+    double playedPts() const;
+
 protected:
     std::unique_ptr<QAVAudioOutputDevicePrivate> d_ptr;
 
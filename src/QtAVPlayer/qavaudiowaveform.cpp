@@ -0,0 +1,672 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavaudiowaveform.h"
+#include "qavdemuxer_p.h"
+#include "qavaudioframe.h"
+#include "qavaudioconverter.h"
+#include <QtConcurrent/qtconcurrentrun.h>
+#include <QThreadPool>
+#include <QThread>
+#include <QFuture>
+#include <QMutex>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include <QDataStream>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define QAV_WAVEFORM_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define QAV_WAVEFORM_NEON
+#include <arm_neon.h>
+#endif
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/samplefmt.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+static const quint32 cacheMagic = 0x51415657; // QAVW
+static const quint32 cacheVersion = 1;
+// Minimal interval between progress updates of a range
+static const int progressInterval = 100;
+// Shorter ranges are not worth opening another demuxer
+static const int minRangeDuration = 2;
+
+struct Accumulator
+{
+    float min = std::numeric_limits<float>::max();
+    float max = -std::numeric_limits<float>::max();
+    double sum = 0;
+    qint64 count = 0;
+
+    QAVAudioWaveformBucket bucket() const
+    {
+        QAVAudioWaveformBucket b;
+        if (count) {
+            b.min = min;
+            b.max = max;
+            b.rms = float(std::sqrt(sum / count));
+        }
+        return b;
+    }
+};
+
+// Min, max and sum of squares of the samples
+static void reduce(const float *p, int n, Accumulator &acc)
+{
+    int i = 0;
+    float mn = acc.min;
+    float mx = acc.max;
+    float s = 0;
+#if defined(QAV_WAVEFORM_SSE)
+    if (n >= 4) {
+        __m128 vmin = _mm_set1_ps(mn);
+        __m128 vmax = _mm_set1_ps(mx);
+        __m128 vsum = _mm_setzero_ps();
+        for (; i + 4 <= n; i += 4) {
+            const __m128 v = _mm_loadu_ps(p + i);
+            vmin = _mm_min_ps(vmin, v);
+            vmax = _mm_max_ps(vmax, v);
+            vsum = _mm_add_ps(vsum, _mm_mul_ps(v, v));
+        }
+        float tmin[4], tmax[4], tsum[4];
+        _mm_storeu_ps(tmin, vmin);
+        _mm_storeu_ps(tmax, vmax);
+        _mm_storeu_ps(tsum, vsum);
+        for (int l = 0; l < 4; ++l) {
+            mn = qMin(mn, tmin[l]);
+            mx = qMax(mx, tmax[l]);
+            s += tsum[l];
+        }
+    }
+#elif defined(QAV_WAVEFORM_NEON)
+    if (n >= 4) {
+        float32x4_t vmin = vdupq_n_f32(mn);
+        float32x4_t vmax = vdupq_n_f32(mx);
+        float32x4_t vsum = vdupq_n_f32(0);
+        for (; i + 4 <= n; i += 4) {
+            const float32x4_t v = vld1q_f32(p + i);
+            vmin = vminq_f32(vmin, v);
+            vmax = vmaxq_f32(vmax, v);
+            vsum = vmlaq_f32(vsum, v, v);
+        }
+        float tmin[4], tmax[4], tsum[4];
+        vst1q_f32(tmin, vmin);
+        vst1q_f32(tmax, vmax);
+        vst1q_f32(tsum, vsum);
+        for (int l = 0; l < 4; ++l) {
+            mn = qMin(mn, tmin[l]);
+            mx = qMax(mx, tmax[l]);
+            s += tsum[l];
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        mn = qMin(mn, p[i]);
+        mx = qMax(mx, p[i]);
+        s += p[i] * p[i];
+    }
+    acc.min = mn;
+    acc.max = mx;
+    acc.sum += s;
+    acc.count += n;
+}
+
+struct Range
+{
+    // Time of the bucket 0 and buckets per second
+    double origin = 0;
+    double bucketsPerSecond = 0;
+    double from = 0;
+    double to = 0;
+    // Index of acc[0]
+    qint64 first = 0;
+    // acc is extended if the audio is longer than expected
+    bool grow = false;
+};
+
+static bool findAudioStream(QAVDemuxer &demuxer, int index, QAVStream &stream)
+{
+    const auto streams = demuxer.availableAudioStreams();
+    if (index < 0) {
+        const auto current = demuxer.currentAudioStreams();
+        if (current.isEmpty())
+            return false;
+        stream = current.first();
+        return true;
+    }
+
+    for (const auto &s : streams) {
+        if (s.index() == index) {
+            stream = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Decodes the audio stream within the range and reduces the samples to acc.
+// done is called with the number of completed buckets.
+static bool decodeRange(
+    const QString &url,
+    int streamIndex,
+    const Range &range,
+    std::vector<Accumulator> &acc,
+    const std::atomic_bool &abort,
+    const std::function<void(qint64 done)> &done)
+{
+    QAVDemuxer demuxer;
+    int ret = demuxer.load(url);
+    if (ret < 0) {
+        qWarning() << "Could not load for waveform:" << url << ":" << ret;
+        return false;
+    }
+
+    QAVStream stream;
+    if (!findAudioStream(demuxer, streamIndex, stream)) {
+        qWarning() << "Could not find audio stream for waveform:" << streamIndex;
+        return false;
+    }
+    demuxer.setVideoStreams({});
+    demuxer.setSubtitleStreams({});
+    demuxer.setAudioStreams({stream});
+    demuxer.discardUnusedStreams();
+    if (range.from > 0 && demuxer.seek(range.from) < 0)
+        qWarning() << "Could not seek for waveform:" << range.from;
+
+    QAVAudioConverter converter;
+    QList<QAVFrame> frames;
+    double nextPts = NAN;
+    qint64 current = 0;
+    bool finished = false;
+    QElapsedTimer timer;
+    timer.start();
+
+    auto process = [&](const QAVFrame &frame) {
+        const AVFrame *f = frame.frame();
+        const int rate = f->sample_rate;
+        const int n = f->nb_samples;
+        if (rate <= 0 || n <= 0)
+            return;
+
+        double pts = frame.pts();
+        if (std::isnan(pts))
+            pts = std::isnan(nextPts) ? range.from : nextPts;
+        nextPts = pts + double(n) / rate;
+        if (pts >= range.to) {
+            finished = true;
+            return;
+        }
+
+#if LIBAVUTIL_VERSION_INT <= AV_VERSION_INT(57, 23, 0)
+        const int channels = f->channels;
+#else
+        const int channels = f->ch_layout.nb_channels;
+#endif
+        // Float planes are reduced in place, other formats are converted to interleaved float
+        std::vector<const float *> planes;
+        int stride = 1;
+        QByteArray converted;
+        switch (f->format) {
+        case AV_SAMPLE_FMT_FLTP:
+            for (int c = 0; c < channels; ++c)
+                planes.push_back(reinterpret_cast<const float *>(f->extended_data[c]));
+            break;
+        case AV_SAMPLE_FMT_FLT:
+            planes.push_back(reinterpret_cast<const float *>(f->data[0]));
+            stride = channels;
+            break;
+        default: {
+            QAVAudioFrame audio = frame;
+            audio.setPreferredSampleFormats({QAVAudioFormat::Float});
+            converted = converter.data(audio);
+            if (converted.size() < int(n * channels * sizeof(float)))
+                return;
+            planes.push_back(reinterpret_cast<const float *>(converted.constData()));
+            stride = channels;
+        } break;
+        }
+
+        const int begin = qMax(0, int(std::ceil((range.from - pts) * rate)));
+        const double last = std::ceil((range.to - pts) * rate);
+        const int end = last < n ? int(last) : n;
+        for (int i = begin; i < end;) {
+            const double t = pts + double(i) / rate;
+            const qint64 b = qint64(std::floor((t - range.origin) * range.bucketsPerSecond));
+            const double next = range.origin + double(b + 1) / range.bucketsPerSecond;
+            int j = qMin(end, int(std::ceil((next - pts) * rate)));
+            if (j <= i)
+                j = i + 1;
+
+            const qint64 k = b - range.first;
+            if (k >= 0 && range.grow && k >= qint64(acc.size()))
+                acc.resize(size_t(k + 1));
+            if (k >= 0 && k < qint64(acc.size())) {
+                for (auto p : planes)
+                    reduce(p + i * stride, (j - i) * stride, acc[size_t(k)]);
+                current = qMax(current, k);
+            }
+            i = j;
+        }
+
+        if (timer.elapsed() >= progressInterval) {
+            done(current);
+            timer.restart();
+        }
+    };
+
+    while (!abort && !finished) {
+        auto packet = demuxer.read();
+        if (!packet.stream())
+            break;
+        if (packet.packet()->stream_index != stream.index())
+            continue;
+        frames.clear();
+        demuxer.decode(packet, frames);
+        for (const auto &frame : frames)
+            process(frame);
+    }
+
+    if (!abort && !finished) {
+        // Drain the decoder
+        QAVPacket flush;
+        flush.setStream(stream);
+        frames.clear();
+        demuxer.decode(flush, frames);
+        for (const auto &frame : frames)
+            process(frame);
+    }
+
+    if (!abort)
+        done(qint64(acc.size()));
+    return !abort;
+}
+
+class QAVAudioWaveformPrivate
+{
+    Q_DECLARE_PUBLIC(QAVAudioWaveform)
+public:
+    QAVAudioWaveformPrivate(QAVAudioWaveform *q)
+        : q_ptr(q)
+    {
+    }
+
+    QString cachePath() const;
+    bool loadCache();
+    void saveCache() const;
+    void run();
+    void publish(const std::vector<Accumulator> &acc, qint64 first, qint64 from, qint64 to);
+
+    QAVAudioWaveform *q_ptr = nullptr;
+    QString url;
+    int streamIndex = -1;
+    int resolution = 100;
+    int threadCount = qMax(1, QThread::idealThreadCount());
+    QString cacheDir;
+
+    mutable QMutex mutex;
+    QVector<QAVAudioWaveformBucket> buckets;
+    double duration = 0;
+    bool finished = false;
+
+    std::atomic_bool abort {false};
+    QThreadPool threadPool;
+    QFuture<void> future;
+};
+
+QString QAVAudioWaveformPrivate::cachePath() const
+{
+    QFileInfo info(url);
+    if (cacheDir.isEmpty() || !info.exists())
+        return {};
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(info.absoluteFilePath().toUtf8());
+    hash.addData(QByteArray::number(info.size()));
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+    hash.addData(QByteArray::number(streamIndex));
+    hash.addData(QByteArray::number(resolution));
+    return QDir(cacheDir).filePath(QString::fromLatin1(hash.result().toHex()) + QLatin1String(".qavwave"));
+}
+
+bool QAVAudioWaveformPrivate::loadCache()
+{
+    const QString path = cachePath();
+    if (path.isEmpty())
+        return false;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    quint32 magic = 0;
+    quint32 version = 0;
+    double d = 0;
+    qint32 count = 0;
+    in >> magic >> version;
+    if (magic != cacheMagic || version != cacheVersion)
+        return false;
+    in.setFloatingPointPrecision(QDataStream::DoublePrecision);
+    in >> d;
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    in >> count;
+    if (in.status() != QDataStream::Ok || count < 0)
+        return false;
+
+    QVector<QAVAudioWaveformBucket> data(count);
+    for (auto &b : data)
+        in >> b.min >> b.max >> b.rms;
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    QMutexLocker locker(&mutex);
+    buckets = data;
+    duration = d;
+    return true;
+}
+
+void QAVAudioWaveformPrivate::saveCache() const
+{
+    const QString path = cachePath();
+    if (path.isEmpty())
+        return;
+
+    QDir().mkpath(cacheDir);
+    QFile file(path + QLatin1String(".tmp"));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write waveform cache:" << file.fileName();
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+    QDataStream out(&file);
+    out << cacheMagic << cacheVersion;
+    out.setFloatingPointPrecision(QDataStream::DoublePrecision);
+    out << duration;
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    out << qint32(buckets.size());
+    for (const auto &b : buckets)
+        out << b.min << b.max << b.rms;
+    locker.unlock();
+    file.close();
+
+    QFile::remove(path);
+    if (!QFile::rename(file.fileName(), path))
+        QFile::remove(file.fileName());
+}
+
+void QAVAudioWaveformPrivate::publish(const std::vector<Accumulator> &acc, qint64 first, qint64 from, qint64 to)
+{
+    if (to <= from)
+        return;
+    {
+        QMutexLocker locker(&mutex);
+        if (first + to > buckets.size())
+            buckets.resize(int(first + to));
+        for (qint64 i = from; i < to; ++i)
+            buckets[int(first + i)] = acc[size_t(i)].bucket();
+    }
+    Q_EMIT q_ptr->progress(int(first + from), int(first + to));
+}
+
+void QAVAudioWaveformPrivate::run()
+{
+    if (loadCache()) {
+        int count = 0;
+        {
+            QMutexLocker locker(&mutex);
+            finished = true;
+            count = buckets.size();
+        }
+        Q_EMIT q_ptr->progress(0, count);
+        Q_EMIT q_ptr->finished();
+        return;
+    }
+
+    double total = 0;
+    int threads = threadCount;
+    {
+        QAVDemuxer demuxer;
+        QAVStream stream;
+        if (demuxer.load(url) >= 0 && findAudioStream(demuxer, streamIndex, stream)) {
+            total = stream.duration() > 0 ? stream.duration() : demuxer.duration();
+            // Ranges require seeking
+            if (!demuxer.seekable())
+                threads = 1;
+        } else {
+            qWarning() << "Could not find audio in:" << url;
+        }
+    }
+
+    const qint64 count = qint64(std::ceil(total * resolution));
+    {
+        QMutexLocker locker(&mutex);
+        duration = total;
+        buckets.fill({}, int(count));
+    }
+
+    const int ranges = count > 0 ? int(qBound<qint64>(1, count / (qint64(resolution) * minRangeDuration), threads)) : 1;
+    threadPool.setMaxThreadCount(ranges);
+    QList<QFuture<bool>> futures;
+    for (int r = 0; r < ranges; ++r) {
+        Range range;
+        range.bucketsPerSecond = resolution;
+        range.first = count * r / ranges;
+        const qint64 last = count * (r + 1) / ranges;
+        range.from = double(range.first) / resolution;
+        // The last range continues to the end if the duration is wrong
+        range.grow = r == ranges - 1;
+        range.to = range.grow ? std::numeric_limits<double>::max() : double(last) / resolution;
+        futures.append(QtConcurrent::run(&threadPool, [this, range, last] {
+            std::vector<Accumulator> acc(size_t(last - range.first));
+            qint64 published = 0;
+            return decodeRange(url, streamIndex, range, acc, abort, [&](qint64 done) {
+                publish(acc, range.first, published, done);
+                published = qMax(published, done);
+            });
+        }));
+    }
+
+    bool ok = true;
+    for (auto &f : futures) {
+        f.waitForFinished();
+        ok = f.result() && ok;
+    }
+
+    if (abort)
+        return;
+
+    {
+        QMutexLocker locker(&mutex);
+        finished = true;
+        if (!buckets.isEmpty())
+            duration = qMax(duration, double(buckets.size()) / resolution);
+    }
+    if (ok)
+        saveCache();
+    Q_EMIT q_ptr->finished();
+}
+
+QAVAudioWaveform::QAVAudioWaveform(QObject *parent)
+    : QObject(parent)
+    , d_ptr(new QAVAudioWaveformPrivate(this))
+{
+}
+
+QAVAudioWaveform::~QAVAudioWaveform()
+{
+    abort();
+}
+
+void QAVAudioWaveform::setSource(const QString &url)
+{
+    Q_D(QAVAudioWaveform);
+    abort();
+    d->url = url;
+}
+
+QString QAVAudioWaveform::source() const
+{
+    return d_func()->url;
+}
+
+int QAVAudioWaveform::audioStream() const
+{
+    return d_func()->streamIndex;
+}
+
+void QAVAudioWaveform::setAudioStream(int index)
+{
+    d_func()->streamIndex = index;
+}
+
+int QAVAudioWaveform::resolution() const
+{
+    return d_func()->resolution;
+}
+
+void QAVAudioWaveform::setResolution(int buckets)
+{
+    d_func()->resolution = qMax(1, buckets);
+}
+
+int QAVAudioWaveform::threadCount() const
+{
+    return d_func()->threadCount;
+}
+
+void QAVAudioWaveform::setThreadCount(int count)
+{
+    d_func()->threadCount = qMax(1, count);
+}
+
+QString QAVAudioWaveform::cacheDirectory() const
+{
+    return d_func()->cacheDir;
+}
+
+void QAVAudioWaveform::setCacheDirectory(const QString &dir)
+{
+    d_func()->cacheDir = dir;
+}
+
+void QAVAudioWaveform::start()
+{
+    Q_D(QAVAudioWaveform);
+    abort();
+    {
+        QMutexLocker locker(&d->mutex);
+        d->buckets.clear();
+        d->duration = 0;
+        d->finished = false;
+    }
+    d->abort = false;
+    d->future = QtConcurrent::run([d] { d->run(); });
+}
+
+void QAVAudioWaveform::abort()
+{
+    Q_D(QAVAudioWaveform);
+    d->abort = true;
+    d->future.waitForFinished();
+    d->threadPool.waitForDone();
+}
+
+bool QAVAudioWaveform::isFinished() const
+{
+    Q_D(const QAVAudioWaveform);
+    QMutexLocker locker(&d->mutex);
+    return d->finished;
+}
+
+double QAVAudioWaveform::duration() const
+{
+    Q_D(const QAVAudioWaveform);
+    QMutexLocker locker(&d->mutex);
+    return d->duration;
+}
+
+QVector<QAVAudioWaveformBucket> QAVAudioWaveform::buckets() const
+{
+    Q_D(const QAVAudioWaveform);
+    QMutexLocker locker(&d->mutex);
+    return d->buckets;
+}
+
+QVector<QAVAudioWaveformBucket> QAVAudioWaveform::buckets(double from, double to, int count) const
+{
+    Q_D(const QAVAudioWaveform);
+    QVector<QAVAudioWaveformBucket> result(qMax(0, count));
+    if (count <= 0 || to <= from)
+        return result;
+
+    QMutexLocker locker(&d->mutex);
+    const int size = d->buckets.size();
+    const double step = (to - from) * d->resolution / count;
+    for (int k = 0; k < count; ++k) {
+        const double start = from * d->resolution + k * step;
+        const int b0 = qMax(0, int(std::floor(start)));
+        const int b1 = qMin(size, qMax(b0 + 1, int(std::ceil(start + step))));
+        float mn = 1;
+        float mx = -1;
+        double sum = 0;
+        int n = 0;
+        for (int b = b0; b < b1; ++b) {
+            const auto &src = d->buckets[b];
+            if (src.min > src.max)
+                continue;
+            mn = n ? qMin(mn, src.min) : src.min;
+            mx = n ? qMax(mx, src.max) : src.max;
+            sum += double(src.rms) * src.rms;
+            ++n;
+        }
+        if (n) {
+            result[k].min = mn;
+            result[k].max = mx;
+            result[k].rms = float(std::sqrt(sum / n));
+        }
+    }
+    return result;
+}
+
+QVector<QAVAudioWaveformBucket> QAVAudioWaveform::decode(double from, double to, int count) const
+{
+    Q_D(const QAVAudioWaveform);
+    QVector<QAVAudioWaveformBucket> result(qMax(0, count));
+    if (count <= 0 || to <= from)
+        return result;
+
+    Range range;
+    range.origin = from;
+    range.bucketsPerSecond = count / (to - from);
+    range.from = from;
+    range.to = to;
+    std::vector<Accumulator> acc(count);
+    std::atomic_bool abort {false};
+    decodeRange(d->url, d->streamIndex, range, acc, abort, [](qint64) {});
+    for (int i = 0; i < count; ++i)
+        result[i] = acc[size_t(i)].bucket();
+    return result;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,85 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVAUDIOWAVEFORM_H
+#define QAVAUDIOWAVEFORM_H
+
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+// Summary of the samples of all channels within a bucket, min > max if there is no audio
+struct QAVAudioWaveformBucket
+{
+    float min = 1;
+    float max = -1;
+    float rms = 0;
+};
+
+class QAVAudioWaveformPrivate;
+// Builds the waveform overview of the whole file without playing it.
+// Only one audio stream is demuxed and decoded, the timeline is split into ranges
+// which are decoded in parallel and the buckets are available as soon as ranges progress.
+class QAVAudioWaveform : public QObject
+{
+    Q_OBJECT
+public:
+    QAVAudioWaveform(QObject *parent = nullptr);
+    ~QAVAudioWaveform();
+
+    void setSource(const QString &url);
+    QString source() const;
+
+    // Index of the audio stream, the best one is used if -1
+    int audioStream() const;
+    void setAudioStream(int index);
+
+    // Buckets per second of the overview
+    int resolution() const;
+    void setResolution(int buckets);
+
+    // Ranges decoded in parallel
+    int threadCount() const;
+    void setThreadCount(int count);
+
+    // The overview is loaded from and saved to this directory, keyed by the source, its size and mtime
+    QString cacheDirectory() const;
+    void setCacheDirectory(const QString &dir);
+
+    // Generates the overview in background, finished() is emitted when done
+    void start();
+    void abort();
+    bool isFinished() const;
+
+    double duration() const;
+    // All buckets generated so far at the resolution
+    QVector<QAVAudioWaveformBucket> buckets() const;
+    // Buckets of the overview within the range, reduced to count
+    QVector<QAVAudioWaveformBucket> buckets(double from, double to, int count) const;
+    // Decodes the range directly for zoom levels finer than the resolution, blocks
+    QVector<QAVAudioWaveformBucket> decode(double from, double to, int count) const;
+
+Q_SIGNALS:
+    // The buckets in [from, to) are ready
+    void progress(int from, int to);
+    void finished();
+
+protected:
+    std::unique_ptr<QAVAudioWaveformPrivate> d_ptr;
+
+private:
+    Q_DISABLE_COPY(QAVAudioWaveform)
+    Q_DECLARE_PRIVATE(QAVAudioWaveform)
+};
+
+QT_END_NAMESPACE
+
+#endif
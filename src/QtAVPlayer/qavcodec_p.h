@@ -40,7 +40,7 @@ public:
     void setCodec(const AVCodec *c);
     const AVCodec *codec() const;
 
-    void flushBuffers();
+    virtual void flushBuffers();
 
     // Sends a packet
     virtual int write(const QAVPacket &pkt) = 0;
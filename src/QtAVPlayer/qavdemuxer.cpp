@@ -7,6 +7,7 @@
 
 #include "qavdemuxer_p.h"
 #include "qavvideocodec_p.h"
+#include "qavvideoframeallocator.h"
 #include "qavaudiocodec_p.h"
 #include "qavsubtitlecodec_p.h"
 #include "qavhwdevice_p.h"
@@ -41,7 +42,9 @@ extern "C" {
 }
 #endif
 
+#include "qavseekindex_p.h"
 #include <QDir>
+#include <QFileInfo>
 #include <QSharedPointer>
 #include <QMutexLocker>
 #include <atomic>
@@ -102,13 +105,51 @@ public:
     QList<QAVStream::Progress> progress;
     QString inputFormat;
     QString inputVideoCodec;
+    QSharedPointer<QAVVideoFrameAllocator> videoFrameAllocator;
     QMap<QString, QString> inputOptions;
 
     bool eof = false;
+    // No input format, the packets are pushed instead of read
+    bool pushed = false;
     QList<QAVPacket> packets;
     QString bsfs;
+
+    // Keyframes of the video stream by the byte offsets
+    QString seekIndexDir;
+    bool seekIndexPrescan = false;
+    std::unique_ptr<QAVSeekIndex> seekIndex;
+    int seekIndexStream = -1;
+    // The previous keyframe is indexed
+    bool seekIndexContiguous = false;
+    // No seeks since loading
+    bool readFromStart = true;
+    // Seeks done by the index
+    int seekIndexHits = 0;
+    void createSeekIndex(const QString &url, bool customIO);
 };
 
+void QAVDemuxerPrivate::createSeekIndex(const QString &url, bool customIO)
+{
+    if (currentVideoStreams.isEmpty() || !seekable || !ctx->pb)
+        return;
+    // Formats without a proper index, avformat_seek_file() reads the file to find the keyframe.
+    // Raw elementary streams, e.g. h264 or hevc, are not indexed: their packets have no timestamps to key the keyframes by.
+    const int flags = ctx->iformat->flags;
+    if ((flags & AVFMT_NO_BYTE_SEEK) || !(flags & AVFMT_TS_DISCONT))
+        return;
+
+    const AVStream *stream = ctx->streams[currentVideoStreams.first().index()];
+    const bool file = !customIO && QFileInfo(url).isFile();
+    seekIndexStream = stream->index;
+    seekIndexContiguous = false;
+    readFromStart = true;
+    seekIndexHits = 0;
+    seekIndex.reset(new QAVSeekIndex(file ? QAVSeekIndex::cachePath(seekIndexDir, url, stream->id) : QString()));
+    seekIndex->load();
+    if (file && seekIndexPrescan && !seekIndex->isComplete())
+        seekIndex->scan(url, stream->id);
+}
+
 static void log_callback(void *ptr, int level, const char *fmt, va_list vl)
 {
     /* Do we need to log ? */
@@ -407,6 +448,21 @@ int QAVDemuxer::load(const QString &url, QAVIODevice *dev)
     if (ret < 0)
         return ret;
 
+    selectStreams();
+    d->createSeekIndex(url, dev != nullptr);
+
+    if (ret < 0)
+        return ret;
+
+    if (!d->bsfs.isEmpty())
+        return apply_bsf(d->bsfs, d->ctx, d->bsf_ctx);
+
+    return 0;
+}
+
+void QAVDemuxer::selectStreams()
+{
+    Q_D(QAVDemuxer);
     const int videoStreamIndex = av_find_best_stream(
         d->ctx,
         AVMEDIA_TYPE_VIDEO,
@@ -436,16 +492,62 @@ int QAVDemuxer::load(const QString &url, QAVIODevice *dev)
         0);
     if (subtitleStreamIndex >= 0)
         d->currentSubtitleStreams.push_back(d->availableStreams[subtitleStreamIndex]);
+}
+
+int QAVDemuxer::load(const QList<const AVCodecParameters *> &params, const QList<AVRational> &timeBases)
+{
+    Q_D(QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    if (params.size() != timeBases.size())
+        return AVERROR(EINVAL);
+
+    if (!d->ctx)
+        d->ctx = avformat_alloc_context();
+
+    for (int i = 0; i < params.size(); ++i) {
+        AVStream *stream = avformat_new_stream(d->ctx, nullptr);
+        if (!stream)
+            return AVERROR(ENOMEM);
+        int ret = avcodec_parameters_copy(stream->codecpar, params[i]);
+        if (ret < 0)
+            return ret;
+        stream->time_base = timeBases[i];
+    }
 
+    // Packets are pushed by the application, nothing is read from the context
+    d->pushed = true;
+    d->seekable = false;
+    int ret = resetCodecs();
     if (ret < 0)
         return ret;
 
-    if (!d->bsfs.isEmpty())
-        return apply_bsf(d->bsfs, d->ctx, d->bsf_ctx);
-
+    selectStreams();
     return 0;
 }
 
+void QAVDemuxer::endOfStreams()
+{
+    Q_D(QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    if (d->eof)
+        return;
+    d->eof = true;
+    // Empty packets flush the codecs
+    for (const auto &stream : d->availableStreams) {
+        QAVPacket pkt;
+        pkt.packet()->stream_index = stream.index();
+        pkt.setStream(stream);
+        d->packets.append(pkt);
+    }
+}
+
+QAVStream QAVDemuxer::stream(int index) const
+{
+    Q_D(const QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    return index >= 0 && index < d->availableStreams.size() ? d->availableStreams[index] : QAVStream();
+}
+
 int QAVDemuxer::resetCodecs()
 {
     Q_D(QAVDemuxer);
@@ -460,6 +562,7 @@ int QAVDemuxer::resetCodecs()
             case AVMEDIA_TYPE_VIDEO:
             {
                 QSharedPointer<QAVCodec> codec(new QAVVideoCodec);
+                static_cast<QAVVideoCodec *>(codec.data())->setFrameAllocator(d->videoFrameAllocator);
                 d->availableStreams.push_back({ int(i), d->ctx, codec });
                 ret = setup_video_codec(d->inputVideoCodec, d->ctx->streams[i], *static_cast<QAVVideoCodec *>(codec.data()));
             } break;
@@ -635,6 +738,9 @@ void QAVDemuxer::unload()
     }
     d->ctx = nullptr;
     d->eof = false;
+    d->pushed = false;
+    d->seekIndex.reset();
+    d->seekIndexStream = -1;
     d->abortRequest = 0;
     d->currentVideoStreams.clear();
     d->currentAudioStreams.clear();
@@ -652,6 +758,22 @@ bool QAVDemuxer::eof() const
     return d->eof;
 }
 
+void QAVDemuxer::discardUnusedStreams()
+{
+    Q_D(QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    if (!d->ctx)
+        return;
+
+    for (std::size_t i = 0; i < d->ctx->nb_streams; ++i) {
+        const int index = int(i);
+        const bool used = findStream(d->currentVideoStreams, index)
+            || findStream(d->currentAudioStreams, index)
+            || findStream(d->currentSubtitleStreams, index);
+        d->ctx->streams[i]->discard = used ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+}
+
 QAVPacket QAVDemuxer::read()
 {
     Q_D(QAVDemuxer);
@@ -660,7 +782,7 @@ QAVPacket QAVDemuxer::read()
         if (!d->packets.isEmpty())
             return d->packets.takeFirst();
 
-        if (!d->ctx || d->eof)
+        if (!d->ctx || d->eof || d->pushed)
             return {};
     }
 
@@ -678,6 +800,16 @@ QAVPacket QAVDemuxer::read()
     {
         QMutexLocker locker(&d->mutex);
         d->eof = eof;
+        auto p = pkt.packet();
+        if (d->seekIndex && !eof && p->stream_index == d->seekIndexStream && (p->flags & AV_PKT_FLAG_KEY) && p->pos >= 0) {
+            const int64_t ts = p->pts != AV_NOPTS_VALUE ? p->pts : p->dts;
+            if (ts != AV_NOPTS_VALUE) {
+                d->seekIndex->add(av_rescale_q(ts, d->ctx->streams[p->stream_index]->time_base, AV_TIME_BASE_Q), p->pos, d->seekIndexContiguous);
+                d->seekIndexContiguous = true;
+            }
+        }
+        if (d->seekIndex && eof && d->readFromStart)
+            d->seekIndex->setComplete();
         if (pkt.packet()->stream_index < d->availableStreams.size())
             pkt.setStream(d->availableStreams[pkt.packet()->stream_index]);
         if (d->bsf_ctx) {
@@ -758,10 +890,23 @@ int QAVDemuxer::seek(double sec)
         return AVERROR(EINVAL);
 
     d->eof = false;
+    d->seekIndexContiguous = false;
+    d->readFromStart = false;
+    auto seekIndex = d->seekIndex.get();
     locker.unlock();
 
     int flags = AVSEEK_FLAG_BACKWARD;
     int64_t target = sec * AV_TIME_BASE;
+    int64_t pos = 0;
+    if (seekIndex && seekIndex->find(target, pos)) {
+        // Starts reading from the keyframe
+        int ret = av_seek_frame(d->ctx, -1, pos, AVSEEK_FLAG_BYTE);
+        if (ret >= 0) {
+            locker.relock();
+            ++d->seekIndexHits;
+            return ret;
+        }
+    }
     int64_t min = INT_MIN;
     int64_t max = target;
     return avformat_seek_file(d->ctx, -1, min, target, max, flags);
@@ -843,6 +988,55 @@ void QAVDemuxer::setInputFormat(const QString &format)
     d->inputFormat = format;
 }
 
+QString QAVDemuxer::seekIndexDirectory() const
+{
+    Q_D(const QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    return d->seekIndexDir;
+}
+
+void QAVDemuxer::setSeekIndexDirectory(const QString &dir)
+{
+    Q_D(QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    d->seekIndexDir = dir;
+}
+
+bool QAVDemuxer::seekIndexPrescan() const
+{
+    Q_D(const QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    return d->seekIndexPrescan;
+}
+
+void QAVDemuxer::setSeekIndexPrescan(bool enabled)
+{
+    Q_D(QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    d->seekIndexPrescan = enabled;
+}
+
+int QAVDemuxer::seekIndexSize() const
+{
+    Q_D(const QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    return d->seekIndex ? d->seekIndex->size() : -1;
+}
+
+bool QAVDemuxer::isSeekIndexComplete() const
+{
+    Q_D(const QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    return d->seekIndex && d->seekIndex->isComplete();
+}
+
+int QAVDemuxer::seekIndexHits() const
+{
+    Q_D(const QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    return d->seekIndexHits;
+}
+
 QString QAVDemuxer::inputVideoCodec() const
 {
     Q_D(const QAVDemuxer);
@@ -857,6 +1051,20 @@ void QAVDemuxer::setInputVideoCodec(const QString &codec)
     d->inputVideoCodec = codec;
 }
 
+QSharedPointer<QAVVideoFrameAllocator> QAVDemuxer::videoFrameAllocator() const
+{
+    Q_D(const QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    return d->videoFrameAllocator;
+}
+
+void QAVDemuxer::setVideoFrameAllocator(const QSharedPointer<QAVVideoFrameAllocator> &allocator)
+{
+    Q_D(QAVDemuxer);
+    QMutexLocker locker(&d->mutex);
+    d->videoFrameAllocator = allocator;
+}
+
 QMap<QString, QString> QAVDemuxer::inputOptions() const
 {
     Q_D(const QAVDemuxer);
@@ -36,8 +36,10 @@ class QAVDemuxerPrivate;
 class QAVVideoCodec;
 class QAVAudioCodec;
 class QAVIODevice;
+class QAVVideoFrameAllocator;
 struct AVStream;
 struct AVCodecContext;
+struct AVCodecParameters;
 struct AVFormatContext;
 class QAVDemuxer
 {
@@ -47,9 +49,14 @@ public:
 
     void abort(bool stop = true);
     int load(const QString &url, QAVIODevice *dev = nullptr);
+    // Creates the streams of packets pushed by the application, read() returns nothing
+    int load(const QList<const AVCodecParameters *> &params, const QList<AVRational> &timeBases);
+    // No more packets are pushed, read() returns empty packets to flush the codecs
+    void endOfStreams();
     void unload();
 
     AVMediaType currentCodecType(int index) const;
+    QAVStream stream(int index) const;
 
     QList<QAVStream> availableVideoStreams() const;
     QList<QAVStream> currentVideoStreams() const;
@@ -63,6 +70,9 @@ public:
     QList<QAVStream> currentSubtitleStreams() const;
     bool setSubtitleStreams(const QList<QAVStream> &streams);
 
+    // Packets of the streams which are not current are dropped by the demuxer (AVDISCARD_ALL)
+    void discardUnusedStreams();
+
     QAVPacket read();
 
     void decode(const QAVPacket &pkt, QList<QAVFrame> &frames) const;
@@ -86,6 +96,24 @@ public:
     QString inputVideoCodec() const;
     void setInputVideoCodec(const QString &codec);
 
+    // Keyframes of the video stream are indexed by the byte offsets while reading and used to seek formats
+    // which read the file to find the keyframe otherwise, e.g. MPEG-TS and PS. Applied on load().
+    // Raw elementary streams are not indexed since their packets have no timestamps.
+    // The index of local files is saved to the directory, keyed by the size and mtime.
+    QString seekIndexDirectory() const;
+    void setSeekIndexDirectory(const QString &dir);
+    // The whole file is scanned in background after loading
+    bool seekIndexPrescan() const;
+    void setSeekIndexPrescan(bool enabled);
+    // Keyframes indexed so far, -1 if the index is not used
+    int seekIndexSize() const;
+    bool isSeekIndexComplete() const;
+    // Seeks done by the index since loading
+    int seekIndexHits() const;
+
+    QSharedPointer<QAVVideoFrameAllocator> videoFrameAllocator() const;
+    void setVideoFrameAllocator(const QSharedPointer<QAVVideoFrameAllocator> &allocator);
+
     QMap<QString, QString> inputOptions() const;
     void setInputOptions(const QMap<QString, QString> &opts);
 
@@ -104,6 +132,7 @@ protected:
 
 private:
     int resetCodecs();
+    void selectStreams();
 
     Q_DISABLE_COPY(QAVDemuxer)
     Q_DECLARE_PRIVATE(QAVDemuxer)
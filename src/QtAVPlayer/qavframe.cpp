@@ -95,10 +95,12 @@ void QAVFrame::setFilterName(const QString &name)
 
 double QAVFramePrivate::pts() const
 {
-    if (!frame || !stream)
+    // Frames without a stream could have the time base set explicitly
+    const bool hasTimeBase = timeBase.num && timeBase.den;
+    if (!frame || (!stream && !hasTimeBase))
         return NAN;
 
-    AVRational tb = timeBase.num && timeBase.den ? timeBase : stream.stream()->time_base;
+    AVRational tb = hasTimeBase ? timeBase : stream.stream()->time_base;
     return frame->pts == AV_NOPTS_VALUE ? NAN : frame->pts * av_q2d(tb);
 }
 
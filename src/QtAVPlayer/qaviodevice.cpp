@@ -6,6 +6,9 @@
  *********************************************************/
 
 #include "qaviodevice.h"
+#include "qavreadaheadcache_p.h"
+#include <QDebug>
+#include <QFile>
 #include <QMutex>
 #include <QWaitCondition>
 
@@ -17,6 +20,9 @@ extern "C" {
 
 QT_BEGIN_NAMESPACE
 
+// Max size of the chunks read from the device in the adaptive mode
+static const int maxAdaptiveSize = 4 * 1024 * 1024;
+
 struct ReadRequest
 {
     ReadRequest() = default;
@@ -33,16 +39,188 @@ public:
     explicit QAVIODevicePrivate(QAVIODevice *q, const QSharedPointer<QIODevice> &device)
         : q_ptr(q)
         , device(device)
-        , buffer(static_cast<unsigned char*>(av_malloc(buffer_size)))
-        , ctx(avio_alloc_context(buffer, static_cast<int>(buffer_size), 0, this, &QAVIODevicePrivate::read, nullptr, !device->isSequential() ? &QAVIODevicePrivate::seek : nullptr))
     {
-        if (!device->isSequential())
-            ctx->seekable = AVIO_SEEKABLE_NORMAL;
+        createContext();
     }
 
     ~QAVIODevicePrivate()
     {
+        freeContext();
+        unmapDevice();
+    }
+
+    // AVIO could replace the buffer, it is freed from the context
+    void freeContext()
+    {
+        if (!ctx)
+            return;
+        av_freep(&ctx->buffer);
         av_free(ctx);
+        ctx = nullptr;
+    }
+
+    void createContext()
+    {
+        freeContext();
+        buffer = static_cast<unsigned char*>(av_malloc(buffer_size));
+        ctx = avio_alloc_context(buffer, static_cast<int>(buffer_size), 0, this, &QAVIODevicePrivate::read, nullptr, !device->isSequential() ? &QAVIODevicePrivate::seek : nullptr);
+        if (!device->isSequential())
+            ctx->seekable = AVIO_SEEKABLE_NORMAL;
+    }
+
+    // Must be called with the locked mutex
+    bool isDirectRead() const
+    {
+        if (readMode == QAVIODevice::AutoRead)
+            return qobject_cast<QFile *>(device.data()) != nullptr;
+        return readMode == QAVIODevice::DirectRead || readMode == QAVIODevice::MappedRead;
+    }
+
+    bool mapDevice()
+    {
+        auto file = qobject_cast<QFileDevice *>(device.data());
+        if (!file || !file->isOpen())
+            return false;
+        const qint64 size = file->size();
+        uchar *data = size > 0 ? file->map(0, size) : nullptr;
+        if (!data)
+            return false;
+        unmapDevice();
+        mapped = data;
+        mappedSize = size;
+        return true;
+    }
+
+    void unmapDevice()
+    {
+        mappedSynced = false;
+        if (!mapped)
+            return;
+        auto file = qobject_cast<QFileDevice *>(device.data());
+        if (file)
+            file->unmap(mapped);
+        mapped = nullptr;
+    }
+
+    // Returns false if the resized file could not be mapped again, it is read directly from mappedPos then
+    bool remapIfResized()
+    {
+        auto file = qobject_cast<QFileDevice *>(device.data());
+        if (file->size() == mappedSize)
+            return true;
+        const qint64 pos = mappedPos;
+        if (mapDevice()) {
+            mappedSynced = true;
+            return true;
+        }
+        qWarning() << "QAVIODevice: Could not map the resized file, reading directly";
+        unmapDevice();
+        file->seek(pos);
+        return false;
+    }
+
+    // The file could be seeked or resized since it was mapped, returns false if it is not mapped anymore
+    bool syncMapping()
+    {
+        if (mappedSynced)
+            return true;
+        mappedSynced = true;
+        mappedPos = device->pos();
+        return remapIfResized();
+    }
+
+    int readMapped(unsigned char *data, int maxSize)
+    {
+        // The file could grow while it is read
+        if (!syncMapping() || (mappedPos >= mappedSize && !remapIfResized()))
+            return readDevice(data, maxSize);
+        if (mappedPos >= mappedSize)
+            return AVERROR_EOF;
+        const int bytes = int(qMin<qint64>(maxSize, mappedSize - mappedPos));
+        memcpy(data, mapped + mappedPos, bytes);
+        mappedPos += bytes;
+        return bytes;
+    }
+
+    int64_t seekMapped(int64_t offset, int whence)
+    {
+        if (!syncMapping())
+            return seekDevice(offset, whence);
+        if ((whence == AVSEEK_SIZE || whence == SEEK_END) && !remapIfResized())
+            return seekDevice(offset, whence);
+        if (whence == AVSEEK_SIZE)
+            return mappedSize;
+        if (whence == SEEK_END)
+            offset = mappedSize - offset;
+        else if (whence == SEEK_CUR)
+            offset = mappedPos + offset;
+        if (offset > mappedSize && !remapIfResized())
+            return seekDevice(offset, SEEK_SET);
+        if (offset < 0 || offset > mappedSize)
+            return -1;
+        mappedPos = offset;
+        return offset;
+    }
+
+    // Bytes read from the device but not sent to AVIO yet
+    qint64 chunkAvailable() const
+    {
+        return chunk.size() - chunkPos;
+    }
+
+    int readChunk(unsigned char *data, int maxSize)
+    {
+        const int bytes = int(qMin<qint64>(maxSize, chunkAvailable()));
+        memcpy(data, chunk.constData() + chunkPos, bytes);
+        chunkPos += bytes;
+        return bytes;
+    }
+
+    int readDevice(unsigned char *data, int maxSize)
+    {
+        if (!adaptive)
+            return !device->atEnd() ? device->read((char *)data, maxSize) : AVERROR_EOF;
+
+        if (!chunkAvailable()) {
+            if (device->atEnd())
+                return AVERROR_EOF;
+
+            // Sequential reads of full chunks mean the source is faster than the demuxer, fewer and bigger reads are used
+            chunkSize = chunkFull ? qMin(chunkSize * 2, maxAdaptiveSize) : qMax(int(buffer_size), maxSize);
+            chunk.resize(chunkSize);
+            const qint64 bytes = device->read(chunk.data(), chunkSize);
+            chunk.resize(int(qMax<qint64>(bytes, 0)));
+            chunkPos = 0;
+            chunkFull = bytes == chunkSize;
+            if (bytes <= 0)
+                return int(bytes);
+        }
+
+        return readChunk(data, maxSize);
+    }
+
+    int64_t seekDevice(int64_t offset, int whence)
+    {
+        if (whence == AVSEEK_SIZE)
+            return device->size() > 0 ? device->size() : 0;
+
+        const qint64 pos = device->pos() - chunkAvailable();
+        if (whence == SEEK_END)
+            offset = device->size() - offset;
+        else if (whence == SEEK_CUR)
+            offset = pos + offset;
+
+        // Seeks within the chunk don't touch the device
+        const qint64 chunkStart = pos - chunkPos;
+        if (offset >= chunkStart && offset <= chunkStart + chunk.size()) {
+            chunkPos = int(offset - chunkStart);
+            return offset;
+        }
+
+        chunk.clear();
+        chunkPos = 0;
+        chunkFull = false;
+        return device->seek(offset) ? device->pos() : -1;
     }
 
     void readData()
@@ -52,7 +230,7 @@ public:
         if (readRequest.data == nullptr || readRequest.wroteBytes)
             return;
 
-        readRequest.wroteBytes = !device->atEnd() ? device->read((char *)readRequest.data, readRequest.maxSize) : AVERROR_EOF;
+        readRequest.wroteBytes = readDevice(readRequest.data, readRequest.maxSize);
         // Unblock the decoder thread when there is available bytes
         if (readRequest.wroteBytes) {
             waitCond.wakeAll();
@@ -67,6 +245,26 @@ public:
         if (d->aborted)
             return ECANCELED;
 
+        if (d->cache) {
+            locker.unlock();
+            return d->cache->read(data, maxSize);
+        }
+
+        if (d->mapped) {
+            locker.unlock();
+            return d->readMapped(data, maxSize);
+        }
+
+        if (d->isDirectRead()) {
+            // No thread hops, the demuxer is not blocked by the owner's event loop
+            locker.unlock();
+            return d->readDevice(data, maxSize);
+        }
+
+        // The chunk is filled on the owner thread, only refills need the thread hop
+        if (d->chunkAvailable() > 0)
+            return d->readChunk(data, maxSize);
+
         d->readRequest = { data, maxSize };
         // When decoder thread is the same as current
         d->wakeRead = false;
@@ -90,21 +288,34 @@ public:
         if (d->aborted)
             return ECANCELED;
 
+        if (d->cache) {
+            locker.unlock();
+            const qint64 size = d->cache->size();
+            if (whence == AVSEEK_SIZE)
+                return size > 0 ? size : 0;
+            if (whence == SEEK_END)
+                offset = size - offset;
+            else if (whence == SEEK_CUR)
+                offset = d->cache->pos() + offset;
+            return d->cache->seek(offset);
+        }
+
+        if (d->mapped) {
+            locker.unlock();
+            return d->seekMapped(offset, whence);
+        }
+
+        if (d->isDirectRead()) {
+            locker.unlock();
+            return d->seekDevice(offset, whence);
+        }
+
         int64_t pos = 0;
         bool wake = false;
         locker.unlock();
         QMetaObject::invokeMethod(d->q_ptr, [&]() -> void {
             QMutexLocker locker(&d->mutex);
-            if (whence == AVSEEK_SIZE) {
-                pos = d->device->size() > 0 ? d->device->size() : 0;
-            } else {
-                if (whence == SEEK_END)
-                    offset = d->device->size() - offset;
-                else if (whence == SEEK_CUR)
-                    offset = d->device->pos() + offset;
-
-                pos = d->device->seek(offset) ? d->device->pos() : -1;
-            }
+            pos = d->seekDevice(offset, whence);
             d->waitCond.wakeAll();
             wake = true;
         });
@@ -125,6 +336,20 @@ public:
     QWaitCondition waitCond;
     bool aborted = false;
     bool wakeRead = false;
+    QAVIODevice::ReadMode readMode = QAVIODevice::AutoRead;
+    // The context is used by a demuxer and cannot be recreated
+    mutable bool loaded = false;
+    bool adaptive = false;
+    QByteArray chunk;
+    int chunkPos = 0;
+    int chunkSize = 0;
+    bool chunkFull = false;
+    std::unique_ptr<QAVReadAheadCache> cache;
+    uchar *mapped = nullptr;
+    qint64 mappedSize = 0;
+    qint64 mappedPos = 0;
+    // mappedPos is taken from the file on the first read or seek after mapping
+    bool mappedSynced = false;
     ReadRequest readRequest;
 };
 
@@ -145,7 +370,10 @@ QAVIODevice::~QAVIODevice()
 
 AVIOContext *QAVIODevice::ctx() const
 {
-    return d_func()->ctx;
+    Q_D(const QAVIODevice);
+    QMutexLocker locker(&d->mutex);
+    d->loaded = true;
+    return d->ctx;
 }
 
 void QAVIODevice::abort(bool aborted)
@@ -153,6 +381,8 @@ void QAVIODevice::abort(bool aborted)
     Q_D(QAVIODevice);
     QMutexLocker locker(&d->mutex);
     d->aborted = aborted;
+    if (d->cache)
+        d->cache->abort(aborted);
     d->waitCond.wakeAll();
 }
 
@@ -160,7 +390,14 @@ void QAVIODevice::setBufferSize(size_t size)
 {
     Q_D(QAVIODevice);
     QMutexLocker locker(&d->mutex);
+    if (size == 0 || size == d->buffer_size)
+        return;
+    if (d->loaded) {
+        qWarning() << "QAVIODevice: Cannot set buffer size after the device is loaded";
+        return;
+    }
     d->buffer_size = size;
+    d->createContext();
 }
 
 size_t QAVIODevice::bufferSize() const
@@ -170,4 +407,90 @@ size_t QAVIODevice::bufferSize() const
     return d->buffer_size;
 }
 
+void QAVIODevice::setAdaptiveBufferSize(bool enabled)
+{
+    Q_D(QAVIODevice);
+    QMutexLocker locker(&d->mutex);
+    if (d->loaded) {
+        qWarning() << "QAVIODevice: Cannot change adaptive buffer size after the device is loaded";
+        return;
+    }
+    d->adaptive = enabled;
+}
+
+bool QAVIODevice::isAdaptiveBufferSize() const
+{
+    Q_D(const QAVIODevice);
+    QMutexLocker locker(&d->mutex);
+    return d->adaptive;
+}
+
+void QAVIODevice::setReadAheadSize(qint64 bytes)
+{
+    Q_D(QAVIODevice);
+    QMutexLocker locker(&d->mutex);
+    if (d->loaded) {
+        qWarning() << "QAVIODevice: Cannot set read-ahead size after the device is loaded";
+        return;
+    }
+    // Devices which are not read directly are filled on the owner thread, e.g. network replies
+    d->cache.reset(bytes > 0 ? new QAVReadAheadCache(d->device, bytes, d->isDirectRead() ? nullptr : thread()) : nullptr);
+}
+
+qint64 QAVIODevice::readAheadSize() const
+{
+    Q_D(const QAVIODevice);
+    QMutexLocker locker(&d->mutex);
+    return d->cache ? d->cache->capacity() : 0;
+}
+
+quint64 QAVIODevice::cacheHits() const
+{
+    Q_D(const QAVIODevice);
+    QMutexLocker locker(&d->mutex);
+    return d->cache ? d->cache->hits() : 0;
+}
+
+quint64 QAVIODevice::cacheMisses() const
+{
+    Q_D(const QAVIODevice);
+    QMutexLocker locker(&d->mutex);
+    return d->cache ? d->cache->misses() : 0;
+}
+
+void QAVIODevice::setReadMode(ReadMode mode)
+{
+    Q_D(QAVIODevice);
+    QMutexLocker locker(&d->mutex);
+    if (d->loaded) {
+        qWarning() << "QAVIODevice: Cannot change read mode after the device is loaded";
+        return;
+    }
+    d->readMode = mode;
+    if (mode != MappedRead)
+        d->unmapDevice();
+    else if (!d->mapped && !d->mapDevice())
+        qWarning() << "QAVIODevice: Could not map the device, reading directly";
+    // The read-ahead is filled on the thread of the new mode
+    if (d->cache) {
+        const qint64 bytes = d->cache->capacity();
+        d->cache.reset();
+        d->cache.reset(new QAVReadAheadCache(d->device, bytes, d->isDirectRead() ? nullptr : thread()));
+    }
+}
+
+QAVIODevice::ReadMode QAVIODevice::readMode() const
+{
+    Q_D(const QAVIODevice);
+    QMutexLocker locker(&d->mutex);
+    return d->readMode;
+}
+
+bool QAVIODevice::isDirectRead() const
+{
+    Q_D(const QAVIODevice);
+    QMutexLocker locker(&d->mutex);
+    return d->isDirectRead();
+}
+
 QT_END_NAMESPACE
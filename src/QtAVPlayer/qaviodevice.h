@@ -20,14 +20,51 @@ class QAVIODevicePrivate;
 class QAVIODevice : public QObject
 {
 public:
+    // Thread where the device is read from and seeked
+    enum ReadMode
+    {
+        // Direct for QFile, owner thread for others.
+        // QBuffer is often filled by the application while it is read, DirectRead must be set explicitly for it.
+        AutoRead,
+        // The thread where QAVIODevice is created, requires a running event loop there
+        OwnerThreadRead,
+        // The demuxer's thread, the device must not be used from other threads while loaded
+        DirectRead,
+        // Copies from the memory mapping of QFile on the demuxer's thread, no syscalls and QIODevice buffers.
+        // Starts from the file's position at the first read, the file is mapped again when it grows.
+        // Falls back to DirectRead if the file could not be mapped.
+        MappedRead
+    };
+
     QAVIODevice(const QSharedPointer<QIODevice> &device, QObject *parent = nullptr);
     ~QAVIODevice();
 
     AVIOContext *ctx() const;
     void abort(bool aborted);
 
+    // Size of the AVIO buffer, must be set before the device is loaded
     void setBufferSize(size_t size);
     size_t bufferSize() const;
+    // Reads bigger chunks up to 4 MiB from the device while the source is read sequentially,
+    // starting from bufferSize() and going back to it after seeks. Must be set before the device is loaded.
+    // If the device is read on the owner thread, only the reads of new chunks wait for it.
+    void setAdaptiveBufferSize(bool enabled);
+    bool isAdaptiveBufferSize() const;
+
+    // Reads the device into a ring of this size ahead of the demuxer,
+    // a quarter of it keeps the data already read for backward seeks. 0 to disable.
+    // The device is read on a background thread if isDirectRead(), otherwise by the owner thread's event loop.
+    // Must be set before the device is loaded.
+    void setReadAheadSize(qint64 bytes);
+    qint64 readAheadSize() const;
+    // Reads and seeks served from the read-ahead ring without waiting for the device
+    quint64 cacheHits() const;
+    quint64 cacheMisses() const;
+
+    void setReadMode(ReadMode mode);
+    ReadMode readMode() const;
+    // True if the device is read on the demuxer's thread
+    bool isDirectRead() const;
 
 protected:
     std::unique_ptr<QAVIODevicePrivate> d_ptr;
@@ -68,6 +68,72 @@ AVPacket *QAVPacket::packet() const
     return d_func()->pkt;
 }
 
+static void releaseByteArray(void *opaque, uint8_t *)
+{
+    delete static_cast<QByteArray *>(opaque);
+}
+
+static void releaseFunction(void *opaque, uint8_t *)
+{
+    auto release = static_cast<std::function<void()> *>(opaque);
+    if (*release)
+        (*release)();
+    delete release;
+}
+
+static bool hasPadding(const QByteArray &data)
+{
+    if (data.capacity() - data.size() < AV_INPUT_BUFFER_PADDING_SIZE)
+        return false;
+    static const char zeros[AV_INPUT_BUFFER_PADDING_SIZE] = {};
+    return !memcmp(data.constData() + data.size(), zeros, AV_INPUT_BUFFER_PADDING_SIZE);
+}
+
+bool QAVPacket::setData(const QByteArray &data)
+{
+    Q_D(QAVPacket);
+    av_packet_unref(d->pkt);
+    if (data.isEmpty())
+        return false;
+
+    if (!hasPadding(data)) {
+        // Decoders could read past the end, the payload is copied to a padded buffer
+        if (av_new_packet(d->pkt, data.size()) < 0)
+            return false;
+        memcpy(d->pkt->data, data.constData(), data.size());
+        return true;
+    }
+
+    auto holder = new QByteArray(data);
+    auto ptr = reinterpret_cast<uint8_t *>(const_cast<char *>(holder->constData()));
+    d->pkt->buf = av_buffer_create(ptr, holder->size() + AV_INPUT_BUFFER_PADDING_SIZE, releaseByteArray, holder, AV_BUFFER_FLAG_READONLY);
+    if (!d->pkt->buf) {
+        delete holder;
+        return false;
+    }
+    d->pkt->data = ptr;
+    d->pkt->size = holder->size();
+    return true;
+}
+
+bool QAVPacket::setData(uint8_t *data, int size, const std::function<void()> &release)
+{
+    Q_D(QAVPacket);
+    av_packet_unref(d->pkt);
+    if (!data || size <= 0)
+        return false;
+
+    auto holder = new std::function<void()>(release);
+    d->pkt->buf = av_buffer_create(data, size + AV_INPUT_BUFFER_PADDING_SIZE, releaseFunction, holder, AV_BUFFER_FLAG_READONLY);
+    if (!d->pkt->buf) {
+        delete holder;
+        return false;
+    }
+    d->pkt->data = data;
+    d->pkt->size = size;
+    return true;
+}
+
 double QAVPacket::duration() const
 {
     Q_D(const QAVPacket);
@@ -21,6 +21,8 @@
 
 #include "qavframe.h"
 #include "qavstream.h"
+#include <QByteArray>
+#include <functional>
 #include <memory>
 
 QT_BEGIN_NAMESPACE
@@ -37,6 +39,13 @@ public:
     operator bool() const;
 
     AVPacket *packet() const;
+
+    // Payload referenced without copying, the packet is reset.
+    // The byte array is kept alive until the last reference to the packet is released. It is not copied
+    // if AV_INPUT_BUFFER_PADDING_SIZE zeroed bytes are reserved after the data, e.g. by resize() and resize() back.
+    bool setData(const QByteArray &data);
+    // The buffer must have AV_INPUT_BUFFER_PADDING_SIZE zeroed bytes after size, release is called when it is not used
+    bool setData(uint8_t *data, int size, const std::function<void()> &release);
     double duration() const;
     double pts() const;
 
@@ -18,6 +18,12 @@
 #include "qavvideofilter_p.h"
 #include "qavaudiofilter_p.h"
 #include "qavfilters_p.h"
+#include "qavtimestretch_p.h"
+#include "qavaudiomixer_p.h"
+#include "qavaudiometer.h"
+#include "qavpushdevice_p.h"
+#include "qavtimeshiftbuffer_p.h"
+#include "qavrecorder_p.h"
 #include <QtConcurrent/qtconcurrentrun.h>
 #include <QLoggingCategory>
 #include <functional>
@@ -30,6 +36,9 @@ QT_BEGIN_NAMESPACE
 
 Q_LOGGING_CATEGORY(lcAVPlayer, "qt.QtAVPlayer")
 
+// Source of the pushed data or packets
+static const char pushUrl[] = "push:";
+
 enum PendingMediaStatus
 {
     LoadingMedia,
@@ -51,7 +60,7 @@ public:
         , audioQueue(AVMEDIA_TYPE_AUDIO, demuxer)
         , subtitleQueue(AVMEDIA_TYPE_SUBTITLE, demuxer)
     {
-        threadPool.setMaxThreadCount(4);
+        threadPool.setMaxThreadCount(5);
     }
 
     QAVPlayer::Error currentError() const;
@@ -79,6 +88,7 @@ public:
     void wait(bool v);
     void doLoad();
     void doDemux();
+    void doTimeshift();
     bool skipFrame(
         bool master,
         const QAVStreamFrame &frame,
@@ -128,6 +138,11 @@ public:
     mutable QMutex positionMutex;
     bool synced = true;
 
+    // External master clock to sync the video, e.g. the position of played audio
+    std::function<double()> masterClock;
+    mutable QMutex masterClockMutex;
+    double syncOffset = NAN;
+
     QAVPlayer::Error error = QAVPlayer::NoError;
 
     QAVDemuxer demuxer;
@@ -143,6 +158,41 @@ public:
     QFuture<void> audioPlayFuture;
     QAVPacketQueue<QAVFrame> audioQueue;
     QAVQueueClock audioClock;
+    // Used only by the audio thread
+    QAVTimeStretch timeStretch;
+    // Set after seeking to drop the stretched audio of the previous position
+    std::atomic_bool timeStretchReset {false};
+    QAVAudioMixer audioMixer;
+    bool audioMixing = false;
+    QMap<int, double> audioGains;
+    mutable QMutex audioMixingMutex;
+    // Meters of decoded streams by index
+    std::map<int, std::unique_ptr<QAVAudioMeter>> audioMeters;
+
+    // Pushed encoded data, or pushed packets of the streams if pushParams is not empty
+    QSharedPointer<QAVPushDevice> pushDevice;
+    qint64 pushBufferSize = 4 * 1024 * 1024;
+    QList<AVCodecParameters *> pendingPushParams;
+    QList<AVRational> pendingPushTimeBases;
+    QList<AVCodecParameters *> pushParams;
+    QList<AVRational> pushTimeBases;
+    std::atomic_bool pushFull {false};
+    void clearPushSource();
+    bool pushPacket(int stream, QAVPacket &pkt);
+    void setSource(const QString &url, const QSharedPointer<QAVIODevice> &dev);
+
+    // Packets of the source are kept for rewinding if the duration is set, applied on setSource()
+    QFuture<void> timeshiftFuture;
+    QAVTimeshiftBuffer timeshift;
+    int timeshiftDuration = 0;
+    bool timeshifted = false;
+
+    // Packets sent to the decoders are remuxed to the file
+    QAVRecorder recorder;
+
+    int audioLevelsInterval = 0;
+    bool audioLoudness = false;
+    mutable QMutex audioLevelsMutex;
 
     QFuture<void> subtitlePlayFuture;
     QAVPacketQueue<QAVSubtitleFrame> subtitleQueue;
@@ -319,12 +369,18 @@ void QAVPlayerPrivate::terminate()
 
     if (dev)
         dev->abort(true);
+    if (pushDevice)
+        pushDevice->stop();
     demuxer.abort();
     demuxerFuture.waitForFinished();
+    timeshiftFuture.waitForFinished();
     loaderFuture.waitForFinished();
     videoPlayFuture.waitForFinished();
     audioPlayFuture.waitForFinished();
     demuxer.abort(false);
+    timeshift.clear();
+    timeshifted = false;
+    recorder.stop(false);
 
     videoFrameRate = 0.0;
     videoQueue.clear();
@@ -508,7 +564,18 @@ void QAVPlayerPrivate::doLoad()
 {
     demuxer.abort(false);
     demuxer.unload();
-    int ret = demuxer.load(url, dev.get());
+    int ret = 0;
+    if (!pushParams.isEmpty()) {
+        QList<const AVCodecParameters *> params;
+        for (auto par : pushParams)
+            params.append(par);
+        ret = demuxer.load(params, pushTimeBases);
+    } else {
+        ret = demuxer.load(url, dev.get());
+    }
+    timeshift.clear();
+    timeshift.setDuration(timeshiftDuration);
+    timeshifted = timeshiftDuration > 0 && pushParams.isEmpty();
     if (ret < 0) {
         setError(QAVPlayer::ResourceError, err_str(ret));
         return;
@@ -530,6 +597,8 @@ void QAVPlayerPrivate::doLoad()
 
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     demuxerFuture = QtConcurrent::run(&threadPool, this, &QAVPlayerPrivate::doDemux);
+    if (timeshifted)
+        timeshiftFuture = QtConcurrent::run(&threadPool, this, &QAVPlayerPrivate::doTimeshift);
     if (!q_ptr->availableVideoStreams().isEmpty())
         videoPlayFuture = QtConcurrent::run(&threadPool, this, &QAVPlayerPrivate::doPlayVideo);
     if (!q_ptr->availableAudioStreams().isEmpty())
@@ -538,6 +607,8 @@ void QAVPlayerPrivate::doLoad()
         subtitlePlayFuture = QtConcurrent::run(&threadPool, this, &QAVPlayerPrivate::doPlaySubtitle);
 #else
     demuxerFuture = QtConcurrent::run(&threadPool, &QAVPlayerPrivate::doDemux, this);
+    if (timeshifted)
+        timeshiftFuture = QtConcurrent::run(&threadPool, &QAVPlayerPrivate::doTimeshift, this);
     if (!q_ptr->availableVideoStreams().isEmpty())
         videoPlayFuture = QtConcurrent::run(&threadPool, &QAVPlayerPrivate::doPlayVideo, this);
     if (!q_ptr->availableAudioStreams().isEmpty())
@@ -548,13 +619,18 @@ void QAVPlayerPrivate::doLoad()
     qCDebug(lcAVPlayer) << __FUNCTION__ << "finished";
 }
 
+// Packets queued for decoding
+static const int maxQueueBytes = 15 * 1024 * 1024;
+
 void QAVPlayerPrivate::doDemux()
 {
-    const int maxQueueBytes = 15 * 1024 * 1024;
     QMutex waiterMutex;
     QWaitCondition waiter;
 
     while (!quit) {
+        if (pushFull && videoQueue.bytes() + audioQueue.bytes() < maxQueueBytes / 2 && pushFull.exchange(false))
+            Q_EMIT q_ptr->pushBufferReady();
+
         if (videoQueue.bytes() + audioQueue.bytes() > maxQueueBytes
             || (videoQueue.enough() && audioQueue.enough())
             || !startDemuxing)
@@ -567,14 +643,15 @@ void QAVPlayerPrivate::doDemux()
         {
             QMutexLocker locker(&positionMutex);
             if (pendingSeek) {
+                // Negative position is from live if timeshifted
                 if (pendingPosition < 0)
-                    pendingPosition += demuxer.duration();
+                    pendingPosition += timeshifted ? timeshift.end() : demuxer.duration();
                 if (pendingPosition < 0)
                     pendingPosition = 0;
                 const double pos = pendingPosition;
                 locker.unlock();
                 qCDebug(lcAVPlayer) << "Seeking to pos:" << pos * 1000;
-                int ret = demuxer.seek(pos);
+                int ret = timeshifted ? timeshift.seek(pos) : demuxer.seek(pos);
                 if (ret >= 0) {
                     qCDebug(lcAVPlayer) << "Waiting video thread finished processing packets";
                     videoQueue.waitForEmpty();
@@ -582,6 +659,7 @@ void QAVPlayerPrivate::doDemux()
                     qCDebug(lcAVPlayer) << "Waiting audio thread finished processing packets";
                     audioQueue.waitForEmpty();
                     audioClock.clear();
+                    timeStretchReset = true;
                     qCDebug(lcAVPlayer) << "Waiting subtitle thread finished processing packets";
                     subtitleQueue.waitForEmpty();
                     subtitleClock.clear();
@@ -589,6 +667,7 @@ void QAVPlayerPrivate::doDemux()
                     demuxer.flushCodecBuffers();
                     qCDebug(lcAVPlayer) << "Reset filters";
                     applyFilters(true, {});
+                    recorder.discontinuity();
                     qCDebug(lcAVPlayer) << "Start reading packets from" << pos * 1000;
                 } else {
                     qWarning() << "Could not seek:" << ret << ":" << err_str(ret);
@@ -599,9 +678,10 @@ void QAVPlayerPrivate::doDemux()
             }
         }
 
-        auto packet = demuxer.read();
+        auto packet = timeshifted ? timeshift.read() : demuxer.read();
         if (packet.stream()) {
             endOfFile(false);
+            recorder.write(packet);
             // Empty packet points to EOF and it needs to flush codecs
             switch (demuxer.currentCodecType(packet.packet()->stream_index)) {
                 case AVMEDIA_TYPE_VIDEO:
@@ -618,6 +698,7 @@ void QAVPlayerPrivate::doDemux()
             }
         } else {
             if (demuxer.eof()
+                && (!timeshifted || timeshift.isLive())
                 && videoQueue.isEmpty()
                 && audioQueue.isEmpty()
                 && subtitleQueue.isEmpty()
@@ -625,6 +706,7 @@ void QAVPlayerPrivate::doDemux()
                 && !isEndOfFile())
             {
                 filters.flush();
+                recorder.stop(false);
                 endOfFile(true);
                 qCDebug(lcAVPlayer) << "EndOfMedia";
                 setPendingMediaStatus(EndOfMedia);
@@ -639,6 +721,24 @@ void QAVPlayerPrivate::doDemux()
     qCDebug(lcAVPlayer) << __FUNCTION__ << "finished";
 }
 
+void QAVPlayerPrivate::doTimeshift()
+{
+    QMutex waiterMutex;
+    QWaitCondition waiter;
+
+    // The source is read even if paused or the queues are full
+    while (!quit) {
+        auto packet = demuxer.read();
+        if (packet.stream()) {
+            timeshift.write(packet);
+        } else {
+            QMutexLocker locker(&waiterMutex);
+            waiter.wait(&waiterMutex, 10);
+        }
+    }
+    qCDebug(lcAVPlayer) << __FUNCTION__ << "finished";
+}
+
 static double streamDuration(const QAVStreamFrame &frame, const QAVDemuxer &demuxer)
 {
     double duration = demuxer.duration();
@@ -769,13 +869,27 @@ void QAVPlayerPrivate::doPlayVideo()
     bool sync = true;
 
     while (!quit) {
+        double refPts = !demuxer.currentAudioStreams().isEmpty() ? audioClock.pts() : -1;
+        {
+            QMutexLocker locker(&masterClockMutex);
+            const double clock = masterClock ? masterClock() : NAN;
+            if (!isnan(clock) && clock > 0)
+                refPts = clock;
+        }
+
         doPlayStep(
             master,
-            !demuxer.currentAudioStreams().isEmpty() ? audioClock.pts() : -1,
+            refPts,
             videoClock,
             videoQueue,
             sync,
-            [&](const QAVFrame &frame) { Q_EMIT q_ptr->videoFrame(frame); }
+            [&](const QAVFrame &frame) {
+                if (refPts > 0) {
+                    QMutexLocker locker(&positionMutex);
+                    syncOffset = frame.pts() - refPts;
+                }
+                Q_EMIT q_ptr->videoFrame(frame);
+            }
         );
     }
 
@@ -791,6 +905,51 @@ void QAVPlayerPrivate::doPlayAudio()
     const double ref = -1;
     bool sync = true;
 
+    bool stretching = false;
+    auto play = [this, &stretching](const QAVFrame &frame) {
+        const double speed = q_ptr->speed();
+        if (timeStretchReset.exchange(false))
+            timeStretch.reset();
+        if (qFuzzyCompare(speed, 1.0)) {
+            // Drops the buffered audio once when the speed is back to normal
+            if (stretching)
+                timeStretch.reset();
+            stretching = false;
+            Q_EMIT q_ptr->audioFrame(frame);
+            return;
+        }
+
+        stretching = true;
+
+        // Keeps the pitch and the sample rate, the audio output is not reset
+        auto stretched = timeStretch.process(frame, speed);
+        if (stretched)
+            Q_EMIT q_ptr->audioFrame(stretched);
+    };
+
+    auto measure = [this](const QAVFrame &frame) {
+        int interval = 0;
+        bool loudness = false;
+        {
+            QMutexLocker locker(&audioLevelsMutex);
+            interval = audioLevelsInterval;
+            loudness = audioLoudness;
+        }
+        if (interval <= 0) {
+            audioMeters.clear();
+            return;
+        }
+
+        auto &meter = audioMeters[frame.stream().index()];
+        if (!meter)
+            meter.reset(new QAVAudioMeter);
+        meter->setLoudnessEnabled(loudness);
+        meter->process(frame);
+        if (meter->duration() * 1000 >= interval)
+            Q_EMIT q_ptr->audioLevels(meter->takeLevels());
+    };
+
+    bool mixing = false;
     while (!quit) {
         doPlayStep(
             master,
@@ -798,13 +957,35 @@ void QAVPlayerPrivate::doPlayAudio()
             audioClock,
             audioQueue,
             sync,
-            [this](const QAVFrame &frame) {
-                frame.frame()->sample_rate *= q_ptr->speed();
-                Q_EMIT q_ptr->audioFrame(frame);
+            [&](const QAVFrame &frame) {
+                measure(frame);
+                {
+                    QMutexLocker locker(&audioMixingMutex);
+                    mixing = audioMixing;
+                    if (mixing)
+                        audioMixer.setGains(audioGains);
+                }
+                if (!mixing) {
+                    audioMixer.reset();
+                    play(frame);
+                    return;
+                }
+
+                audioMixer.setStreams(demuxer.currentAudioStreams());
+                for (const auto &mixed : audioMixer.write(frame))
+                    play(mixed);
             }
         );
+
+        // Streams which are behind are not waited for anymore
+        if (mixing && isEndOfFile() && audioQueue.isEmpty()) {
+            for (const auto &mixed : audioMixer.flush())
+                play(mixed);
+        }
     }
 
+    audioMixer.reset();
+    audioMeters.clear();
     audioQueue.clear();
     audioClock.clear();
     if (master)
@@ -869,12 +1050,26 @@ QAVPlayer::QAVPlayer(QObject *parent)
     qRegisterMetaType<MediaStatus>();
     qRegisterMetaType<Error>();
     qRegisterMetaType<QAVStream>();
+    qRegisterMetaType<QAVAudioLevels>();
 }
 
 QAVPlayer::~QAVPlayer()
 {
     Q_D(QAVPlayer);
     d->terminate();
+    d->clearPushSource();
+    for (auto par : d->pendingPushParams)
+        avcodec_parameters_free(&par);
+}
+
+void QAVPlayerPrivate::clearPushSource()
+{
+    pushDevice.reset();
+    for (auto par : pushParams)
+        avcodec_parameters_free(&par);
+    pushParams.clear();
+    pushTimeBases.clear();
+    pushFull = false;
 }
 
 void QAVPlayer::setSource(const QString &url, const QSharedPointer<QAVIODevice> &dev)
@@ -883,23 +1078,33 @@ void QAVPlayer::setSource(const QString &url, const QSharedPointer<QAVIODevice>
     if (d->url == url)
         return;
 
-    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << url;
+    d->setSource(url, dev);
+}
+
+// Loads the source even if the url is the same, e.g. the push source is restarted
+void QAVPlayerPrivate::setSource(const QString &newUrl, const QSharedPointer<QAVIODevice> &newDev)
+{
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << newUrl;
 
-    d->terminate();
-    d->url = url;
-    d->dev = dev;
-    Q_EMIT sourceChanged(url);
-    d->wait(true);
-    d->quit = false;
+    terminate();
+    if (newUrl != QLatin1String(pushUrl))
+        clearPushSource();
+    const bool changed = url != newUrl;
+    url = newUrl;
+    dev = newDev;
+    if (changed)
+        Q_EMIT q_ptr->sourceChanged(url);
+    wait(true);
+    quit = false;
     if (url.isEmpty())
         return;
 
-    d->setPendingMediaStatus(LoadingMedia);
+    setPendingMediaStatus(QAVPlayer::LoadingMedia);
 
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-    d->loaderFuture = QtConcurrent::run(&d->threadPool, d, &QAVPlayerPrivate::doLoad);
+    loaderFuture = QtConcurrent::run(&threadPool, this, &QAVPlayerPrivate::doLoad);
 #else
-    d->loaderFuture = QtConcurrent::run(&d->threadPool, &QAVPlayerPrivate::doLoad, d);
+    loaderFuture = QtConcurrent::run(&threadPool, &QAVPlayerPrivate::doLoad, this);
 #endif
 }
 
@@ -908,6 +1113,177 @@ QString QAVPlayer::source() const
     return d_func()->url;
 }
 
+int QAVPlayer::addPushStream(const AVCodecParameters *params, const AVRational &timeBase)
+{
+    Q_D(QAVPlayer);
+    auto par = avcodec_parameters_alloc();
+    if (!par || avcodec_parameters_copy(par, params) < 0) {
+        qWarning() << "Could not copy codec parameters";
+        avcodec_parameters_free(&par);
+        return -1;
+    }
+    d->pendingPushParams.append(par);
+    d->pendingPushTimeBases.append(timeBase);
+    return d->pendingPushParams.size() - 1;
+}
+
+void QAVPlayer::setPushSource()
+{
+    Q_D(QAVPlayer);
+    // The previous push source is replaced without changing the source
+    d->terminate();
+    d->clearPushSource();
+    QSharedPointer<QAVIODevice> dev;
+    if (!d->pendingPushParams.isEmpty()) {
+        d->pushParams = d->pendingPushParams;
+        d->pushTimeBases = d->pendingPushTimeBases;
+        d->pendingPushParams.clear();
+        d->pendingPushTimeBases.clear();
+    } else {
+        d->pushDevice.reset(new QAVPushDevice(d->pushBufferSize));
+        d->pushDevice->open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+        connect(d->pushDevice.data(), &QAVPushDevice::full, this, &QAVPlayer::pushBufferFull, Qt::DirectConnection);
+        connect(d->pushDevice.data(), &QAVPushDevice::ready, this, &QAVPlayer::pushBufferReady, Qt::DirectConnection);
+        dev.reset(new QAVIODevice(d->pushDevice));
+        // The ring is lock-free, no need to read it on the owner thread
+        dev->setReadMode(QAVIODevice::DirectRead);
+    }
+    d->setSource(QLatin1String(pushUrl), dev);
+}
+
+bool QAVPlayer::pushData(const QByteArray &data)
+{
+    Q_D(QAVPlayer);
+    return d->pushDevice && d->pushDevice->push(data);
+}
+
+bool QAVPlayerPrivate::pushPacket(int stream, QAVPacket &pkt)
+{
+    if (pushParams.isEmpty())
+        return false;
+
+    const auto s = demuxer.stream(stream);
+    if (!s)
+        return false;
+
+    if (videoQueue.bytes() + audioQueue.bytes() > maxQueueBytes) {
+        if (!pushFull.exchange(true))
+            Q_EMIT q_ptr->pushBufferFull();
+        return false;
+    }
+
+    pkt.packet()->stream_index = stream;
+    pkt.setStream(s);
+    switch (demuxer.currentCodecType(stream)) {
+        case AVMEDIA_TYPE_VIDEO:
+            videoQueue.enqueue(pkt);
+            break;
+        case AVMEDIA_TYPE_AUDIO:
+            audioQueue.enqueue(pkt);
+            break;
+        case AVMEDIA_TYPE_SUBTITLE:
+            subtitleQueue.enqueue(pkt);
+            break;
+        default:
+            return false;
+    }
+    // Nothing is demuxed, the pushed packets are recorded instead
+    recorder.write(pkt);
+    return true;
+}
+
+bool QAVPlayer::pushPacket(int stream, const AVPacket *packet)
+{
+    Q_D(QAVPlayer);
+    QAVPacket pkt;
+    if (!packet || av_packet_ref(pkt.packet(), packet) < 0)
+        return false;
+    return d->pushPacket(stream, pkt);
+}
+
+bool QAVPlayer::pushPacket(int stream, const QByteArray &data, qint64 pts, qint64 dts, int flags)
+{
+    Q_D(QAVPlayer);
+    QAVPacket pkt;
+    if (!pkt.setData(data))
+        return false;
+    pkt.packet()->pts = pts;
+    pkt.packet()->dts = dts;
+    pkt.packet()->flags = flags;
+    return d->pushPacket(stream, pkt);
+}
+
+void QAVPlayer::endPush()
+{
+    Q_D(QAVPlayer);
+    if (d->pushDevice)
+        d->pushDevice->end();
+    if (!d->pushParams.isEmpty())
+        d->demuxer.endOfStreams();
+}
+
+qint64 QAVPlayer::pushBufferSize() const
+{
+    return d_func()->pushBufferSize;
+}
+
+void QAVPlayer::setPushBufferSize(qint64 bytes)
+{
+    Q_D(QAVPlayer);
+    d->pushBufferSize = bytes;
+}
+
+int QAVPlayer::timeshiftDuration() const
+{
+    return d_func()->timeshiftDuration;
+}
+
+void QAVPlayer::setTimeshiftDuration(int seconds)
+{
+    Q_D(QAVPlayer);
+    d->timeshiftDuration = qMax(seconds, 0);
+}
+
+qint64 QAVPlayer::timeshiftStart() const
+{
+    return d_func()->timeshift.start() * 1000;
+}
+
+qint64 QAVPlayer::timeshiftEnd() const
+{
+    return d_func()->timeshift.end() * 1000;
+}
+
+bool QAVPlayer::startRecording(const QString &fileName, const QString &format)
+{
+    Q_D(QAVPlayer);
+    const auto streams = d->demuxer.currentVideoStreams()
+        + d->demuxer.currentAudioStreams()
+        + d->demuxer.currentSubtitleStreams();
+    return d->recorder.start(fileName, format, streams);
+}
+
+void QAVPlayer::stopRecording(bool atKeyframe)
+{
+    Q_D(QAVPlayer);
+    d->recorder.stop(atKeyframe);
+}
+
+bool QAVPlayer::isRecording() const
+{
+    return d_func()->recorder.isRecording();
+}
+
+qint64 QAVPlayer::recordedBytes() const
+{
+    return d_func()->recorder.bytesWritten();
+}
+
+qint64 QAVPlayer::droppedRecordingBytes() const
+{
+    return d_func()->recorder.bytesDropped();
+}
+
 QList<QAVStream> QAVPlayer::availableVideoStreams() const
 {
     Q_D(const QAVPlayer);
@@ -1259,6 +1635,76 @@ void QAVPlayer::setSynced(bool sync)
     Q_EMIT syncedChanged(sync);
 }
 
+bool QAVPlayer::isAudioMixed() const
+{
+    Q_D(const QAVPlayer);
+    QMutexLocker locker(&d->audioMixingMutex);
+    return d->audioMixing;
+}
+
+void QAVPlayer::setAudioMixed(bool mixed)
+{
+    Q_D(QAVPlayer);
+    QMutexLocker locker(&d->audioMixingMutex);
+    d->audioMixing = mixed;
+}
+
+double QAVPlayer::audioStreamGain(const QAVStream &stream) const
+{
+    Q_D(const QAVPlayer);
+    QMutexLocker locker(&d->audioMixingMutex);
+    return d->audioGains.value(stream.index(), 1.0);
+}
+
+void QAVPlayer::setAudioStreamGain(const QAVStream &stream, double gain)
+{
+    Q_D(QAVPlayer);
+    QMutexLocker locker(&d->audioMixingMutex);
+    d->audioGains[stream.index()] = qMax(0.0, gain);
+}
+
+int QAVPlayer::audioLevelsInterval() const
+{
+    Q_D(const QAVPlayer);
+    QMutexLocker locker(&d->audioLevelsMutex);
+    return d->audioLevelsInterval;
+}
+
+void QAVPlayer::setAudioLevelsInterval(int ms)
+{
+    Q_D(QAVPlayer);
+    QMutexLocker locker(&d->audioLevelsMutex);
+    d->audioLevelsInterval = ms;
+}
+
+bool QAVPlayer::isAudioLoudnessEnabled() const
+{
+    Q_D(const QAVPlayer);
+    QMutexLocker locker(&d->audioLevelsMutex);
+    return d->audioLoudness;
+}
+
+void QAVPlayer::setAudioLoudnessEnabled(bool enabled)
+{
+    Q_D(QAVPlayer);
+    QMutexLocker locker(&d->audioLevelsMutex);
+    d->audioLoudness = enabled;
+}
+
+void QAVPlayer::setMasterClock(const std::function<double()> &clock)
+{
+    Q_D(QAVPlayer);
+    QMutexLocker locker(&d->masterClockMutex);
+    d->masterClock = clock;
+}
+
+double QAVPlayer::syncOffset() const
+{
+    Q_D(const QAVPlayer);
+    QMutexLocker locker(&d->positionMutex);
+    return d->syncOffset;
+}
+
 QString QAVPlayer::inputFormat() const
 {
     Q_D(const QAVPlayer);
@@ -1295,6 +1741,41 @@ void QAVPlayer::setInputVideoCodec(const QString &codec)
     Q_EMIT inputVideoCodecChanged(codec);
 }
 
+QString QAVPlayer::seekIndexDirectory() const
+{
+    return d_func()->demuxer.seekIndexDirectory();
+}
+
+void QAVPlayer::setSeekIndexDirectory(const QString &dir)
+{
+    Q_D(QAVPlayer);
+    d->demuxer.setSeekIndexDirectory(dir);
+}
+
+bool QAVPlayer::isSeekIndexPrescan() const
+{
+    return d_func()->demuxer.seekIndexPrescan();
+}
+
+void QAVPlayer::setSeekIndexPrescan(bool enabled)
+{
+    Q_D(QAVPlayer);
+    d->demuxer.setSeekIndexPrescan(enabled);
+}
+
+QSharedPointer<QAVVideoFrameAllocator> QAVPlayer::videoFrameAllocator() const
+{
+    Q_D(const QAVPlayer);
+    return d->demuxer.videoFrameAllocator();
+}
+
+void QAVPlayer::setVideoFrameAllocator(const QSharedPointer<QAVVideoFrameAllocator> &allocator)
+{
+    Q_D(QAVPlayer);
+    qCDebug(lcAVPlayer) << __FUNCTION__ << ":" << allocator.data();
+    d->demuxer.setVideoFrameAllocator(allocator);
+}
+
 QStringList QAVPlayer::supportedVideoCodecs()
 {
     return QAVDemuxer::supportedVideoCodecs();
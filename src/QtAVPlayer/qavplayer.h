@@ -12,14 +12,20 @@
 #include <QtAVPlayer/qavaudioframe.h>
 #include <QtAVPlayer/qavsubtitleframe.h>
 #include <QtAVPlayer/qavstream.h>
+#include <QtAVPlayer/qavvideoframeallocator.h>
+#include <QtAVPlayer/qavaudiometer.h>
 #include <QtAVPlayer/qtavplayerglobal.h>
 #include <QString>
+#include <functional>
 #include <memory>
 
 QT_BEGIN_NAMESPACE
 
 class QAVIODevice;
 class QAVPlayerPrivate;
+struct AVCodecParameters;
+struct AVPacket;
+struct AVRational;
 class QAVPlayer : public QObject
 {
     Q_OBJECT
@@ -56,6 +62,47 @@ public:
     void setSource(const QString &url, const QSharedPointer<QAVIODevice> &dev = {});
     QString source() const;
 
+    // Encoded data pushed by the application instead of reading the source.
+    // Adds a stream of packets pushed by pushPacket(), returns its index. Used by the next setPushSource().
+    int addPushStream(const AVCodecParameters *params, const AVRational &timeBase);
+    // Switches the source to the pushed packets if any push streams are added, or to the data pushed by pushData()
+    void setPushSource();
+    // Bytes of a container or elementary stream, demuxed as the source. Could be called from any one thread.
+    // Returns false and emits pushBufferFull() if the data does not fit, it should be pushed again after pushBufferReady().
+    bool pushData(const QByteArray &data);
+    // Packet of the push stream sent to the decoder without demuxing, returns false until mediaStatus() is LoadedMedia.
+    // The buffer is referenced if it is refcounted. Returns false and emits pushBufferFull() if too many packets are queued.
+    // The packets are recorded by startRecording(), but not kept by the timeshift buffer.
+    bool pushPacket(int stream, const AVPacket *packet);
+    // Payload of the packet in the stream's time base, e.g. an Annex B access unit.
+    // Not copied if AV_INPUT_BUFFER_PADDING_SIZE zeroed bytes are reserved after the data, flags are AV_PKT_FLAG_*.
+    bool pushPacket(int stream, const QByteArray &data, qint64 pts, qint64 dts, int flags = 0);
+    // No more data or packets, EndOfMedia is reached when everything is played
+    void endPush();
+    // Size of the ring for pushData(), applied on setPushSource()
+    qint64 pushBufferSize() const;
+    void setPushBufferSize(qint64 bytes);
+
+    // Packets of the last seconds of the source are kept, e.g. for live streams, 0 disables. Applied on setSource().
+    // The source is read even if paused, seek() moves within the buffer to the keyframes
+    // and negative positions are from live, seek(-1) catches up to live.
+    int timeshiftDuration() const;
+    void setTimeshiftDuration(int seconds);
+    // Range of the buffer in ms
+    qint64 timeshiftStart() const;
+    qint64 timeshiftEnd() const;
+
+    // Packets of the current streams are remuxed to the file without decoding, e.g. to mp4, mkv or ts.
+    // The format is guessed from the name if empty. Recording starts from the next keyframe
+    // and stops at the end of media. The file is written on its own thread,
+    // packets are dropped until the next keyframe if it falls behind.
+    bool startRecording(const QString &fileName, const QString &format = QString());
+    // Stops before the next keyframe, or at once. Also stops if no keyframe comes within 5 seconds.
+    void stopRecording(bool atKeyframe = true);
+    bool isRecording() const;
+    qint64 recordedBytes() const;
+    qint64 droppedRecordingBytes() const;
+
     QList<QAVStream> availableVideoStreams() const;
     QList<QAVStream> currentVideoStreams() const;
     void setVideoStream(const QAVStream &stream);
@@ -90,13 +137,46 @@ public:
     bool isSynced() const;
     void setSynced(bool sync);
 
+    // Frames of all current audio streams are mixed and emitted as one stream in interleaved float.
+    // Streams are aligned by pts and resampled to the format of the first one.
+    bool isAudioMixed() const;
+    void setAudioMixed(bool mixed);
+    // Linear gain applied to the stream while mixing, 1.0 by default
+    double audioStreamGain(const QAVStream &stream) const;
+    void setAudioStreamGain(const QAVStream &stream, double gain);
+
+    // audioLevels() is emitted for every decoded audio stream after each interval of audio in ms, 0 disables
+    int audioLevelsInterval() const;
+    void setAudioLevelsInterval(int ms);
+    // Adds EBU R128 momentary loudness to the levels
+    bool isAudioLoudnessEnabled() const;
+    void setAudioLoudnessEnabled(bool enabled);
+
+    // Video is synced to the clock instead of the pts of the last emitted audio frame,
+    // e.g. QAVAudioOutput::playedPts(). Called from the video thread, NAN or negative values are ignored.
+    void setMasterClock(const std::function<double()> &clock);
+    // Difference between the pts of the last video frame and the master clock in seconds
+    double syncOffset() const;
+
     QString inputFormat() const;
     void setInputFormat(const QString &format);
 
     QString inputVideoCodec() const;
     void setInputVideoCodec(const QString &codec);
+
+    // Keyframes are indexed by the byte offsets and used to seek formats without a proper index, e.g. MPEG-TS.
+    // The index of local files is saved to the directory keyed by the size and mtime, applied on setSource().
+    QString seekIndexDirectory() const;
+    void setSeekIndexDirectory(const QString &dir);
+    // The whole file is indexed in background after loading
+    bool isSeekIndexPrescan() const;
+    void setSeekIndexPrescan(bool enabled);
     static QStringList supportedVideoCodecs();
 
+    // Video frames are decoded to the buffers from the allocator, applied on setSource()
+    QSharedPointer<QAVVideoFrameAllocator> videoFrameAllocator() const;
+    void setVideoFrameAllocator(const QSharedPointer<QAVVideoFrameAllocator> &allocator);
+
     QMap<QString, QString> inputOptions() const;
     void setInputOptions(const QMap<QString, QString> &opts);
 
@@ -138,6 +218,10 @@ Q_SIGNALS:
     void videoFrame(const QAVVideoFrame &frame);
     void audioFrame(const QAVAudioFrame &frame);
     void subtitleFrame(const QAVSubtitleFrame &frame);
+    void audioLevels(const QAVAudioLevels &levels);
+    // Emitted from the thread which pushes or the decoding thread
+    void pushBufferFull();
+    void pushBufferReady();
 
 public:
     static void setLogsLevelBackend(int level);
@@ -0,0 +1,149 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavpushdevice_p.h"
+#include <QDebug>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+
+QT_BEGIN_NAMESPACE
+
+class QAVPushDevicePrivate
+{
+public:
+    std::unique_ptr<char[]> buffer;
+    qint64 capacity = 0;
+    // The positions only grow, the producer owns writePos and the consumer owns readPos
+    std::atomic<qint64> readPos{0};
+    std::atomic<qint64> writePos{0};
+    std::atomic<bool> ended{false};
+    std::atomic<bool> stopped{false};
+    // full() is emitted and ready() is not yet
+    std::atomic<bool> full{false};
+    // Only to wait for the data, the ring itself is lock-free
+    QMutex mutex;
+    QWaitCondition pushed;
+
+    void wake()
+    {
+        QMutexLocker locker(&mutex);
+        pushed.wakeAll();
+    }
+};
+
+QAVPushDevice::QAVPushDevice(qint64 capacity, QObject *parent)
+    : QIODevice(parent)
+    , d_ptr(new QAVPushDevicePrivate)
+{
+    Q_D(QAVPushDevice);
+    d->capacity = qMax<qint64>(capacity, 4096);
+    d->buffer.reset(new char[d->capacity]);
+}
+
+QAVPushDevice::~QAVPushDevice()
+{
+    stop();
+}
+
+bool QAVPushDevice::push(const QByteArray &data)
+{
+    Q_D(QAVPushDevice);
+    if (d->ended.load() || d->stopped.load())
+        return false;
+    if (data.size() > d->capacity) {
+        qWarning() << "QAVPushDevice: Data is bigger than the buffer:" << data.size() << ">" << d->capacity;
+        return false;
+    }
+
+    const qint64 writePos = d->writePos.load(std::memory_order_relaxed);
+    const qint64 readPos = d->readPos.load(std::memory_order_acquire);
+    if (d->capacity - (writePos - readPos) < data.size()) {
+        if (!d->full.exchange(true)) {
+            Q_EMIT full();
+            // The reader could drain the ring before full was set and did not emit ready() then
+            if (writePos - d->readPos.load() <= d->capacity / 2 && d->full.exchange(false))
+                Q_EMIT ready();
+        }
+        return false;
+    }
+
+    const qint64 bytes = data.size();
+    const qint64 offset = writePos % d->capacity;
+    const qint64 head = qMin(bytes, d->capacity - offset);
+    memcpy(d->buffer.get() + offset, data.constData(), static_cast<size_t>(head));
+    memcpy(d->buffer.get(), data.constData() + head, static_cast<size_t>(bytes - head));
+    d->writePos.store(writePos + bytes, std::memory_order_release);
+    d->wake();
+    return true;
+}
+
+void QAVPushDevice::end()
+{
+    Q_D(QAVPushDevice);
+    d->ended = true;
+    d->wake();
+}
+
+void QAVPushDevice::stop()
+{
+    Q_D(QAVPushDevice);
+    d->stopped = true;
+    d->wake();
+}
+
+qint64 QAVPushDevice::capacity() const
+{
+    return d_func()->capacity;
+}
+
+qint64 QAVPushDevice::bytesInQueue() const
+{
+    Q_D(const QAVPushDevice);
+    return d->writePos.load(std::memory_order_acquire) - d->readPos.load(std::memory_order_acquire);
+}
+
+bool QAVPushDevice::atEnd() const
+{
+    Q_D(const QAVPushDevice);
+    return d->stopped.load() || (d->ended.load() && !bytesInQueue());
+}
+
+qint64 QAVPushDevice::bytesAvailable() const
+{
+    return bytesInQueue() + QIODevice::bytesAvailable();
+}
+
+qint64 QAVPushDevice::readData(char *data, qint64 maxSize)
+{
+    Q_D(QAVPushDevice);
+    qint64 writePos = d->writePos.load(std::memory_order_acquire);
+    const qint64 readPos = d->readPos.load(std::memory_order_relaxed);
+    if (writePos == readPos) {
+        // Checked again under the mutex, push() wakes after the data is stored
+        QMutexLocker locker(&d->mutex);
+        while ((writePos = d->writePos.load(std::memory_order_acquire)) == readPos) {
+            if (d->stopped.load() || d->ended.load())
+                return 0;
+            d->pushed.wait(&d->mutex);
+        }
+    }
+
+    const qint64 bytes = qMin(maxSize, writePos - readPos);
+    const qint64 offset = readPos % d->capacity;
+    const qint64 head = qMin(bytes, d->capacity - offset);
+    memcpy(data, d->buffer.get() + offset, static_cast<size_t>(head));
+    memcpy(data + head, d->buffer.get(), static_cast<size_t>(bytes - head));
+    // Sequentially consistent with full, so either this or push() sees the other's update
+    d->readPos.store(readPos + bytes);
+
+    if (d->full.load() && writePos - (readPos + bytes) <= d->capacity / 2 && d->full.exchange(false))
+        Q_EMIT ready();
+    return bytes;
+}
+
+QT_END_NAMESPACE
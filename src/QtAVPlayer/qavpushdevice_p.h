@@ -0,0 +1,70 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVPUSHDEVICE_P_H
+#define QAVPUSHDEVICE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <QIODevice>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+class QAVPushDevicePrivate;
+// Sequential device over a single producer single consumer ring:
+// push() is called by the application, readData() by the demuxer.
+class QAVPushDevice : public QIODevice
+{
+    Q_OBJECT
+public:
+    QAVPushDevice(qint64 capacity, QObject *parent = nullptr);
+    ~QAVPushDevice();
+
+    // Returns false and emits full() if the data does not fit into the ring
+    bool push(const QByteArray &data);
+    // No more data will be pushed
+    void end();
+    // Unblocks readData()
+    void stop();
+
+    qint64 capacity() const;
+    qint64 bytesInQueue() const;
+
+    bool isSequential() const override { return true; }
+    bool atEnd() const override;
+    qint64 bytesAvailable() const override;
+
+Q_SIGNALS:
+    void full();
+    // Emitted from the reading thread when a half of the ring is free after full()
+    void ready();
+
+protected:
+    // Blocks until some data is pushed, end() or stop()
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    Q_DISABLE_COPY(QAVPushDevice)
+    Q_DECLARE_PRIVATE(QAVPushDevice)
+    std::unique_ptr<QAVPushDevicePrivate> d_ptr;
+};
+
+QT_END_NAMESPACE
+
+#endif
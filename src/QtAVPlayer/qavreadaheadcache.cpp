@@ -0,0 +1,295 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavreadaheadcache_p.h"
+#include <QtConcurrent/qtconcurrentrun.h>
+#include <QThreadPool>
+#include <QFuture>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QTimer>
+#include <atomic>
+
+extern "C" {
+#include <libavutil/error.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+// Max bytes read from the device at once
+static const qint64 maxChunk = 256 * 1024;
+
+class QAVReadAheadCachePrivate
+{
+public:
+    QSharedPointer<QIODevice> device;
+    std::unique_ptr<char[]> ring;
+    qint64 capacity = 0;
+    // Bytes kept behind the read position
+    qint64 backward = 0;
+
+    // Offsets in the device, [start, end) is in the ring
+    qint64 start = 0;
+    qint64 end = 0;
+    qint64 readPos = 0;
+    qint64 deviceSize = 0;
+    bool eof = false;
+    bool quit = false;
+    bool aborted = false;
+    // The device must be seeked to end
+    bool seekPending = false;
+    // Incremented when the ring is dropped, the data read before is ignored
+    quint64 generation = 0;
+
+    std::atomic<quint64> hits{0};
+    std::atomic<quint64> misses{0};
+
+    mutable QMutex mutex;
+    QWaitCondition dataReady;
+    QWaitCondition spaceReady;
+    QThreadPool threadPool;
+    QFuture<void> future;
+    // Lives on the owner thread if the device is read there instead of the thread pool
+    std::unique_ptr<QObject> context;
+    bool fillPending = false;
+
+    enum State { Filled, NoSpace, NoData, Quit };
+    // Reads one chunk, must be called with the locked mutex
+    State fill();
+    void run();
+    void fillOnOwnerThread();
+    // Must be called with the locked mutex
+    void wakeFiller();
+};
+
+QAVReadAheadCachePrivate::State QAVReadAheadCachePrivate::fill()
+{
+    if (quit)
+        return Quit;
+
+    if (seekPending) {
+        seekPending = false;
+        const qint64 target = end;
+        const quint64 gen = generation;
+        mutex.unlock();
+        const bool ok = device->seek(target);
+        mutex.lock();
+        if (gen == generation && !ok) {
+            eof = true;
+            dataReady.wakeAll();
+        }
+        return Filled;
+    }
+
+    qint64 free = capacity - (end - start);
+    if (free <= 0) {
+        const qint64 evict = readPos - start - backward;
+        if (evict > 0) {
+            start += evict;
+            free += evict;
+        }
+    }
+    if (eof || free <= 0)
+        return NoSpace;
+
+    // Only the filler writes after end, the readers never go past it
+    const qint64 offset = end % capacity;
+    const qint64 bytes = qMin(qMin(free, capacity - offset), maxChunk);
+    const quint64 gen = generation;
+    mutex.unlock();
+    const qint64 read = device->read(ring.get() + offset, bytes);
+    const bool atEnd = read <= 0 && device->atEnd();
+    const qint64 size = device->size();
+    mutex.lock();
+    deviceSize = size;
+    if (gen != generation)
+        return Filled;
+
+    if (read > 0) {
+        end += read;
+        dataReady.wakeAll();
+        return Filled;
+    }
+    if (read < 0 || atEnd) {
+        eof = true;
+        dataReady.wakeAll();
+        return NoSpace;
+    }
+    return NoData;
+}
+
+void QAVReadAheadCachePrivate::run()
+{
+    QMutexLocker locker(&mutex);
+    while (true) {
+        const auto state = fill();
+        if (state == Quit)
+            break;
+        if (state == NoSpace)
+            spaceReady.wait(&mutex);
+        else if (state == NoData)
+            spaceReady.wait(&mutex, 10);
+    }
+}
+
+// One chunk per event, the owner's event loop is not blocked
+void QAVReadAheadCachePrivate::fillOnOwnerThread()
+{
+    QMutexLocker locker(&mutex);
+    fillPending = false;
+    const auto state = fill();
+    if (state == Filled) {
+        wakeFiller();
+    } else if (state == NoData) {
+        // Or earlier on readyRead
+        QTimer::singleShot(10, context.get(), [this] { fillOnOwnerThread(); });
+    }
+}
+
+void QAVReadAheadCachePrivate::wakeFiller()
+{
+    if (!context) {
+        spaceReady.wakeAll();
+        return;
+    }
+
+    if (fillPending || quit)
+        return;
+    fillPending = true;
+    QMetaObject::invokeMethod(context.get(), [this] { fillOnOwnerThread(); }, Qt::QueuedConnection);
+}
+
+QAVReadAheadCache::QAVReadAheadCache(const QSharedPointer<QIODevice> &device, qint64 capacity, QThread *ownerThread)
+    : d_ptr(new QAVReadAheadCachePrivate)
+{
+    Q_D(QAVReadAheadCache);
+    d->device = device;
+    d->capacity = qMax(capacity, maxChunk);
+    d->backward = d->capacity / 4;
+    d->ring.reset(new char[d->capacity]);
+    d->start = d->end = d->readPos = device->pos();
+    d->deviceSize = device->size();
+    if (ownerThread) {
+        d->context.reset(new QObject);
+        d->context->moveToThread(ownerThread);
+        QObject::connect(device.data(), &QIODevice::readyRead, d->context.get(), [d] {
+            QMutexLocker locker(&d->mutex);
+            d->wakeFiller();
+        });
+        QMutexLocker locker(&d->mutex);
+        d->wakeFiller();
+        return;
+    }
+
+    d->threadPool.setMaxThreadCount(1);
+    d->future = QtConcurrent::run(&d->threadPool, [d] { d->run(); });
+}
+
+QAVReadAheadCache::~QAVReadAheadCache()
+{
+    Q_D(QAVReadAheadCache);
+    {
+        QMutexLocker locker(&d->mutex);
+        d->quit = true;
+        d->dataReady.wakeAll();
+        d->spaceReady.wakeAll();
+    }
+    d->future.waitForFinished();
+    // The pending fills are dropped, must be on the owner thread
+    d->context.reset();
+}
+
+int QAVReadAheadCache::read(unsigned char *data, int maxSize)
+{
+    Q_D(QAVReadAheadCache);
+    QMutexLocker locker(&d->mutex);
+    bool waited = false;
+    while (d->readPos >= d->end && !d->eof && !d->aborted && !d->quit) {
+        waited = true;
+        d->wakeFiller();
+        d->dataReady.wait(&d->mutex);
+    }
+
+    if (d->aborted || d->quit)
+        return AVERROR_EXIT;
+    if (waited)
+        ++d->misses;
+    else
+        ++d->hits;
+    if (d->readPos >= d->end)
+        return AVERROR_EOF;
+
+    const qint64 bytes = qMin<qint64>(maxSize, d->end - d->readPos);
+    const qint64 offset = d->readPos % d->capacity;
+    const qint64 head = qMin(bytes, d->capacity - offset);
+    memcpy(data, d->ring.get() + offset, static_cast<size_t>(head));
+    memcpy(data + head, d->ring.get(), static_cast<size_t>(bytes - head));
+    d->readPos += bytes;
+    d->wakeFiller();
+    return int(bytes);
+}
+
+qint64 QAVReadAheadCache::seek(qint64 pos)
+{
+    Q_D(QAVReadAheadCache);
+    QMutexLocker locker(&d->mutex);
+    if (pos < 0 || (d->deviceSize > 0 && pos > d->deviceSize))
+        return -1;
+
+    if (pos >= d->start && pos <= d->end) {
+        ++d->hits;
+        d->readPos = pos;
+        return pos;
+    }
+
+    ++d->misses;
+    ++d->generation;
+    d->start = d->end = d->readPos = pos;
+    d->eof = false;
+    d->seekPending = true;
+    d->wakeFiller();
+    return pos;
+}
+
+qint64 QAVReadAheadCache::pos() const
+{
+    Q_D(const QAVReadAheadCache);
+    QMutexLocker locker(&d->mutex);
+    return d->readPos;
+}
+
+qint64 QAVReadAheadCache::size() const
+{
+    Q_D(const QAVReadAheadCache);
+    QMutexLocker locker(&d->mutex);
+    return d->deviceSize;
+}
+
+void QAVReadAheadCache::abort(bool aborted)
+{
+    Q_D(QAVReadAheadCache);
+    QMutexLocker locker(&d->mutex);
+    d->aborted = aborted;
+    d->dataReady.wakeAll();
+}
+
+qint64 QAVReadAheadCache::capacity() const
+{
+    return d_func()->capacity;
+}
+
+quint64 QAVReadAheadCache::hits() const
+{
+    return d_func()->hits;
+}
+
+quint64 QAVReadAheadCache::misses() const
+{
+    return d_func()->misses;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,64 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVREADAHEADCACHE_P_H
+#define QAVREADAHEADCACHE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <QIODevice>
+#include <QSharedPointer>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+class QThread;
+class QAVReadAheadCachePrivate;
+// Reads the device into a ring ahead of the read position.
+// A quarter of the ring keeps the data already read to serve short backward seeks.
+// The device is only accessed from a background thread, or from ownerThread if it is set:
+// then it is read in chunks by the events of that thread, also on readyRead.
+// Must be destroyed on ownerThread.
+class QAVReadAheadCache
+{
+public:
+    QAVReadAheadCache(const QSharedPointer<QIODevice> &device, qint64 capacity, QThread *ownerThread = nullptr);
+    ~QAVReadAheadCache();
+
+    // Blocks until data is available, returns AVERROR_EOF at the end
+    int read(unsigned char *data, int maxSize);
+    // Returns the new position, the device is seeked only if the position is not cached
+    qint64 seek(qint64 pos);
+    qint64 pos() const;
+    qint64 size() const;
+    void abort(bool aborted);
+
+    qint64 capacity() const;
+    // Reads and seeks served from the ring without waiting
+    quint64 hits() const;
+    // Reads and seeks which had to wait for the device
+    quint64 misses() const;
+
+private:
+    Q_DISABLE_COPY(QAVReadAheadCache)
+    Q_DECLARE_PRIVATE(QAVReadAheadCache)
+    std::unique_ptr<QAVReadAheadCachePrivate> d_ptr;
+};
+
+QT_END_NAMESPACE
+
+#endif
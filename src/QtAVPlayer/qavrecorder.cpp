@@ -0,0 +1,360 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavrecorder_p.h"
+#include <QtConcurrent/qtconcurrentrun.h>
+#include <QThreadPool>
+#include <QFuture>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <atomic>
+#include <map>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+struct QAVRecorderStream
+{
+    int index = -1;
+    AVRational timeBase = {0, 1};
+};
+
+class QAVRecorderPrivate
+{
+public:
+    AVFormatContext *ctx = nullptr;
+    // Output streams by the input indexes
+    std::map<int, QAVRecorderStream> streams;
+    // Time bases of the input by the output indexes
+    std::vector<AVRational> timeBases;
+    int master = -1;
+
+    bool recording = false;
+    bool started = false;
+    bool waitKeyframe = true;
+    bool resync = false;
+    bool stopping = false;
+    bool finishing = false;
+    // Finishes at once if no keyframe comes in time after stop()
+    int stopTimeout = 5000;
+    QElapsedTimer stopTimer;
+    // Subtracted from the timestamps in AV_TIME_BASE, the file starts from 0
+    int64_t offset = 0;
+    int64_t lastEnd = 0;
+
+    QList<QAVPacket> queue;
+    qint64 queueBytes = 0;
+    qint64 maxQueueBytes = 32 * 1024 * 1024;
+    std::atomic<qint64> written{0};
+    std::atomic<qint64> dropped{0};
+
+    mutable QMutex mutex;
+    QWaitCondition cond;
+    QThreadPool threadPool;
+    QFuture<void> future;
+
+    void run();
+};
+
+static void freeContext(AVFormatContext *&ctx)
+{
+    if (!ctx)
+        return;
+    if (ctx->pb && !(ctx->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&ctx->pb);
+    avformat_free_context(ctx);
+    ctx = nullptr;
+}
+
+void QAVRecorderPrivate::run()
+{
+    QMutexLocker locker(&mutex);
+    while (true) {
+        if (stopping && !finishing && stopTimer.hasExpired(stopTimeout)) {
+            qWarning() << "No keyframe to stop recording at, stopped after" << stopTimeout << "ms";
+            finishing = true;
+        }
+        if (queue.isEmpty()) {
+            if (finishing)
+                break;
+            if (stopping)
+                cond.wait(&mutex, qMax<qint64>(1, stopTimeout - stopTimer.elapsed()));
+            else
+                cond.wait(&mutex);
+            continue;
+        }
+
+        QAVPacket packet = queue.takeFirst();
+        auto pkt = packet.packet();
+        queueBytes -= pkt->size;
+        const AVRational tb = timeBases[size_t(pkt->stream_index)];
+        locker.unlock();
+
+        const int size = pkt->size;
+        av_packet_rescale_ts(pkt, tb, ctx->streams[pkt->stream_index]->time_base);
+        int ret = av_interleaved_write_frame(ctx, pkt);
+        if (ret < 0)
+            qWarning() << "Could not write packet:" << ret;
+        // Muxers without a file, e.g. segment or hls, open the files themselves, the payload is counted instead
+        written = ctx->pb ? avio_tell(ctx->pb) : written + size;
+        locker.relock();
+    }
+    locker.unlock();
+
+    int ret = av_write_trailer(ctx);
+    if (ret < 0)
+        qWarning() << "Could not write trailer:" << ret;
+    if (ctx->pb)
+        written = avio_tell(ctx->pb);
+    freeContext(ctx);
+
+    locker.relock();
+    recording = false;
+}
+
+QAVRecorder::QAVRecorder()
+    : d_ptr(new QAVRecorderPrivate)
+{
+    d_ptr->threadPool.setMaxThreadCount(1);
+}
+
+QAVRecorder::~QAVRecorder()
+{
+    stop(false);
+    wait();
+}
+
+bool QAVRecorder::start(const QString &fileName, const QString &format, const QList<QAVStream> &streams)
+{
+    Q_D(QAVRecorder);
+    stop(false);
+    wait();
+
+    QMutexLocker locker(&d->mutex);
+    const QByteArray name = fileName.toUtf8();
+    const QByteArray fmt = format.toUtf8();
+    int ret = avformat_alloc_output_context2(&d->ctx, nullptr, fmt.isEmpty() ? nullptr : fmt.constData(), name.constData());
+    if (ret < 0 || !d->ctx) {
+        qWarning() << "Could not create output format for" << fileName << ":" << ret;
+        return false;
+    }
+
+    d->streams.clear();
+    d->timeBases.clear();
+    d->master = -1;
+    bool video = false;
+    for (const auto &stream : streams) {
+        const auto in = stream.stream();
+        if (!in)
+            continue;
+        if (avformat_query_codec(d->ctx->oformat, in->codecpar->codec_id, FF_COMPLIANCE_NORMAL) == 0) {
+            qWarning() << "Codec is not supported by the format, stream is not recorded:" << stream.index();
+            continue;
+        }
+
+        auto out = avformat_new_stream(d->ctx, nullptr);
+        if (!out || avcodec_parameters_copy(out->codecpar, in->codecpar) < 0) {
+            qWarning() << "Could not add stream:" << stream.index();
+            freeContext(d->ctx);
+            return false;
+        }
+        // The tag of the source container could be invalid for the output
+        out->codecpar->codec_tag = 0;
+        out->time_base = in->time_base;
+        d->streams[stream.index()] = {out->index, in->time_base};
+        d->timeBases.push_back(in->time_base);
+
+        const bool isVideo = in->codecpar->codec_type == AVMEDIA_TYPE_VIDEO;
+        if (d->master < 0 || (isVideo && !video)) {
+            d->master = stream.index();
+            video = isVideo;
+        }
+    }
+
+    if (d->streams.empty()) {
+        qWarning() << "No streams to record";
+        freeContext(d->ctx);
+        return false;
+    }
+
+    if (!(d->ctx->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open(&d->ctx->pb, name.constData(), AVIO_FLAG_WRITE);
+        if (ret < 0) {
+            qWarning() << "Could not open" << fileName << ":" << ret;
+            freeContext(d->ctx);
+            return false;
+        }
+    }
+
+    ret = avformat_write_header(d->ctx, nullptr);
+    if (ret < 0) {
+        qWarning() << "Could not write header:" << ret;
+        freeContext(d->ctx);
+        return false;
+    }
+
+    d->recording = true;
+    d->started = false;
+    d->waitKeyframe = true;
+    d->resync = false;
+    d->stopping = false;
+    d->finishing = false;
+    d->offset = 0;
+    d->lastEnd = 0;
+    d->written = d->ctx->pb ? avio_tell(d->ctx->pb) : 0;
+    d->dropped = 0;
+    d->future = QtConcurrent::run(&d->threadPool, [d] { d->run(); });
+    return true;
+}
+
+void QAVRecorder::stop(bool atKeyframe)
+{
+    Q_D(QAVRecorder);
+    QMutexLocker locker(&d->mutex);
+    if (!d->recording)
+        return;
+    if (atKeyframe && d->started && !d->waitKeyframe) {
+        if (!d->stopping)
+            d->stopTimer.start();
+        d->stopping = true;
+    } else
+        d->finishing = true;
+    d->cond.wakeAll();
+}
+
+void QAVRecorder::wait()
+{
+    d_func()->future.waitForFinished();
+}
+
+bool QAVRecorder::isRecording() const
+{
+    Q_D(const QAVRecorder);
+    QMutexLocker locker(&d->mutex);
+    return d->recording;
+}
+
+void QAVRecorder::write(const QAVPacket &packet)
+{
+    Q_D(QAVRecorder);
+    if (!packet)
+        return;
+
+    auto pkt = packet.packet();
+    QMutexLocker locker(&d->mutex);
+    if (!d->recording || d->finishing)
+        return;
+
+    auto it = d->streams.find(pkt->stream_index);
+    if (it == d->streams.end())
+        return;
+
+    const auto &out = it->second;
+    const bool key = (pkt->flags & AV_PKT_FLAG_KEY) && pkt->stream_index == d->master;
+    if (d->stopping && key) {
+        d->finishing = true;
+        d->cond.wakeAll();
+        return;
+    }
+
+    const int64_t ts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+    if (ts == AV_NOPTS_VALUE)
+        return;
+    const int64_t time = av_rescale_q(ts, out.timeBase, AV_TIME_BASE_Q);
+    if (d->waitKeyframe) {
+        if (!key)
+            return;
+        d->waitKeyframe = false;
+        if (!d->started) {
+            d->offset = time;
+            d->started = true;
+        } else if (d->resync) {
+            // Continues right after the last written packet
+            d->offset = time - d->lastEnd;
+            d->resync = false;
+        }
+    }
+
+    if (d->queueBytes + pkt->size > d->maxQueueBytes) {
+        d->dropped += pkt->size;
+        d->waitKeyframe = true;
+        return;
+    }
+
+    QAVPacket copy = packet;
+    auto p = copy.packet();
+    const int64_t delta = av_rescale_q(d->offset, AV_TIME_BASE_Q, out.timeBase);
+    if (p->pts != AV_NOPTS_VALUE)
+        p->pts -= delta;
+    if (p->dts != AV_NOPTS_VALUE)
+        p->dts -= delta;
+    p->stream_index = out.index;
+    p->pos = -1;
+    d->lastEnd = qMax(d->lastEnd, time - d->offset + av_rescale_q(p->duration, out.timeBase, AV_TIME_BASE_Q));
+
+    d->queue.append(copy);
+    d->queueBytes += p->size;
+    d->cond.wakeAll();
+}
+
+void QAVRecorder::discontinuity()
+{
+    Q_D(QAVRecorder);
+    QMutexLocker locker(&d->mutex);
+    if (!d->started)
+        return;
+    d->resync = true;
+    d->waitKeyframe = true;
+}
+
+qint64 QAVRecorder::maxQueueBytes() const
+{
+    Q_D(const QAVRecorder);
+    QMutexLocker locker(&d->mutex);
+    return d->maxQueueBytes;
+}
+
+void QAVRecorder::setMaxQueueBytes(qint64 bytes)
+{
+    Q_D(QAVRecorder);
+    QMutexLocker locker(&d->mutex);
+    d->maxQueueBytes = bytes;
+}
+
+int QAVRecorder::stopTimeout() const
+{
+    Q_D(const QAVRecorder);
+    QMutexLocker locker(&d->mutex);
+    return d->stopTimeout;
+}
+
+void QAVRecorder::setStopTimeout(int msec)
+{
+    Q_D(QAVRecorder);
+    QMutexLocker locker(&d->mutex);
+    d->stopTimeout = msec;
+    d->cond.wakeAll();
+}
+
+qint64 QAVRecorder::bytesWritten() const
+{
+    return d_func()->written;
+}
+
+qint64 QAVRecorder::bytesDropped() const
+{
+    return d_func()->dropped;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,78 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVRECORDER_P_H
+#define QAVRECORDER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qavpacket_p.h"
+#include "qavstream.h"
+#include <QString>
+#include <QList>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+class QAVRecorderPrivate;
+// Remuxes the demuxed packets to a file without decoding.
+// The packets are queued and written on a background thread, they are dropped if the queue is full
+// and the recording waits for the next keyframe to continue.
+// Recording starts and stops at keyframes of the video stream, or of the first stream if there is no video.
+class QAVRecorder
+{
+public:
+    QAVRecorder();
+    ~QAVRecorder();
+
+    // Opens the file, the format is guessed from the name if empty.
+    // Only packets of the streams are recorded.
+    bool start(const QString &fileName, const QString &format, const QList<QAVStream> &streams);
+    // Stops before the next keyframe, or at once.
+    // If no keyframe comes within stopTimeout(), e.g. the source stalled, it stops at once.
+    void stop(bool atKeyframe = true);
+    // Waits until the file is closed
+    void wait();
+    bool isRecording() const;
+
+    // Called from one thread
+    void write(const QAVPacket &packet);
+    // Timestamps jump, e.g. after seeking, the recording continues from the next keyframe
+    void discontinuity();
+
+    // Bytes of the packets allowed in the queue
+    qint64 maxQueueBytes() const;
+    void setMaxQueueBytes(qint64 bytes);
+    // Milliseconds to wait for the keyframe after stop()
+    int stopTimeout() const;
+    void setStopTimeout(int msec);
+
+    // Bytes written to the file
+    qint64 bytesWritten() const;
+    // Bytes of the packets dropped because the queue was full
+    qint64 bytesDropped() const;
+
+protected:
+    std::unique_ptr<QAVRecorderPrivate> d_ptr;
+
+private:
+    Q_DISABLE_COPY(QAVRecorder)
+    Q_DECLARE_PRIVATE(QAVRecorder)
+};
+
+QT_END_NAMESPACE
+
+#endif
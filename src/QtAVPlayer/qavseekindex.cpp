@@ -0,0 +1,302 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavseekindex_p.h"
+#include <QtConcurrent/qtconcurrentrun.h>
+#include <QThreadPool>
+#include <QFuture>
+#include <QMutex>
+#include <QFile>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+static const quint32 cacheMagic = 0x51415649; // QAVI
+static const quint32 cacheVersion = 2;
+
+struct QAVSeekIndexEntry
+{
+    int64_t time = 0;
+    int64_t pos = 0;
+    // Keyframes could be missing before
+    bool gap = true;
+};
+
+class QAVSeekIndexPrivate
+{
+public:
+    QString path;
+    // Sorted by the byte offsets, the timestamps could restart, e.g. at MPEG-TS discontinuities
+    std::vector<QAVSeekIndexEntry> entries;
+    bool complete = false;
+    // Not saved yet
+    bool modified = false;
+    mutable QMutex mutex;
+
+    std::atomic_bool aborted {false};
+    QThreadPool threadPool;
+    QFuture<void> future;
+
+    void add(int64_t time, int64_t pos, bool contiguous);
+    bool save();
+    void run(const QString &url, int streamId);
+};
+
+static bool writeCache(const QString &path, const std::vector<QAVSeekIndexEntry> &entries, bool complete)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write seek index cache:" << path;
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << cacheMagic << cacheVersion;
+    out << complete << qint32(entries.size());
+    for (const auto &e : entries)
+        out << qint64(e.time) << qint64(e.pos) << e.gap;
+    return file.commit();
+}
+
+void QAVSeekIndexPrivate::add(int64_t time, int64_t pos, bool contiguous)
+{
+    QMutexLocker locker(&mutex);
+    auto it = std::lower_bound(entries.begin(), entries.end(), pos,
+        [](const QAVSeekIndexEntry &e, int64_t p) { return e.pos < p; });
+    if (it != entries.end() && it->pos == pos) {
+        // Reached the known keyframe without skipping any
+        if (contiguous && it->gap) {
+            it->gap = false;
+            modified = true;
+        }
+        return;
+    }
+    // Appended in most cases
+    entries.insert(it, {time, pos, !contiguous});
+    modified = true;
+}
+
+bool QAVSeekIndexPrivate::save()
+{
+    if (path.isEmpty())
+        return false;
+
+    QMutexLocker locker(&mutex);
+    if (entries.empty() || !modified)
+        return false;
+    modified = false;
+    const auto copy = entries;
+    const bool full = complete;
+    locker.unlock();
+    return writeCache(path, copy, full);
+}
+
+static int scan_interrupt_cb(void *opaque)
+{
+    return static_cast<QAVSeekIndexPrivate *>(opaque)->aborted ? 1 : 0;
+}
+
+void QAVSeekIndexPrivate::run(const QString &url, int streamId)
+{
+    AVFormatContext *ctx = avformat_alloc_context();
+    ctx->interrupt_callback.callback = scan_interrupt_cb;
+    ctx->interrupt_callback.opaque = this;
+    int ret = avformat_open_input(&ctx, url.toUtf8().constData(), nullptr, nullptr);
+    if (ret < 0) {
+        qWarning() << "Could not open" << url << "to index:" << ret;
+        return;
+    }
+
+    AVPacket *pkt = av_packet_alloc();
+    bool contiguous = false;
+    while (!aborted) {
+        ret = av_read_frame(ctx, pkt);
+        if (ret < 0)
+            break;
+
+        const AVStream *stream = ctx->streams[pkt->stream_index];
+        const int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+        if (stream->id == streamId && (pkt->flags & AV_PKT_FLAG_KEY) && pkt->pos >= 0 && ts != AV_NOPTS_VALUE) {
+            add(av_rescale_q(ts, stream->time_base, AV_TIME_BASE_Q), pkt->pos, contiguous);
+            contiguous = true;
+        }
+        av_packet_unref(pkt);
+    }
+    av_packet_free(&pkt);
+    avformat_close_input(&ctx);
+
+    if (ret == AVERROR_EOF && !aborted) {
+        {
+            QMutexLocker locker(&mutex);
+            complete = true;
+            modified = true;
+        }
+        save();
+    }
+}
+
+QAVSeekIndex::QAVSeekIndex(const QString &cachePath)
+    : d_ptr(new QAVSeekIndexPrivate)
+{
+    Q_D(QAVSeekIndex);
+    d->path = cachePath;
+    d->threadPool.setMaxThreadCount(1);
+}
+
+QAVSeekIndex::~QAVSeekIndex()
+{
+    Q_D(QAVSeekIndex);
+    abort();
+    if (d->path.isEmpty() || d->entries.empty() || !d->modified)
+        return;
+
+    // Written in background not to block unloading
+    const QString path = d->path;
+    const auto entries = std::move(d->entries);
+    const bool complete = d->complete;
+    QtConcurrent::run([path, entries, complete] { writeCache(path, entries, complete); });
+}
+
+QString QAVSeekIndex::cachePath(const QString &dir, const QString &url, int streamId)
+{
+    QFileInfo info(url);
+    if (dir.isEmpty() || !info.isFile())
+        return {};
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(info.absoluteFilePath().toUtf8());
+    hash.addData(QByteArray::number(info.size()));
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+    hash.addData(QByteArray::number(streamId));
+    return QDir(dir).filePath(QString::fromLatin1(hash.result().toHex()) + QLatin1String(".qavindex"));
+}
+
+void QAVSeekIndex::add(int64_t time, int64_t pos, bool contiguous)
+{
+    d_func()->add(time, pos, contiguous);
+}
+
+bool QAVSeekIndex::find(int64_t time, int64_t &pos) const
+{
+    Q_D(const QAVSeekIndex);
+    QMutexLocker locker(&d->mutex);
+    // The first range of increasing timestamps having the time is used
+    const auto &entries = d->entries;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].time > time)
+            continue;
+        const bool last = i + 1 == entries.size();
+        // A later keyframe of the same range is closer
+        if (!last && entries[i + 1].time > entries[i].time && entries[i + 1].time <= time)
+            continue;
+        // The keyframes up to the next one or to the end must be known
+        if (last ? !d->complete : entries[i + 1].gap)
+            return false;
+        pos = entries[i].pos;
+        return true;
+    }
+    return false;
+}
+
+int QAVSeekIndex::size() const
+{
+    Q_D(const QAVSeekIndex);
+    QMutexLocker locker(&d->mutex);
+    return int(d->entries.size());
+}
+
+bool QAVSeekIndex::isComplete() const
+{
+    Q_D(const QAVSeekIndex);
+    QMutexLocker locker(&d->mutex);
+    return d->complete;
+}
+
+bool QAVSeekIndex::load()
+{
+    Q_D(QAVSeekIndex);
+    if (d->path.isEmpty())
+        return false;
+
+    QFile file(d->path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    bool complete = false;
+    qint32 count = 0;
+    in >> magic >> version;
+    if (magic != cacheMagic || version != cacheVersion)
+        return false;
+    in >> complete >> count;
+    if (in.status() != QDataStream::Ok || count < 0)
+        return false;
+
+    std::vector<QAVSeekIndexEntry> entries(size_t(count));
+    for (auto &e : entries) {
+        qint64 time = 0;
+        qint64 pos = 0;
+        in >> time >> pos >> e.gap;
+        e.time = time;
+        e.pos = pos;
+    }
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    QMutexLocker locker(&d->mutex);
+    d->entries = std::move(entries);
+    d->complete = complete;
+    d->modified = false;
+    return true;
+}
+
+void QAVSeekIndex::setComplete()
+{
+    Q_D(QAVSeekIndex);
+    QMutexLocker locker(&d->mutex);
+    if (!d->complete)
+        d->modified = true;
+    d->complete = true;
+}
+
+bool QAVSeekIndex::save()
+{
+    return d_func()->save();
+}
+
+void QAVSeekIndex::scan(const QString &url, int streamId)
+{
+    Q_D(QAVSeekIndex);
+    abort();
+    d->aborted = false;
+    d->future = QtConcurrent::run(&d->threadPool, [d, url, streamId] { d->run(url, streamId); });
+}
+
+void QAVSeekIndex::abort()
+{
+    Q_D(QAVSeekIndex);
+    d->aborted = true;
+    d->future.waitForFinished();
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,69 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVSEEKINDEX_P_H
+#define QAVSEEKINDEX_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <QString>
+#include <cstdint>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+class QAVSeekIndexPrivate;
+// Byte offsets of the keyframes of one stream with pts in AV_TIME_BASE.
+// The keyframes are ordered by the offsets, so the timestamps could restart at discontinuities.
+// Filled while demuxing or by scanning the whole file in background,
+// and saved to the cache file when complete or in background when destroyed.
+class QAVSeekIndex
+{
+public:
+    // The cache file is not used if empty
+    QAVSeekIndex(const QString &cachePath = QString());
+    ~QAVSeekIndex();
+
+    // Name of the cache file in the directory, keyed by the file, its size and mtime. Empty if not a local file.
+    static QString cachePath(const QString &dir, const QString &url, int streamId);
+
+    // Contiguous if the previous keyframe of the stream was added before by the same reader
+    void add(int64_t time, int64_t pos, bool contiguous);
+    // Offset of the last keyframe before time in the first range of the timestamps having it,
+    // false if keyframes between could be missing
+    bool find(int64_t time, int64_t &pos) const;
+    int size() const;
+    // All keyframes of the file are indexed
+    bool isComplete() const;
+    void setComplete();
+
+    bool load();
+    bool save();
+
+    // Reads the packets of the stream with the id from a separate context in background
+    void scan(const QString &url, int streamId);
+    void abort();
+
+private:
+    Q_DISABLE_COPY(QAVSeekIndex)
+    Q_DECLARE_PRIVATE(QAVSeekIndex)
+    std::unique_ptr<QAVSeekIndexPrivate> d_ptr;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,434 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavsegmentdecoder.h"
+#include "qavdemuxer_p.h"
+#include <QtConcurrent/qtconcurrentrun.h>
+#include <QThreadPool>
+#include <QThread>
+#include <QFuture>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QDebug>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+// Shorter segments are not worth opening another demuxer
+static const int minSegmentDuration = 2;
+
+struct Segment
+{
+    // Frames with pts in [from, to) are emitted, from and to are keyframes
+    double from = -std::numeric_limits<double>::infinity();
+    double to = std::numeric_limits<double>::infinity();
+    // Decoded frames waiting for the previous segments if ordered
+    std::deque<QAVVideoFrame> frames;
+    qint64 bytes = 0;
+    // Part of the memory budget proportional to the length
+    qint64 budget = 0;
+    bool done = false;
+};
+
+static bool findVideoStream(QAVDemuxer &demuxer, int index, QAVStream &stream)
+{
+    if (index < 0) {
+        const auto current = demuxer.currentVideoStreams();
+        if (current.isEmpty())
+            return false;
+        stream = current.first();
+        return true;
+    }
+
+    for (const auto &s : demuxer.availableVideoStreams()) {
+        if (s.index() == index) {
+            stream = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Time of the packet in seconds, NAN if there are no timestamps
+static double packetTime(const QAVPacket &packet)
+{
+    const auto pkt = packet.packet();
+    const int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    const auto tb = packet.stream().stream()->time_base;
+    return ts != AV_NOPTS_VALUE && tb.num && tb.den ? ts * av_q2d(tb) : NAN;
+}
+
+static bool isKeyframe(const QAVPacket &packet)
+{
+    return packet.packet()->flags & AV_PKT_FLAG_KEY;
+}
+
+// Memory of the decoded frame, hardware frames are counted as if downloaded
+static qint64 frameBytes(const QAVFrame &frame)
+{
+    const auto f = frame.frame();
+    const int size = av_image_get_buffer_size(AVPixelFormat(f->format), f->width, f->height, 1);
+    return size > 0 ? size : qint64(f->width) * f->height * 3 / 2;
+}
+
+class QAVSegmentDecoderPrivate
+{
+    Q_DECLARE_PUBLIC(QAVSegmentDecoder)
+public:
+    QAVSegmentDecoderPrivate(QAVSegmentDecoder *q)
+        : q_ptr(q)
+    {
+    }
+
+    bool load(QAVDemuxer &demuxer, QAVStream &stream) const;
+    QList<double> findBoundaries();
+    void decodeSegment(size_t index);
+    void deliver(size_t index, const QAVFrame &frame);
+    void run();
+
+    QAVSegmentDecoder *q_ptr = nullptr;
+    QString url;
+    int streamIndex = -1;
+    int threadCount = qMax(1, QThread::idealThreadCount());
+    bool ordered = true;
+    qint64 maxBufferedBytes = 256 * 1024 * 1024;
+    // Pts of the first packet and the length of the stream
+    double startTime = 0;
+    double duration = 0;
+
+    mutable QMutex mutex;
+    QWaitCondition cond;
+    std::vector<Segment> segments;
+    // Segment being emitted if ordered
+    size_t emitting = 0;
+    qint64 bufferedBytes = 0;
+    QList<double> boundaries;
+    bool finished = false;
+    std::atomic<qint64> framesCount{0};
+
+    std::atomic_bool abort {false};
+    QThreadPool threadPool;
+    QFuture<void> future;
+};
+
+bool QAVSegmentDecoderPrivate::load(QAVDemuxer &demuxer, QAVStream &stream) const
+{
+    int ret = demuxer.load(url);
+    if (ret < 0) {
+        qWarning() << "Could not load:" << url << ":" << ret;
+        return false;
+    }
+
+    if (!findVideoStream(demuxer, streamIndex, stream)) {
+        qWarning() << "Could not find video stream:" << streamIndex;
+        return false;
+    }
+    demuxer.setVideoStreams({stream});
+    demuxer.setAudioStreams({});
+    demuxer.setSubtitleStreams({});
+    demuxer.discardUnusedStreams();
+    return true;
+}
+
+QList<double> QAVSegmentDecoderPrivate::findBoundaries()
+{
+    QAVDemuxer demuxer;
+    QAVStream stream;
+    if (!load(demuxer, stream) || !demuxer.seekable())
+        return {};
+
+    const double total = stream.duration() > 0 ? stream.duration() : demuxer.duration();
+    const int count = int(qBound<qint64>(1, qint64(total / minSegmentDuration), threadCount));
+    if (count < 2)
+        return {};
+
+    // The timestamps could start from non zero
+    double origin = NAN;
+    QAVPacket packet;
+    while (!abort && (packet = demuxer.read()).stream()) {
+        if (packet.packet()->stream_index == stream.index() && !qIsNaN(origin = packetTime(packet)))
+            break;
+    }
+    if (qIsNaN(origin))
+        return {};
+    startTime = origin;
+    duration = total;
+
+    // Keyframes found after seeking to the even positions
+    QList<double> result;
+    for (int i = 1; i < count && !abort; ++i) {
+        if (demuxer.seek(origin + total * i / count) < 0)
+            break;
+        while ((packet = demuxer.read()).stream()) {
+            if (packet.packet()->stream_index != stream.index() || !isKeyframe(packet))
+                continue;
+            const double t = packetTime(packet);
+            if (!qIsNaN(t) && (result.isEmpty() || t > result.last()) && t > origin)
+                result.append(t);
+            break;
+        }
+    }
+    return result;
+}
+
+void QAVSegmentDecoderPrivate::deliver(size_t index, const QAVFrame &frame)
+{
+    auto &segment = segments[index];
+    const double pts = frame.pts();
+    if (pts < segment.from || pts >= segment.to)
+        return;
+
+    ++framesCount;
+    if (!ordered) {
+        Q_EMIT q_ptr->videoFrame(frame);
+        return;
+    }
+
+    // The segments decode ahead until the budget is used, at least one frame is kept by each one.
+    // The emitted segment can also use the budget left by the others.
+    const qint64 bytes = frameBytes(frame);
+    QMutexLocker locker(&mutex);
+    while (!abort && !segment.frames.empty()
+           && (index == emitting ? bufferedBytes >= maxBufferedBytes : segment.bytes >= segment.budget)) {
+        cond.wait(&mutex);
+    }
+    segment.frames.push_back(frame);
+    segment.bytes += bytes;
+    bufferedBytes += bytes;
+    cond.wakeAll();
+}
+
+void QAVSegmentDecoderPrivate::decodeSegment(size_t index)
+{
+    QAVDemuxer demuxer;
+    QAVStream stream;
+    const double from = segments[index].from;
+    const double to = segments[index].to;
+    if (load(demuxer, stream) && (index == 0 || demuxer.seek(from) >= 0)) {
+        QList<QAVFrame> frames;
+        bool boundary = false;
+        QAVPacket packet;
+        while (!abort && (packet = demuxer.read()).stream()) {
+            if (packet.packet()->stream_index != stream.index())
+                continue;
+
+            const double t = packetTime(packet);
+            // The packets after the next keyframe with lower pts are still shown before it
+            if (boundary && t > to)
+                break;
+            if (isKeyframe(packet) && t >= to)
+                boundary = true;
+
+            frames.clear();
+            demuxer.decode(packet, frames);
+            for (const auto &frame : frames)
+                deliver(index, frame);
+        }
+
+        if (!abort) {
+            // Drain the decoder
+            QAVPacket flush;
+            flush.setStream(stream);
+            frames.clear();
+            demuxer.decode(flush, frames);
+            for (const auto &frame : frames)
+                deliver(index, frame);
+        }
+    }
+
+    QMutexLocker locker(&mutex);
+    segments[index].done = true;
+    cond.wakeAll();
+}
+
+void QAVSegmentDecoderPrivate::run()
+{
+    const auto found = findBoundaries();
+    {
+        QMutexLocker locker(&mutex);
+        boundaries = found;
+        segments.assign(size_t(found.size() + 1), {});
+        for (int i = 0; i < found.size(); ++i) {
+            segments[size_t(i)].to = found[i];
+            segments[size_t(i) + 1].from = found[i];
+        }
+        for (auto &segment : segments) {
+            const double length = qMin(segment.to, startTime + duration) - qMax(segment.from, startTime);
+            segment.budget = duration > 0 && length > 0
+                ? qint64(maxBufferedBytes * length / duration)
+                : maxBufferedBytes / qint64(segments.size());
+        }
+        emitting = 0;
+        bufferedBytes = 0;
+    }
+
+    threadPool.setMaxThreadCount(int(segments.size()));
+    QList<QFuture<void>> futures;
+    for (size_t i = 0; i < segments.size(); ++i)
+        futures.append(QtConcurrent::run(&threadPool, [this, i] { decodeSegment(i); }));
+
+    if (ordered) {
+        // Segments are emitted one by one while the next ones are buffered
+        for (size_t i = 0; i < segments.size() && !abort; ++i) {
+            QMutexLocker locker(&mutex);
+            emitting = i;
+            cond.wakeAll();
+            while (!abort) {
+                auto &segment = segments[i];
+                if (segment.frames.empty()) {
+                    if (segment.done)
+                        break;
+                    cond.wait(&mutex);
+                    continue;
+                }
+                QAVVideoFrame frame = segment.frames.front();
+                segment.frames.pop_front();
+                const qint64 bytes = frameBytes(frame);
+                segment.bytes -= bytes;
+                bufferedBytes -= bytes;
+                cond.wakeAll();
+                locker.unlock();
+                Q_EMIT q_ptr->videoFrame(frame);
+                locker.relock();
+            }
+        }
+    }
+
+    for (auto &f : futures)
+        f.waitForFinished();
+
+    if (abort)
+        return;
+
+    {
+        QMutexLocker locker(&mutex);
+        finished = true;
+    }
+    Q_EMIT q_ptr->finished();
+}
+
+QAVSegmentDecoder::QAVSegmentDecoder(QObject *parent)
+    : QObject(parent)
+    , d_ptr(new QAVSegmentDecoderPrivate(this))
+{
+}
+
+QAVSegmentDecoder::~QAVSegmentDecoder()
+{
+    abort();
+}
+
+void QAVSegmentDecoder::setSource(const QString &url)
+{
+    Q_D(QAVSegmentDecoder);
+    abort();
+    d->url = url;
+}
+
+QString QAVSegmentDecoder::source() const
+{
+    return d_func()->url;
+}
+
+int QAVSegmentDecoder::videoStream() const
+{
+    return d_func()->streamIndex;
+}
+
+void QAVSegmentDecoder::setVideoStream(int index)
+{
+    d_func()->streamIndex = index;
+}
+
+int QAVSegmentDecoder::threadCount() const
+{
+    return d_func()->threadCount;
+}
+
+void QAVSegmentDecoder::setThreadCount(int count)
+{
+    d_func()->threadCount = qMax(1, count);
+}
+
+bool QAVSegmentDecoder::isOrdered() const
+{
+    return d_func()->ordered;
+}
+
+void QAVSegmentDecoder::setOrdered(bool ordered)
+{
+    d_func()->ordered = ordered;
+}
+
+qint64 QAVSegmentDecoder::maxBufferedBytes() const
+{
+    return d_func()->maxBufferedBytes;
+}
+
+void QAVSegmentDecoder::setMaxBufferedBytes(qint64 bytes)
+{
+    d_func()->maxBufferedBytes = qMax<qint64>(1, bytes);
+}
+
+void QAVSegmentDecoder::start()
+{
+    Q_D(QAVSegmentDecoder);
+    abort();
+    {
+        QMutexLocker locker(&d->mutex);
+        d->segments.clear();
+        d->boundaries.clear();
+        d->finished = false;
+    }
+    d->framesCount = 0;
+    d->startTime = 0;
+    d->duration = 0;
+    d->abort = false;
+    d->future = QtConcurrent::run([d] { d->run(); });
+}
+
+void QAVSegmentDecoder::abort()
+{
+    Q_D(QAVSegmentDecoder);
+    {
+        QMutexLocker locker(&d->mutex);
+        d->abort = true;
+        d->cond.wakeAll();
+    }
+    d->future.waitForFinished();
+    d->threadPool.waitForDone();
+}
+
+bool QAVSegmentDecoder::isFinished() const
+{
+    Q_D(const QAVSegmentDecoder);
+    QMutexLocker locker(&d->mutex);
+    return d->finished;
+}
+
+QList<double> QAVSegmentDecoder::boundaries() const
+{
+    Q_D(const QAVSegmentDecoder);
+    QMutexLocker locker(&d->mutex);
+    return d->boundaries;
+}
+
+qint64 QAVSegmentDecoder::framesCount() const
+{
+    return d_func()->framesCount;
+}
+
+QT_END_NAMESPACE
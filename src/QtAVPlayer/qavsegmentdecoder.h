@@ -0,0 +1,73 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVSEGMENTDECODER_H
+#define QAVSEGMENTDECODER_H
+
+#include <QtAVPlayer/qavvideoframe.h>
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+class QAVSegmentDecoderPrivate;
+// Decodes all video frames of the file as fast as possible without playing it.
+// The timeline is split at keyframes into segments which are demuxed and decoded in parallel,
+// each one by its own demuxer and codec.
+class QAVSegmentDecoder : public QObject
+{
+    Q_OBJECT
+public:
+    QAVSegmentDecoder(QObject *parent = nullptr);
+    ~QAVSegmentDecoder();
+
+    void setSource(const QString &url);
+    QString source() const;
+
+    // Index of the video stream, the best one is used if -1
+    int videoStream() const;
+    void setVideoStream(int index);
+
+    // Segments decoded in parallel
+    int threadCount() const;
+    void setThreadCount(int count);
+
+    // Frames are emitted in pts order from one thread, otherwise as soon as decoded from the decoding threads
+    bool isOrdered() const;
+    void setOrdered(bool ordered);
+    // Memory of the decoded frames kept until the previous segments are emitted if ordered.
+    // Shared by the segments in proportion to their length, 256 MiB by default.
+    qint64 maxBufferedBytes() const;
+    void setMaxBufferedBytes(qint64 bytes);
+
+    // Decodes in background, finished() is emitted when done
+    void start();
+    void abort();
+    bool isFinished() const;
+
+    // Pts of the keyframes where the segments start, except the first one
+    QList<double> boundaries() const;
+    qint64 framesCount() const;
+
+Q_SIGNALS:
+    void videoFrame(const QAVVideoFrame &frame);
+    void finished();
+
+protected:
+    std::unique_ptr<QAVSegmentDecoderPrivate> d_ptr;
+
+private:
+    Q_DISABLE_COPY(QAVSegmentDecoder)
+    Q_DECLARE_PRIVATE(QAVSegmentDecoder)
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,415 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavtimeshiftbuffer_p.h"
+#include <QTemporaryFile>
+#include <QSharedPointer>
+#include <QDir>
+#include <QMutex>
+#include <QDebug>
+#include <algorithm>
+#include <deque>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+// Spill files are mapped once this size is written
+static const qint64 segmentSize = 64 * 1024 * 1024;
+
+// Temporary file with the payloads of spilled packets, each one is followed by the padding
+struct QAVTimeshiftSegment
+{
+    ~QAVTimeshiftSegment()
+    {
+        if (data)
+            file.unmap(data);
+    }
+
+    // Reads the payload with a separate handle, so the file can be written meanwhile
+    bool read(qint64 offset, char *dst, int len)
+    {
+        QMutexLocker locker(&readMutex);
+        if (!reader.isOpen() && !reader.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+            return false;
+        return reader.seek(offset) && reader.read(dst, len) == len;
+    }
+
+    QTemporaryFile file;
+    // Mapped when the file is full
+    uchar *data = nullptr;
+    qint64 size = 0;
+    // Bytes of the file visible to the reader
+    qint64 flushed = 0;
+    QFile reader;
+    QMutex readMutex;
+};
+
+struct QAVTimeshiftEntry
+{
+    QAVStream stream;
+    int streamIndex = -1;
+    int64_t pts = AV_NOPTS_VALUE;
+    int64_t dts = AV_NOPTS_VALUE;
+    int64_t duration = 0;
+    int flags = 0;
+    int size = 0;
+    double time = 0;
+    // Kept in memory until spilled
+    QAVPacket packet;
+    QSharedPointer<QAVTimeshiftSegment> segment;
+    qint64 offset = 0;
+};
+
+struct QAVTimeshiftKeyframe
+{
+    double time = 0;
+    qint64 index = 0;
+};
+
+class QAVTimeshiftBufferPrivate
+{
+public:
+    double duration = 0;
+    qint64 memoryLimit = 64 * 1024 * 1024;
+    QString directory = QDir::tempPath();
+
+    // Absolute index of the first entry
+    qint64 first = 0;
+    std::deque<QAVTimeshiftEntry> entries;
+    std::deque<QAVTimeshiftKeyframe> keyframes;
+    qint64 readIndex = 0;
+    // Entries before are on disk
+    qint64 spillIndex = 0;
+    QSharedPointer<QAVTimeshiftSegment> segment;
+    bool spillFailed = false;
+
+    // Keyframes of this stream are indexed, video is preferred
+    int masterStream = -1;
+    bool masterVideo = false;
+    double live = 0;
+
+    qint64 memory = 0;
+    qint64 disk = 0;
+    mutable QMutex mutex;
+
+    qint64 last() const { return first + qint64(entries.size()); }
+    QAVTimeshiftEntry &at(qint64 index) { return entries[size_t(index - first)]; }
+    void dropFront(qint64 to);
+    bool spill(QAVTimeshiftEntry &e);
+    QAVPacket packet(const QAVTimeshiftEntry &e) const;
+    static QAVPacket readPacket(const QAVTimeshiftEntry &e);
+};
+
+void QAVTimeshiftBufferPrivate::dropFront(qint64 to)
+{
+    while (first < to && !entries.empty()) {
+        auto &e = entries.front();
+        if (first < spillIndex)
+            disk -= e.size;
+        else
+            memory -= e.size;
+        entries.pop_front();
+        ++first;
+    }
+    spillIndex = qMax(spillIndex, first);
+    // The reader fell behind the window
+    readIndex = qMax(readIndex, first);
+}
+
+bool QAVTimeshiftBufferPrivate::spill(QAVTimeshiftEntry &e)
+{
+    if (spillFailed)
+        return false;
+
+    if (!segment || segment->size >= segmentSize) {
+        if (segment) {
+            segment->file.flush();
+            segment->data = segment->file.map(0, segment->size);
+        }
+        segment.reset(new QAVTimeshiftSegment);
+        segment->file.setFileTemplate(directory + QLatin1String("/QtAVPlayer-timeshift-XXXXXX"));
+        if (!segment->file.open()) {
+            qWarning() << "Could not create timeshift file in" << directory << ":" << segment->file.errorString();
+            segment.reset();
+            spillFailed = true;
+            return false;
+        }
+        segment->reader.setFileName(segment->file.fileName());
+    }
+
+    static const char zeros[AV_INPUT_BUFFER_PADDING_SIZE] = {};
+    auto &file = segment->file;
+    auto pkt = e.packet.packet();
+    if (!file.seek(segment->size)
+        || file.write(reinterpret_cast<const char *>(pkt->data), e.size) != e.size
+        || file.write(zeros, sizeof(zeros)) != sizeof(zeros))
+    {
+        qWarning() << "Could not write timeshift file:" << file.errorString();
+        spillFailed = true;
+        return false;
+    }
+
+    e.segment = segment;
+    e.offset = segment->size;
+    segment->size += e.size + AV_INPUT_BUFFER_PADDING_SIZE;
+    e.packet = QAVPacket();
+    memory -= e.size;
+    disk += e.size;
+    return true;
+}
+
+static void setProperties(QAVPacket &pkt, const QAVTimeshiftEntry &e)
+{
+    auto p = pkt.packet();
+    p->stream_index = e.streamIndex;
+    p->pts = e.pts;
+    p->dts = e.dts;
+    p->duration = e.duration;
+    p->flags = e.flags;
+    pkt.setStream(e.stream);
+}
+
+QAVPacket QAVTimeshiftBufferPrivate::packet(const QAVTimeshiftEntry &e) const
+{
+    auto seg = e.segment;
+    if (!seg)
+        return e.packet;
+
+    // The file is kept mapped while the packet is referenced
+    QAVPacket pkt;
+    pkt.setData(seg->data + e.offset, e.size, [seg] {});
+    setProperties(pkt, e);
+    return pkt;
+}
+
+QAVPacket QAVTimeshiftBufferPrivate::readPacket(const QAVTimeshiftEntry &e)
+{
+    // Still written, copied with the padding
+    QByteArray data(e.size + AV_INPUT_BUFFER_PADDING_SIZE, 0);
+    if (!e.segment->read(e.offset, data.data(), e.size)) {
+        qWarning() << "Could not read timeshift file:" << e.segment->reader.errorString();
+        return {};
+    }
+    data.resize(e.size);
+    QAVPacket pkt;
+    pkt.setData(data);
+    setProperties(pkt, e);
+    return pkt;
+}
+
+QAVTimeshiftBuffer::QAVTimeshiftBuffer()
+    : d_ptr(new QAVTimeshiftBufferPrivate)
+{
+}
+
+QAVTimeshiftBuffer::~QAVTimeshiftBuffer() = default;
+
+double QAVTimeshiftBuffer::duration() const
+{
+    Q_D(const QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    return d->duration;
+}
+
+void QAVTimeshiftBuffer::setDuration(double duration)
+{
+    Q_D(QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    d->duration = duration;
+}
+
+qint64 QAVTimeshiftBuffer::memoryLimit() const
+{
+    Q_D(const QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    return d->memoryLimit;
+}
+
+void QAVTimeshiftBuffer::setMemoryLimit(qint64 bytes)
+{
+    Q_D(QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    d->memoryLimit = bytes;
+}
+
+QString QAVTimeshiftBuffer::directory() const
+{
+    Q_D(const QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    return d->directory;
+}
+
+void QAVTimeshiftBuffer::setDirectory(const QString &dir)
+{
+    Q_D(QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    d->directory = dir;
+    d->spillFailed = false;
+}
+
+void QAVTimeshiftBuffer::write(const QAVPacket &packet)
+{
+    Q_D(QAVTimeshiftBuffer);
+    auto stream = packet.stream();
+    if (!stream)
+        return;
+
+    auto pkt = packet.packet();
+    const auto tb = stream.stream()->time_base;
+    const int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    const bool video = stream.stream()->codecpar->codec_type == AVMEDIA_TYPE_VIDEO;
+
+    QMutexLocker locker(&d->mutex);
+    const qint64 index = d->last();
+    d->entries.emplace_back();
+    auto &e = d->entries.back();
+    e.stream = stream;
+    e.streamIndex = pkt->stream_index;
+    e.pts = pkt->pts;
+    e.dts = pkt->dts;
+    e.duration = pkt->duration;
+    e.flags = pkt->flags;
+    e.size = pkt->size;
+    e.time = ts != AV_NOPTS_VALUE && tb.num && tb.den ? ts * av_q2d(tb) : d->live;
+    e.packet = packet;
+    d->memory += e.size;
+
+    if ((pkt->flags & AV_PKT_FLAG_KEY) && e.size > 0) {
+        if (d->masterStream < 0 || (video && !d->masterVideo)) {
+            d->masterStream = pkt->stream_index;
+            d->masterVideo = video;
+            d->keyframes.clear();
+        }
+        if (pkt->stream_index == d->masterStream)
+            d->keyframes.push_back({e.time, index});
+    }
+    if (d->masterStream < 0 || pkt->stream_index == d->masterStream)
+        d->live = e.time;
+
+    // Whole GOPs are dropped, the buffer always starts from a keyframe
+    const double oldest = d->live - d->duration;
+    while (d->keyframes.size() > 1 && d->keyframes[1].time <= oldest) {
+        d->keyframes.pop_front();
+        d->dropFront(d->keyframes.front().index);
+    }
+    // Not decodable without the keyframe
+    const qint64 decodable = d->keyframes.empty() ? d->last() : d->keyframes.front().index;
+    while (d->first < decodable && d->entries.front().time < oldest)
+        d->dropFront(d->first + 1);
+
+    while (d->memory > d->memoryLimit && d->spillIndex < d->last()) {
+        auto &s = d->at(d->spillIndex);
+        if (s.size > 0 && !d->spill(s))
+            break;
+        ++d->spillIndex;
+    }
+
+    // Nothing more can be spilled, the oldest GOPs are dropped to stay within the limit
+    while (d->spillFailed && d->memory > d->memoryLimit && d->keyframes.size() > 1) {
+        d->keyframes.pop_front();
+        d->dropFront(d->keyframes.front().index);
+    }
+}
+
+QAVPacket QAVTimeshiftBuffer::read()
+{
+    Q_D(QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    if (d->readIndex >= d->last())
+        return {};
+
+    const auto &e = d->at(d->readIndex++);
+    if (!e.segment || e.segment->data)
+        return d->packet(e);
+
+    // The file is read without blocking the writer
+    const auto entry = e;
+    if (entry.segment->flushed < entry.offset + entry.size) {
+        entry.segment->file.flush();
+        entry.segment->flushed = entry.segment->size;
+    }
+    locker.unlock();
+    return d->readPacket(entry);
+}
+
+int QAVTimeshiftBuffer::seek(double pos)
+{
+    Q_D(QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    if (d->keyframes.empty())
+        return AVERROR(EAGAIN);
+
+    auto it = std::upper_bound(d->keyframes.begin(), d->keyframes.end(), pos,
+        [](double t, const QAVTimeshiftKeyframe &k) { return t < k.time; });
+    if (it != d->keyframes.begin())
+        --it;
+    d->readIndex = it->index;
+    return 0;
+}
+
+void QAVTimeshiftBuffer::clear()
+{
+    Q_D(QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    d->entries.clear();
+    d->keyframes.clear();
+    d->first = d->readIndex = d->spillIndex = 0;
+    d->segment.reset();
+    d->spillFailed = false;
+    d->masterStream = -1;
+    d->masterVideo = false;
+    d->live = 0;
+    d->memory = d->disk = 0;
+}
+
+double QAVTimeshiftBuffer::start() const
+{
+    Q_D(const QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    return d->keyframes.empty() ? d->live : d->keyframes.front().time;
+}
+
+double QAVTimeshiftBuffer::end() const
+{
+    Q_D(const QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    return d->live;
+}
+
+double QAVTimeshiftBuffer::position() const
+{
+    Q_D(const QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    return d->readIndex < d->last() ? d->entries[size_t(d->readIndex - d->first)].time : d->live;
+}
+
+bool QAVTimeshiftBuffer::isLive() const
+{
+    Q_D(const QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    return d->readIndex >= d->last();
+}
+
+qint64 QAVTimeshiftBuffer::memoryBytes() const
+{
+    Q_D(const QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    return d->memory;
+}
+
+qint64 QAVTimeshiftBuffer::diskBytes() const
+{
+    Q_D(const QAVTimeshiftBuffer);
+    QMutexLocker locker(&d->mutex);
+    return d->disk;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,79 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVTIMESHIFTBUFFER_P_H
+#define QAVTIMESHIFTBUFFER_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qavpacket_p.h"
+#include <QString>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+class QAVTimeshiftBufferPrivate;
+// Keeps the packets read from a live source for the last duration seconds.
+// The oldest packets are moved to memory-mapped temporary files when the memory limit is reached.
+// The read position is independent from the source and is moved only to keyframes of the video stream,
+// if the reader falls behind the window it jumps to the oldest keyframe.
+class QAVTimeshiftBuffer
+{
+public:
+    QAVTimeshiftBuffer();
+    ~QAVTimeshiftBuffer();
+
+    // Window in seconds, 0 disables
+    double duration() const;
+    void setDuration(double duration);
+    // Bytes of packets kept in memory before spilling to disk,
+    // if the packets cannot be spilled the oldest GOPs are dropped instead
+    qint64 memoryLimit() const;
+    void setMemoryLimit(qint64 bytes);
+    // Directory of the spill files, the temporary one by default
+    QString directory() const;
+    void setDirectory(const QString &dir);
+
+    // Appends the packet read from the source, the packets older than the window are dropped
+    void write(const QAVPacket &packet);
+    // Next packet from the read position, the stream is null if the read position is at live
+    QAVPacket read();
+    // Moves the read position to the last keyframe before pos in seconds
+    int seek(double pos);
+    void clear();
+
+    // Pts of the oldest keyframe and the last written packet
+    double start() const;
+    double end() const;
+    // Pts of the next packet to read
+    double position() const;
+    // Nothing left to read
+    bool isLive() const;
+
+    qint64 memoryBytes() const;
+    qint64 diskBytes() const;
+
+protected:
+    std::unique_ptr<QAVTimeshiftBufferPrivate> d_ptr;
+
+private:
+    Q_DISABLE_COPY(QAVTimeshiftBuffer)
+    Q_DECLARE_PRIVATE(QAVTimeshiftBuffer)
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,274 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavtimestretch_p.h"
+#include "qavaudioframe.h"
+#include "qavaudioconverter.h"
+#include <QDebug>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define QAV_TIMESTRETCH_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define QAV_TIMESTRETCH_NEON
+#include <arm_neon.h>
+#endif
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/frame.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+// Length of the segment in seconds
+static const double segmentDuration = 0.03;
+// Max distance from the ideal position to look for the best overlap
+static const double searchDuration = 0.008;
+// Pts gap to restart the stretching
+static const double maxPtsGap = 0.1;
+static const double pi = 3.14159265358979323846;
+
+// Dot product of a and b, and energy of b
+static void correlate(const float *a, const float *b, int n, float &dot, float &energy)
+{
+    int i = 0;
+    float d = 0;
+    float e = 0;
+#if defined(QAV_TIMESTRETCH_SSE)
+    __m128 vd = _mm_setzero_ps();
+    __m128 ve = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+        const __m128 va = _mm_loadu_ps(a + i);
+        const __m128 vb = _mm_loadu_ps(b + i);
+        vd = _mm_add_ps(vd, _mm_mul_ps(va, vb));
+        ve = _mm_add_ps(ve, _mm_mul_ps(vb, vb));
+    }
+    float td[4];
+    float te[4];
+    _mm_storeu_ps(td, vd);
+    _mm_storeu_ps(te, ve);
+    d = td[0] + td[1] + td[2] + td[3];
+    e = te[0] + te[1] + te[2] + te[3];
+#elif defined(QAV_TIMESTRETCH_NEON)
+    float32x4_t vd = vdupq_n_f32(0);
+    float32x4_t ve = vdupq_n_f32(0);
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t va = vld1q_f32(a + i);
+        const float32x4_t vb = vld1q_f32(b + i);
+        vd = vmlaq_f32(vd, va, vb);
+        ve = vmlaq_f32(ve, vb, vb);
+    }
+    float td[4];
+    float te[4];
+    vst1q_f32(td, vd);
+    vst1q_f32(te, ve);
+    d = td[0] + td[1] + td[2] + td[3];
+    e = te[0] + te[1] + te[2] + te[3];
+#endif
+    for (; i < n; ++i) {
+        d += a[i] * b[i];
+        e += b[i] * b[i];
+    }
+    dot = d;
+    energy = e;
+}
+
+QAVTimeStretch::QAVTimeStretch() = default;
+QAVTimeStretch::~QAVTimeStretch() = default;
+
+void QAVTimeStretch::setFormat(int sampleRate, int channels)
+{
+    m_rate = sampleRate;
+    m_channels = channels;
+    m_segment = qMax(2, qRound(sampleRate * segmentDuration)) & ~1;
+    m_overlap = m_segment / 2;
+    m_search = qRound(sampleRate * searchDuration);
+
+    // Periodic Hann window, the halves of two overlapped segments sum to 1
+    m_window.resize(m_segment);
+    for (int i = 0; i < m_segment; ++i)
+        m_window[i] = float(0.5 - 0.5 * std::cos(2 * pi * i / m_segment));
+
+    reset();
+}
+
+void QAVTimeStretch::setSpeed(double speed)
+{
+    m_speed = qBound(0.1, speed, 10.0);
+}
+
+void QAVTimeStretch::reset()
+{
+    m_input.clear();
+    m_inputStart = 0;
+    m_analysisPos = 0;
+    m_prevPos = -1;
+    m_tail.assign(size_t(m_overlap) * m_channels, 0.0f);
+    m_converter.reset();
+    m_basePts = NAN;
+    m_expectedPts = NAN;
+}
+
+qint64 QAVTimeStretch::search(qint64 from, qint64 to) const
+{
+    const int n = m_overlap * m_channels;
+    // Natural continuation of the previous segment
+    const float *target = sample(m_prevPos + m_overlap);
+    auto score = [&](qint64 pos) {
+        float dot = 0;
+        float energy = 0;
+        correlate(target, sample(pos), n, dot, energy);
+        return dot / std::sqrt(energy + 1e-9f);
+    };
+
+    // Coarse search first, then refine around the best position
+    const int step = 4;
+    qint64 best = from;
+    float bestScore = -std::numeric_limits<float>::max();
+    for (qint64 pos = from; pos <= to; pos += step) {
+        const float s = score(pos);
+        if (s > bestScore) {
+            bestScore = s;
+            best = pos;
+        }
+    }
+
+    const qint64 lo = qMax(from, best - step + 1);
+    const qint64 hi = qMin(to, best + step - 1);
+    const qint64 coarse = best;
+    for (qint64 pos = lo; pos <= hi; ++pos) {
+        if (pos == coarse)
+            continue;
+        const float s = score(pos);
+        if (s > bestScore) {
+            bestScore = s;
+            best = pos;
+        }
+    }
+
+    return best;
+}
+
+void QAVTimeStretch::process(const float *in, int frames, std::vector<float> &out)
+{
+    if (m_channels <= 0 || m_segment <= 0)
+        return;
+
+    m_input.insert(m_input.end(), in, in + size_t(frames) * m_channels);
+    const qint64 inputEnd = m_inputStart + qint64(m_input.size() / m_channels);
+    const int ch = m_channels;
+    const int hs = m_overlap;
+
+    while (true) {
+        const qint64 ideal = std::llround(m_analysisPos);
+        qint64 from = qMax(ideal - m_search, m_inputStart);
+        qint64 to = ideal + m_search;
+        if (m_prevPos < 0)
+            from = to = ideal;
+        qint64 need = to + m_segment;
+        if (m_prevPos >= 0)
+            need = qMax(need, m_prevPos + 2 * hs);
+        if (need > inputEnd)
+            break;
+
+        const qint64 best = m_prevPos >= 0 ? search(from, to) : ideal;
+        const float *x = sample(best);
+        const size_t start = out.size();
+        out.resize(start + size_t(hs) * ch);
+        float *o = out.data() + start;
+        if (m_prevPos < 0) {
+            // No fade in for the first segment
+            std::copy(x, x + hs * ch, o);
+        } else {
+            for (int i = 0; i < hs; ++i) {
+                const float w = m_window[i];
+                for (int c = 0; c < ch; ++c)
+                    o[i * ch + c] = m_tail[i * ch + c] + w * x[i * ch + c];
+            }
+        }
+        for (int i = 0; i < hs; ++i) {
+            const float w = m_window[hs + i];
+            for (int c = 0; c < ch; ++c)
+                m_tail[i * ch + c] = w * x[(hs + i) * ch + c];
+        }
+
+        m_prevPos = best;
+        m_analysisPos += hs * m_speed;
+
+        // Drop the input which is not needed anymore
+        const qint64 keep = qMin(qint64(std::llround(m_analysisPos)) - m_search, m_prevPos + hs);
+        if (keep > m_inputStart) {
+            m_input.erase(m_input.begin(), m_input.begin() + size_t(keep - m_inputStart) * ch);
+            m_inputStart = keep;
+        }
+    }
+}
+
+QAVFrame QAVTimeStretch::process(const QAVFrame &frame, double speed)
+{
+    QAVAudioFrame audio = frame;
+    audio.setPreferredSampleFormats({QAVAudioFormat::Float});
+    // Any sample format is converted to Float by the converter
+    const auto fmt = audio.format();
+    if (!fmt) {
+        if (!m_warned)
+            qWarning() << "Could not stretch audio frame without format";
+        m_warned = true;
+        return frame;
+    }
+
+    const double pts = frame.pts();
+    if (fmt.sampleRate() != m_rate || fmt.channelCount() != m_channels)
+        setFormat(fmt.sampleRate(), fmt.channelCount());
+    else if (!std::isnan(m_expectedPts) && (std::isnan(pts) || std::fabs(pts - m_expectedPts) > maxPtsGap))
+        reset();
+
+    if (std::isnan(m_basePts))
+        m_basePts = pts;
+    setSpeed(speed);
+
+    if (!m_converter)
+        m_converter.reset(new QAVAudioConverter);
+    const QByteArray data = m_converter->data(audio);
+    const int frames = data.size() / int(sizeof(float) * m_channels);
+    const double outPts = m_basePts + inputPosition() / m_rate;
+    m_expectedPts = pts + double(frames) / m_rate;
+
+    m_output.clear();
+    process(reinterpret_cast<const float *>(data.constData()), frames, m_output);
+    const int outFrames = int(m_output.size() / m_channels);
+    if (!outFrames)
+        return {};
+
+    QAVFrame out;
+    out.setStream(frame.stream());
+    out.setFilterName(frame.filterName());
+    auto dst = out.frame();
+    dst->format = AV_SAMPLE_FMT_FLT;
+    dst->sample_rate = m_rate;
+    dst->nb_samples = outFrames;
+#if LIBAVUTIL_VERSION_INT <= AV_VERSION_INT(57, 23, 0)
+    dst->channel_layout = av_get_default_channel_layout(m_channels);
+    dst->channels = m_channels;
+#else
+    av_channel_layout_default(&dst->ch_layout, m_channels);
+#endif
+    int ret = av_frame_get_buffer(dst, 0);
+    if (ret < 0) {
+        qWarning() << "Could not allocate stretched frame:" << ret;
+        return {};
+    }
+    memcpy(dst->data[0], m_output.data(), m_output.size() * sizeof(float));
+    out.setTimeBase({1, m_rate});
+    dst->pts = std::isnan(outPts) ? AV_NOPTS_VALUE : std::llround(outPts * m_rate);
+    return out;
+}
+
+QT_END_NAMESPACE
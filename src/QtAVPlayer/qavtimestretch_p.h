@@ -0,0 +1,83 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVTIMESTRETCH_P_H
+#define QAVTIMESTRETCH_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qavframe.h"
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <memory>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+class QAVAudioConverter;
+// Changes the tempo of the audio keeping the pitch and the sample rate (WSOLA).
+// Segments of the input are overlapped at positions with the best similarity
+// to the natural continuation of the previous segment.
+class QAVTimeStretch
+{
+public:
+    QAVTimeStretch();
+    ~QAVTimeStretch();
+
+    void setFormat(int sampleRate, int channels);
+    int sampleRate() const { return m_rate; }
+    int channels() const { return m_channels; }
+
+    void setSpeed(double speed);
+    double speed() const { return m_speed; }
+
+    // Appends interleaved float samples, the stretched samples are appended to out
+    void process(const float *in, int frames, std::vector<float> &out);
+    // Index of the input sample the next output starts from
+    double inputPosition() const { return m_analysisPos; }
+    void reset();
+
+    // Returns the stretched frame in interleaved float, empty if more input is needed.
+    // Restarts on format changes and pts gaps.
+    QAVFrame process(const QAVFrame &frame, double speed);
+
+private:
+    qint64 search(qint64 from, qint64 to) const;
+    const float *sample(qint64 pos) const { return m_input.data() + (pos - m_inputStart) * m_channels; }
+
+    int m_rate = 0;
+    int m_channels = 0;
+    double m_speed = 1.0;
+    int m_segment = 0;
+    int m_overlap = 0;
+    int m_search = 0;
+    std::vector<float> m_window;
+
+    std::vector<float> m_input;
+    qint64 m_inputStart = 0;
+    double m_analysisPos = 0;
+    qint64 m_prevPos = -1;
+    std::vector<float> m_tail;
+
+    std::unique_ptr<QAVAudioConverter> m_converter;
+    std::vector<float> m_output;
+    double m_basePts = 0;
+    double m_expectedPts = 0;
+    bool m_warned = false;
+};
+
+QT_END_NAMESPACE
+
+#endif
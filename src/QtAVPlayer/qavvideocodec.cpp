@@ -11,10 +11,13 @@
 #include "qavpacket_p.h"
 #include "qavframe.h"
 #include "qavvideoframe.h"
+#include "qavvideoframeallocator.h"
+#include <QAtomicInt>
 #include <QDebug>
 
 extern "C" {
 #include <libavutil/pixdesc.h>
+#include <libavutil/imgutils.h>
 #include <libavcodec/avcodec.h>
 }
 
@@ -24,8 +27,101 @@ class QAVVideoCodecPrivate : public QAVCodecPrivate
 {
 public:
     QSharedPointer<QAVHWDevice> hw_device;
+    QSharedPointer<QAVVideoFrameAllocator> allocator;
 };
 
+namespace {
+
+// Shared by the planes of one frame, released when all of them are unreferenced
+struct AllocatedPlanes
+{
+    QSharedPointer<QAVVideoFrameAllocator> allocator;
+    QAVVideoFrameAllocator::Planes planes;
+    QAtomicInt refs;
+};
+
+} // namespace
+
+static void release_plane(void *opaque, uint8_t *)
+{
+    auto p = static_cast<AllocatedPlanes *>(opaque);
+    if (!p->refs.deref()) {
+        p->allocator->release(p->planes);
+        delete p;
+    }
+}
+
+static int allocate_frame(
+    const QSharedPointer<QAVVideoFrameAllocator> &allocator,
+    AVFrame *frame,
+    int width,
+    int height)
+{
+    const auto fmt = AVPixelFormat(frame->format);
+    const auto desc = av_pix_fmt_desc_get(fmt);
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)))
+        return AVERROR(ENOSYS);
+
+    const int align = QAVVideoFrameAllocator::alignment;
+    QAVVideoFrameAllocator::Planes planes;
+    planes.format = fmt;
+    planes.size = {width, height};
+    planes.count = av_pix_fmt_count_planes(fmt);
+    int ret = av_image_fill_linesizes(planes.bytesPerLine, fmt, width);
+    if (ret < 0)
+        return ret;
+
+    for (int i = 0; i < planes.count; ++i) {
+        planes.bytesPerLine[i] = FFALIGN(planes.bytesPerLine[i], align);
+        const int h = i == 1 || i == 2 ? AV_CEIL_RSHIFT(height, desc->log2_chroma_h) : height;
+        // Decoders and SIMD code might read past the end of a plane
+        planes.bytes[i] = planes.bytesPerLine[i] * h + 16 + align - 1;
+    }
+
+    if (!allocator->allocate(planes))
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < planes.count; ++i) {
+        if (!planes.data[i] || reinterpret_cast<uintptr_t>(planes.data[i]) % align) {
+            qWarning() << "QAVVideoFrameAllocator returned unaligned or empty plane:" << i;
+            allocator->release(planes);
+            return AVERROR(EINVAL);
+        }
+    }
+
+    auto p = new AllocatedPlanes{allocator, planes, QAtomicInt(planes.count)};
+    for (int i = 0; i < planes.count; ++i) {
+        frame->buf[i] = av_buffer_create(planes.data[i], planes.bytes[i], release_plane, p, 0);
+        if (!frame->buf[i]) {
+            for (int j = i; j < planes.count; ++j)
+                release_plane(p, nullptr);
+            for (int j = 0; j < i; ++j)
+                av_buffer_unref(&frame->buf[j]);
+            return AVERROR(ENOMEM);
+        }
+        frame->data[i] = planes.data[i];
+        frame->linesize[i] = planes.bytesPerLine[i];
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+static int get_video_buffer(AVCodecContext *c, AVFrame *frame, int flags)
+{
+    auto d = reinterpret_cast<QAVVideoCodecPrivate *>(c->opaque);
+    // Without direct rendering the decoder might keep using the buffers after the frame is returned
+    if (d->allocator && (c->codec->capabilities & AV_CODEC_CAP_DR1)) {
+        int width = frame->width;
+        int height = frame->height;
+        int linesizeAlign[AV_NUM_DATA_POINTERS];
+        avcodec_align_dimensions2(c, &width, &height, linesizeAlign);
+        if (allocate_frame(d->allocator, frame, width, height) >= 0)
+            return 0;
+    }
+
+    return avcodec_default_get_buffer2(c, frame, flags);
+}
+
 static bool isSoftwarePixelFormat(AVPixelFormat from)
 {
     switch (from) {
@@ -144,4 +240,40 @@ QAVHWDevice *QAVVideoCodec::device() const
     return d_func()->hw_device.data();
 }
 
+void QAVVideoCodec::setFrameAllocator(const QSharedPointer<QAVVideoFrameAllocator> &allocator)
+{
+    Q_D(QAVVideoCodec);
+    d->allocator = allocator;
+    d->avctx->get_buffer2 = allocator ? get_video_buffer : avcodec_default_get_buffer2;
+}
+
+QSharedPointer<QAVVideoFrameAllocator> QAVVideoCodec::frameAllocator() const
+{
+    return d_func()->allocator;
+}
+
+int QAVVideoCodec::read(QAVStreamFrame &frame)
+{
+    int ret = QAVFrameCodec::read(frame);
+    Q_D(QAVVideoCodec);
+    if (ret < 0 || !d->allocator || !d->avctx->codec || (d->avctx->codec->capabilities & AV_CODEC_CAP_DR1))
+        return ret;
+
+    // The codec does not support custom get_buffer2(), copy the frame to the allocator's buffers
+    auto f = static_cast<QAVFrame *>(&frame)->frame();
+    auto copy = av_frame_alloc();
+    copy->format = f->format;
+    copy->width = f->width;
+    copy->height = f->height;
+    if (allocate_frame(d->allocator, copy, f->width, f->height) >= 0
+        && av_frame_copy(copy, f) >= 0
+        && av_frame_copy_props(copy, f) >= 0)
+    {
+        av_frame_unref(f);
+        av_frame_move_ref(f, copy);
+    }
+    av_frame_free(&copy);
+    return ret;
+}
+
 QT_END_NAMESPACE
@@ -25,6 +25,7 @@ QT_BEGIN_NAMESPACE
 
 class QAVVideoCodecPrivate;
 class QAVHWDevice;
+class QAVVideoFrameAllocator;
 class QAVVideoCodec : public QAVFrameCodec
 {
 public:
@@ -34,6 +35,13 @@ public:
     void setDevice(const QSharedPointer<QAVHWDevice> &d);
     QAVHWDevice *device() const;
 
+    // Decodes to the buffers from the allocator, must be set before open().
+    // If the codec does not support direct rendering, decoded frames are copied to the buffers.
+    void setFrameAllocator(const QSharedPointer<QAVVideoFrameAllocator> &allocator);
+    QSharedPointer<QAVVideoFrameAllocator> frameAllocator() const;
+
+    int read(QAVStreamFrame &frame) override;
+
 private:
     Q_DISABLE_COPY(QAVVideoCodec)
     Q_DECLARE_PRIVATE(QAVVideoCodec)
@@ -10,6 +10,7 @@
 #include "qavframe_p.h"
 #include "qavvideocodec_p.h"
 #include "qavhwdevice_p.h"
+#include "qavvideoframepool_p.h"
 #include <QSize>
 #ifdef QT_AVPLAYER_MULTIMEDIA
     #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
@@ -24,6 +25,7 @@
     #endif // #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 #endif // #ifdef QT_AVPLAYER_MULTIMEDIA
 #include <QDebug>
+#include <atomic>
 
 extern "C" {
 #include <libswscale/swscale.h>
@@ -39,6 +41,8 @@ static const QAVVideoCodec *videoCodec(const QAVCodec *c)
     return reinterpret_cast<const QAVVideoCodec *>(c);
 }
 
+static std::atomic<quint64> s_conversionFallbacks {0};
+
 class QAVVideoFramePrivate : public QAVFramePrivate
 {
     Q_DECLARE_PUBLIC(QAVVideoFrame)
@@ -83,7 +87,8 @@ QAVVideoFrame::QAVVideoFrame(const QSize &size, AVPixelFormat fmt)
     frame()->format = fmt;
     frame()->width = size.width();
     frame()->height = size.height();
-    av_frame_get_buffer(frame(), 1);
+    if (QAVVideoFramePool::getBuffer(frame()) < 0)
+        qWarning() << "Could not allocate video frame:" << size << fmt;
 }
 
 QAVVideoFrame &QAVVideoFrame::operator=(const QAVFrame &other)
@@ -144,6 +149,47 @@ QString QAVVideoFrame::formatName() const
     return QLatin1String(av_pix_fmt_desc_get(QAVVideoFrame::format())->name);
 }
 
+static int swsColorSpace(const AVFrame *frame)
+{
+    switch (frame->colorspace) {
+    case AVCOL_SPC_BT709:
+        return SWS_CS_ITU709;
+    case AVCOL_SPC_FCC:
+        return SWS_CS_FCC;
+    case AVCOL_SPC_SMPTE240M:
+        return SWS_CS_SMPTE240M;
+    case AVCOL_SPC_BT2020_NCL:
+    case AVCOL_SPC_BT2020_CL:
+        return SWS_CS_BT2020;
+    case AVCOL_SPC_BT470BG:
+    case AVCOL_SPC_SMPTE170M:
+        return SWS_CS_ITU601;
+    default:
+        // Untagged HD content is BT.709 in practice, SD is BT.601
+        return frame->height > 576 ? SWS_CS_ITU709 : SWS_CS_ITU601;
+    }
+}
+
+static bool isJpegFormat(AVPixelFormat fmt)
+{
+    switch (fmt) {
+    case AV_PIX_FMT_YUVJ420P:
+    case AV_PIX_FMT_YUVJ422P:
+    case AV_PIX_FMT_YUVJ444P:
+    case AV_PIX_FMT_YUVJ440P:
+    case AV_PIX_FMT_YUVJ411P:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool isRgbFormat(AVPixelFormat fmt)
+{
+    auto desc = av_pix_fmt_desc_get(fmt);
+    return desc && (desc->flags & AV_PIX_FMT_FLAG_RGB);
+}
+
 QAVVideoFrame QAVVideoFrame::convertTo(AVPixelFormat fmt) const
 {
     if (fmt == frame()->format)
@@ -162,21 +208,108 @@ QAVVideoFrame QAVVideoFrame::convertTo(AVPixelFormat fmt) const
         return QAVVideoFrame();
     }
 
-    int ret = sws_setColorspaceDetails(ctx, sws_getCoefficients(SWS_CS_ITU601),
-                                       0, sws_getCoefficients(SWS_CS_ITU709), 0, 0, 1 << 16, 1 << 16);
+    // The matrix and range are taken from the frame, YUV to YUV keeps the source matrix
+    const int colorSpace = swsColorSpace(frame());
+    const bool srcFullRange = frame()->color_range == AVCOL_RANGE_JPEG || isJpegFormat(mapData.format);
+    const bool dstRgb = isRgbFormat(fmt);
+    // RGB is always full range, the flag is ignored by swscale
+    const bool dstFullRange = !dstRgb && (srcFullRange || isJpegFormat(fmt));
+    int ret = sws_setColorspaceDetails(ctx, sws_getCoefficients(colorSpace), srcFullRange,
+                                       sws_getCoefficients(colorSpace), dstFullRange, 0, 1 << 16, 1 << 16);
     if (ret == -1) {
         qWarning() << __FUNCTION__ << "Colorspace not support";
+        sws_freeContext(ctx);
         return QAVVideoFrame();
     }
 
     QAVVideoFrame result(size(), fmt);
     result.d_ptr->stream = d_ptr->stream;
+    result.frame()->colorspace = dstRgb ? AVCOL_SPC_RGB : frame()->colorspace;
+    result.frame()->color_range = dstRgb || dstFullRange ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG;
+    result.frame()->color_primaries = frame()->color_primaries;
+    result.frame()->color_trc = frame()->color_trc;
     sws_scale(ctx, mapData.data, mapData.bytesPerLine, 0, result.size().height(), result.frame()->data, result.frame()->linesize);
     sws_freeContext(ctx);
 
     return result;
 }
 
+quint64 QAVVideoFrame::conversionFallbackCount()
+{
+    return s_conversionFallbacks;
+}
+
+#ifdef QT_AVPLAYER_MULTIMEDIA
+static QImage::Format imageFormat(AVPixelFormat fmt)
+{
+    switch (fmt) {
+    // Native byte order
+    case AV_PIX_FMT_RGB32:
+        return QImage::Format_ARGB32;
+    case AV_PIX_FMT_0RGB32:
+        return QImage::Format_RGB32;
+    case AV_PIX_FMT_RGB565:
+        return QImage::Format_RGB16;
+    case AV_PIX_FMT_RGB555:
+        return QImage::Format_RGB555;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    case AV_PIX_FMT_RGBA64:
+        return QImage::Format_RGBA64;
+#endif
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+    case AV_PIX_FMT_GRAY16:
+        return QImage::Format_Grayscale16;
+#endif
+    // Memory byte order
+    case AV_PIX_FMT_RGBA:
+        return QImage::Format_RGBA8888;
+    case AV_PIX_FMT_RGB0:
+        return QImage::Format_RGBX8888;
+    case AV_PIX_FMT_RGB24:
+        return QImage::Format_RGB888;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    case AV_PIX_FMT_BGR24:
+        return QImage::Format_BGR888;
+#endif
+    case AV_PIX_FMT_GRAY8:
+        return QImage::Format_Grayscale8;
+    default:
+        return QImage::Format_Invalid;
+    }
+}
+
+static void releaseImageFrame(void *frame)
+{
+    delete static_cast<QAVVideoFrame *>(frame);
+}
+
+QImage QAVVideoFrame::toImage() const
+{
+    if (frame()->format == AV_PIX_FMT_NONE)
+        return {};
+
+    // Holds the buffers (also the downloaded ones) until the image is destroyed
+    auto holder = new QAVVideoFrame(*this);
+    auto mapData = holder->map();
+    auto fmt = imageFormat(mapData.format);
+    if (fmt == QImage::Format_Invalid && mapData.format != AV_PIX_FMT_NONE) {
+        ++s_conversionFallbacks;
+        *holder = convertTo(AV_PIX_FMT_RGB32);
+        mapData = holder->map();
+        fmt = imageFormat(mapData.format);
+    }
+
+    if (fmt == QImage::Format_Invalid || !mapData.data[0]) {
+        delete holder;
+        return {};
+    }
+
+    // Read-only, the image detaches on write since the buffers are shared with the decoder
+    return QImage(const_cast<const uchar *>(mapData.data[0]), size().width(), size().height(), mapData.bytesPerLine[0],
+                  fmt, releaseImageFrame, holder);
+}
+#endif // #ifdef QT_AVPLAYER_MULTIMEDIA
+
 #ifdef QT_AVPLAYER_MULTIMEDIA
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 class PlanarVideoBuffer : public QAbstractPlanarVideoBuffer
@@ -369,7 +502,9 @@ public:
         case AVCOL_RANGE_JPEG:
             return QVideoFrameFormat::ColorRange_Full;
         default:
-            return QVideoFrameFormat::ColorRange_Unknown;
+            return isJpegFormat(AVPixelFormat(frame->format))
+                ? QVideoFrameFormat::ColorRange_Full
+                : QVideoFrameFormat::ColorRange_Unknown;
         }
     }
 
@@ -418,25 +553,88 @@ QAVVideoFrame::operator QVideoFrame() const
 
     VideoFrame::PixelFormat format = VideoFrame::Format_Invalid;
     switch (frame()->format) {
-        case AV_PIX_FMT_RGB32:
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        // Native byte order
+        case AV_PIX_FMT_RGB32:
+        case AV_PIX_FMT_0RGB32:
             format = VideoFrame::Format_RGB32;
+            break;
+        case AV_PIX_FMT_RGB565:
+            format = VideoFrame::Format_RGB565;
+            break;
+        case AV_PIX_FMT_RGB555:
+            format = VideoFrame::Format_RGB555;
+            break;
+        case AV_PIX_FMT_RGB24:
+            format = VideoFrame::Format_RGB24;
+            break;
+        case AV_PIX_FMT_BGR24:
+            format = VideoFrame::Format_BGR24;
+            break;
 #else
+        // Memory byte order
+        case AV_PIX_FMT_BGRA:
             format = QVideoFrameFormat::Format_BGRA8888;
-#endif
             break;
+        case AV_PIX_FMT_BGR0:
+            format = QVideoFrameFormat::Format_BGRX8888;
+            break;
+        case AV_PIX_FMT_ARGB:
+            format = QVideoFrameFormat::Format_ARGB8888;
+            break;
+        case AV_PIX_FMT_0RGB:
+            format = QVideoFrameFormat::Format_XRGB8888;
+            break;
+        case AV_PIX_FMT_RGBA:
+            format = QVideoFrameFormat::Format_RGBA8888;
+            break;
+        case AV_PIX_FMT_RGB0:
+            format = QVideoFrameFormat::Format_RGBX8888;
+            break;
+        case AV_PIX_FMT_ABGR:
+            format = QVideoFrameFormat::Format_ABGR8888;
+            break;
+        case AV_PIX_FMT_0BGR:
+            format = QVideoFrameFormat::Format_XBGR8888;
+            break;
+        case AV_PIX_FMT_P010:
+            format = QVideoFrameFormat::Format_P010;
+            break;
+        case AV_PIX_FMT_P016:
+            format = QVideoFrameFormat::Format_P016;
+            break;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 4, 0)
+        case AV_PIX_FMT_YUV420P10:
+            format = QVideoFrameFormat::Format_YUV420P10;
+            break;
+#endif
+#endif // #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
         case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
             format = VideoFrame::Format_YUV420P;
             break;
-        case AV_PIX_FMT_YUV444P:
         case AV_PIX_FMT_YUV422P:
+        case AV_PIX_FMT_YUVJ422P:
 #if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
+            ++s_conversionFallbacks;
             result = convertTo(AV_PIX_FMT_YUV420P);
             format = VideoFrame::Format_YUV420P;
 #else
             format = VideoFrame::Format_YUV422P;
 #endif
             break;
+        case AV_PIX_FMT_UYVY422:
+            format = VideoFrame::Format_UYVY;
+            break;
+        case AV_PIX_FMT_YUYV422:
+            format = VideoFrame::Format_YUYV;
+            break;
+        case AV_PIX_FMT_GRAY8:
+            format = VideoFrame::Format_Y8;
+            break;
+        case AV_PIX_FMT_GRAY16:
+            format = VideoFrame::Format_Y16;
+            break;
         case AV_PIX_FMT_VAAPI:
         case AV_PIX_FMT_VDPAU:
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
@@ -450,15 +648,29 @@ QAVVideoFrame::operator QVideoFrame() const
         case AV_PIX_FMT_NV12:
             format = VideoFrame::Format_NV12;
             break;
+        case AV_PIX_FMT_NV21:
+            format = VideoFrame::Format_NV21;
+            break;
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
         case AV_PIX_FMT_MEDIACODEC:
             format = VideoFrame::Format_SamplerExternalOES;
             break;
 #endif
         default:
-            // TODO: Add more supported formats instead of converting
-            result = convertTo(AV_PIX_FMT_YUV420P);
-            format = VideoFrame::Format_YUV420P;
+            // Not representable by QVideoFrame, RGB stays RGB to avoid losing precision on chroma
+            ++s_conversionFallbacks;
+            if (isRgbFormat(AVPixelFormat(frame()->format))) {
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+                result = convertTo(AV_PIX_FMT_RGB32);
+                format = VideoFrame::Format_RGB32;
+#else
+                result = convertTo(AV_PIX_FMT_BGRA);
+                format = QVideoFrameFormat::Format_BGRA8888;
+#endif
+            } else {
+                result = convertTo(AV_PIX_FMT_YUV420P);
+                format = VideoFrame::Format_YUV420P;
+            }
             break;
     }
 
@@ -12,6 +12,7 @@
 #include <QVariant>
 #ifdef QT_AVPLAYER_MULTIMEDIA
 #include <QVideoFrame>
+#include <QImage>
 #endif
 
 extern "C" {
@@ -66,8 +67,15 @@ public:
     QAVVideoFrame convertTo(AVPixelFormat fmt) const;
 #ifdef QT_AVPLAYER_MULTIMEDIA
     operator QVideoFrame() const;
+    // Wraps RGB and gray frames without copying, the image keeps the frame's buffers alive.
+    // Other formats are converted to RGB32.
+    QImage toImage() const;
 #endif
 
+    // Number of frames converted on CPU because their format
+    // could not be mapped to QVideoFrame or QImage directly
+    static quint64 conversionFallbackCount();
+
 protected:
     Q_DECLARE_PRIVATE(QAVVideoFrame)
 };
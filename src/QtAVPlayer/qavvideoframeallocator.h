@@ -0,0 +1,57 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVVIDEOFRAMEALLOCATOR_H
+#define QAVVIDEOFRAMEALLOCATOR_H
+
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <QSize>
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+// Supplies the memory the video decoder writes the frames to,
+// e.g. slots of a shared memory pool.
+// allocate() and release() are called from the decoding threads.
+class QAVVideoFrameAllocator
+{
+public:
+    // Required alignment of each plane in bytes
+    static const int alignment = 64;
+
+    struct Planes
+    {
+        // Filled by the decoder
+        AVPixelFormat format = AV_PIX_FMT_NONE;
+        // Coded size, might be bigger than the size of the frame
+        QSize size;
+        int count = 0;
+        int bytesPerLine[4] = {0};
+        // Minimum size of each plane including padding
+        int bytes[4] = {0};
+
+        // Filled by allocate()
+        uchar *data[4] = {nullptr};
+        // Passed back to release()
+        void *opaque = nullptr;
+    };
+
+    virtual ~QAVVideoFrameAllocator() = default;
+
+    // Sets planes.data to the buffers of planes.bytes size aligned to alignment.
+    // If false is returned, the decoder allocates the frame itself.
+    virtual bool allocate(Planes &planes) = 0;
+    // Called when the decoder and all the frames do not reference the buffers anymore
+    virtual void release(const Planes &planes) = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif
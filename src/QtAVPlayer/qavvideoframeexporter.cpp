@@ -0,0 +1,252 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavvideoframeexporter.h"
+#include "qavvideoframering_p.h"
+#include <QSharedMemory>
+#include <QDebug>
+#include <cmath>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <signal.h>
+#endif
+
+extern "C" {
+#include <libavutil/avutil.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+using namespace QAVVideoFrameRing;
+
+class QAVVideoFrameExporterPrivate
+{
+public:
+    QSharedMemory shm;
+    // Number of the last published frame, the numbers of skipped slots are not published
+    quint64 seq = 0;
+    quint64 written = 0;
+    quint64 dropped = 0;
+};
+
+// Aligned layout of the planes inside a slot, returns the size of all planes
+static int frameLayout(const QSize &size, AVPixelFormat fmt, qint32 bytesPerLine[4], qint32 offset[4])
+{
+    auto desc = av_pix_fmt_desc_get(fmt);
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)) || size.isEmpty())
+        return -1;
+
+    int linesize[4] = {0};
+    if (av_image_fill_linesizes(linesize, fmt, size.width()) < 0)
+        return -1;
+
+    const int planes = av_pix_fmt_count_planes(fmt);
+    qint64 bytes = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (i >= planes) {
+            bytesPerLine[i] = 0;
+            offset[i] = 0;
+            continue;
+        }
+
+        const int h = i == 1 || i == 2 ? AV_CEIL_RSHIFT(size.height(), desc->log2_chroma_h) : size.height();
+        bytesPerLine[i] = int(align(linesize[i]));
+        offset[i] = int(bytes);
+        bytes += align(qint64(bytesPerLine[i]) * h);
+    }
+
+    return bytes > INT_MAX ? -1 : int(bytes);
+}
+
+static bool isProcessAlive(qint64 pid)
+{
+#ifdef Q_OS_WIN
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, DWORD(pid));
+    if (!process)
+        return GetLastError() == ERROR_ACCESS_DENIED;
+    const bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return alive;
+#else
+    return kill(pid_t(pid), 0) == 0 || errno == EPERM;
+#endif
+}
+
+// Returns true if no frame references the slot.
+// Drops the references of the importers which exited without releasing their frames.
+static bool isSlotFree(void *base, Slot *s)
+{
+    auto h = header(base);
+    bool free = true;
+    for (int i = 0; i < maxImporters; ++i) {
+        if (s->readers[i].load() <= 0)
+            continue;
+
+        auto &importer = h->importers[i];
+        qint64 pid = importer.pid.load();
+        if (pid <= 0 || isProcessAlive(pid) || !importer.pid.compare_exchange_strong(pid, -1)) {
+            free = false;
+            continue;
+        }
+
+        qWarning() << "Releasing frames of exited importer:" << pid;
+        for (int j = 0; j < h->slots; ++j)
+            slot(base, j)->readers[i].store(0);
+        importer.generation.fetch_add(1);
+        importer.pid.store(0);
+    }
+    return free;
+}
+
+QAVVideoFrameExporter::QAVVideoFrameExporter()
+    : d_ptr(new QAVVideoFrameExporterPrivate)
+{
+}
+
+QAVVideoFrameExporter::~QAVVideoFrameExporter()
+{
+    close();
+}
+
+bool QAVVideoFrameExporter::create(const QString &key, int slots, int slotBytes)
+{
+    Q_D(QAVVideoFrameExporter);
+    close();
+    if (slots <= 0 || slotBytes <= 0 || size(slots, slotBytes) > INT_MAX)
+        return false;
+
+    d->shm.setKey(key);
+    const int bytes = int(size(slots, slotBytes));
+    bool created = d->shm.create(bytes);
+    // The segment might be left by a crashed exporter, the last detach removes it on Unix
+    if (!created && d->shm.error() == QSharedMemory::AlreadyExists && d->shm.attach()) {
+        d->shm.detach();
+        created = d->shm.create(bytes);
+    }
+    if (!created) {
+        qWarning() << "Could not create shared memory:" << key << d->shm.errorString();
+        return false;
+    }
+
+    auto base = d->shm.data();
+    auto h = new (base) Header;
+    h->slots = slots;
+    h->slotBytes = slotBytes;
+    for (int i = 0; i < slots; ++i)
+        new (slot(base, i)) Slot;
+
+    // Importers check the magic before reading anything else
+    h->version = version;
+    std::atomic_thread_fence(std::memory_order_release);
+    h->magic = magic;
+    return true;
+}
+
+void QAVVideoFrameExporter::close()
+{
+    Q_D(QAVVideoFrameExporter);
+    if (d->shm.isAttached())
+        d->shm.detach();
+    d->seq = 0;
+    d->written = 0;
+    d->dropped = 0;
+}
+
+QString QAVVideoFrameExporter::key() const
+{
+    return d_func()->shm.key();
+}
+
+bool QAVVideoFrameExporter::write(const QAVVideoFrame &frame)
+{
+    Q_D(QAVVideoFrameExporter);
+    if (!d->shm.isAttached())
+        return false;
+
+    auto mapData = frame.map();
+    Slot layout;
+    const int bytes = frameLayout(frame.size(), mapData.format, layout.bytesPerLine, layout.offset);
+    auto base = d->shm.data();
+    auto h = header(base);
+    if (bytes < 0 || bytes > h->slotBytes) {
+        qWarning() << "Frame does not fit the slot:" << frame.size() << mapData.format << bytes << h->slotBytes;
+        ++d->dropped;
+        return false;
+    }
+
+    // Slots still referenced by importers are skipped, importers see the seq mismatch and skip the number
+    Slot *s = nullptr;
+    quint64 n = d->seq;
+    for (int i = 0; i < h->slots && !s; ++i) {
+        auto candidate = slot(base, int(n++ % h->slots));
+        const quint64 seq = candidate->seq.load();
+        // Lock the slot before checking the readers, importers increase the readers before checking the seq
+        candidate->seq.store(2 * n - 1);
+        if (isSlotFree(base, candidate))
+            s = candidate;
+        else
+            candidate->seq.store(seq);
+    }
+    if (!s) {
+        ++d->dropped;
+        return false;
+    }
+
+    auto desc = av_pix_fmt_desc_get(mapData.format);
+    auto data = slotData(s);
+    for (int i = 0; i < 4 && layout.bytesPerLine[i]; ++i) {
+        const int height = frame.size().height();
+        const int planeHeight = i == 1 || i == 2 ? AV_CEIL_RSHIFT(height, desc->log2_chroma_h) : height;
+        av_image_copy_plane(data + layout.offset[i], layout.bytesPerLine[i],
+                            mapData.data[i], mapData.bytesPerLine[i],
+                            qMin(layout.bytesPerLine[i], mapData.bytesPerLine[i]), planeHeight);
+    }
+
+    auto f = frame.frame();
+    s->format = mapData.format;
+    s->width = frame.size().width();
+    s->height = frame.size().height();
+    for (int i = 0; i < 4; ++i) {
+        s->bytesPerLine[i] = layout.bytesPerLine[i];
+        s->offset[i] = layout.offset[i];
+    }
+    s->colorRange = f->color_range;
+    s->colorSpace = f->colorspace;
+    s->colorPrimaries = f->color_primaries;
+    s->colorTrc = f->color_trc;
+    const double pts = frame.pts();
+    s->pts = std::isnan(pts) ? AV_NOPTS_VALUE : qint64(pts * AV_TIME_BASE);
+
+    s->seq.store(2 * n, std::memory_order_release);
+    h->written.store(n, std::memory_order_release);
+    d->seq = n;
+    ++d->written;
+    return true;
+}
+
+quint64 QAVVideoFrameExporter::writtenFrames() const
+{
+    return d_func()->written;
+}
+
+quint64 QAVVideoFrameExporter::droppedFrames() const
+{
+    return d_func()->dropped;
+}
+
+int QAVVideoFrameExporter::frameBytes(const QSize &size, AVPixelFormat fmt)
+{
+    qint32 bytesPerLine[4];
+    qint32 offset[4];
+    return frameLayout(size, fmt, bytesPerLine, offset);
+}
+
+QT_END_NAMESPACE
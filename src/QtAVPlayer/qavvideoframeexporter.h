@@ -0,0 +1,54 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVVIDEOFRAMEEXPORTER_H
+#define QAVVIDEOFRAMEEXPORTER_H
+
+#include <QtAVPlayer/qavvideoframe.h>
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+class QAVVideoFrameExporterPrivate;
+// Publishes decoded frames to a shared memory ring,
+// the frames are received by QAVVideoFrameImporter in other processes.
+// Only one thread must write the frames.
+class QAVVideoFrameExporter
+{
+public:
+    QAVVideoFrameExporter();
+    ~QAVVideoFrameExporter();
+
+    // Creates the shared memory with the slots of slotBytes size
+    bool create(const QString &key, int slots, int slotBytes);
+    void close();
+    QString key() const;
+
+    // Copies the frame to the next slot.
+    // Slots still used by importers are skipped.
+    // Returns false if the frame does not fit the slot or all slots are used by importers.
+    // Slots referenced by importers whose process has exited are reused.
+    bool write(const QAVVideoFrame &frame);
+
+    quint64 writtenFrames() const;
+    quint64 droppedFrames() const;
+
+    // Size of a slot needed to hold the frame
+    static int frameBytes(const QSize &size, AVPixelFormat fmt);
+
+protected:
+    std::unique_ptr<QAVVideoFrameExporterPrivate> d_ptr;
+
+private:
+    Q_DISABLE_COPY(QAVVideoFrameExporter)
+    Q_DECLARE_PRIVATE(QAVVideoFrameExporter)
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,197 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavvideoframeimporter.h"
+#include "qavvideoframering_p.h"
+#include <QSharedMemory>
+#include <QSharedPointer>
+#include <QCoreApplication>
+#include <QDebug>
+
+extern "C" {
+#include <libavutil/avutil.h>
+#include <libavutil/frame.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+using namespace QAVVideoFrameRing;
+
+namespace {
+
+// Entry of the importer in the shared memory, taken until the importer and all its frames are gone
+struct Attachment
+{
+    ~Attachment()
+    {
+        if (index < 0)
+            return;
+        qint64 pid = QCoreApplication::applicationPid();
+        if (importer().generation.load() == generation)
+            importer().pid.compare_exchange_strong(pid, 0);
+    }
+
+    Importer &importer() const { return header(shm->data())->importers[index]; }
+
+    QSharedPointer<QSharedMemory> shm;
+    int index = -1;
+    quint32 generation = 0;
+};
+
+// Keeps the memory mapped while a frame references the slot
+struct SlotRef
+{
+    QSharedPointer<Attachment> attachment;
+    Slot *slot = nullptr;
+};
+
+} // namespace
+
+class QAVVideoFrameImporterPrivate
+{
+public:
+    QSharedPointer<QSharedMemory> shm;
+    QSharedPointer<Attachment> attachment;
+    quint64 read = 0;
+    quint64 skipped = 0;
+};
+
+static void release_slot(void *opaque, uint8_t *)
+{
+    auto ref = static_cast<SlotRef *>(opaque);
+    // The references have been dropped by the exporter if it considered the importer exited
+    if (ref->attachment->importer().generation.load() == ref->attachment->generation)
+        ref->slot->readers[ref->attachment->index].fetch_sub(1);
+    delete ref;
+}
+
+QAVVideoFrameImporter::QAVVideoFrameImporter()
+    : d_ptr(new QAVVideoFrameImporterPrivate)
+{
+}
+
+QAVVideoFrameImporter::~QAVVideoFrameImporter() = default;
+
+bool QAVVideoFrameImporter::attach(const QString &key)
+{
+    Q_D(QAVVideoFrameImporter);
+    detach();
+
+    QSharedPointer<QSharedMemory> shm(new QSharedMemory(key));
+    if (!shm->attach()) {
+        qWarning() << "Could not attach to shared memory:" << key << shm->errorString();
+        return false;
+    }
+
+    auto h = header(shm->data());
+    if (shm->size() < int(sizeof(Header)) || h->magic != magic || h->version != version
+        || shm->size() < size(h->slots, h->slotBytes))
+    {
+        qWarning() << "Shared memory does not contain video frames:" << key;
+        return false;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    QSharedPointer<Attachment> attachment(new Attachment);
+    attachment->shm = shm;
+    const qint64 pid = QCoreApplication::applicationPid();
+    for (int i = 0; i < maxImporters && attachment->index < 0; ++i) {
+        qint64 expected = 0;
+        if (h->importers[i].pid.compare_exchange_strong(expected, pid)) {
+            attachment->index = i;
+            attachment->generation = h->importers[i].generation.load();
+        }
+    }
+    if (attachment->index < 0) {
+        qWarning() << "Too many importers:" << key;
+        return false;
+    }
+
+    d->shm = shm;
+    d->attachment = attachment;
+    // Only frames published after attaching are received
+    d->read = h->written.load(std::memory_order_acquire);
+    d->skipped = 0;
+    return true;
+}
+
+void QAVVideoFrameImporter::detach()
+{
+    Q_D(QAVVideoFrameImporter);
+    d->attachment.reset();
+    d->shm.reset();
+}
+
+bool QAVVideoFrameImporter::isAttached() const
+{
+    return !d_func()->shm.isNull();
+}
+
+QAVVideoFrame QAVVideoFrameImporter::read()
+{
+    Q_D(QAVVideoFrameImporter);
+    if (!d->shm)
+        return {};
+
+    auto base = d->shm->data();
+    auto h = header(base);
+    while (true) {
+        const quint64 written = h->written.load(std::memory_order_acquire);
+        if (written <= d->read)
+            return {};
+
+        quint64 n = d->read + 1;
+        // The ring has been overwritten since the last read
+        if (written - n >= quint64(h->slots)) {
+            d->skipped += written - h->slots + 1 - n;
+            n = written - h->slots + 1;
+        }
+        d->read = n;
+
+        auto s = slot(base, int((n - 1) % h->slots));
+        auto &readers = s->readers[d->attachment->index];
+        readers.fetch_add(1);
+        if (s->seq.load() != 2 * n) {
+            // Being overwritten by the exporter
+            readers.fetch_sub(1);
+            ++d->skipped;
+            continue;
+        }
+
+        QAVVideoFrame frame;
+        auto f = frame.frame();
+        auto ref = new SlotRef{d->attachment, s};
+        f->buf[0] = av_buffer_create(slotData(s), h->slotBytes, release_slot, ref, AV_BUFFER_FLAG_READONLY);
+        if (!f->buf[0]) {
+            release_slot(ref, nullptr);
+            return {};
+        }
+
+        f->format = s->format;
+        f->width = s->width;
+        f->height = s->height;
+        for (int i = 0; i < 4 && s->bytesPerLine[i]; ++i) {
+            f->data[i] = slotData(s) + s->offset[i];
+            f->linesize[i] = s->bytesPerLine[i];
+        }
+        f->extended_data = f->data;
+        f->color_range = AVColorRange(s->colorRange);
+        f->colorspace = AVColorSpace(s->colorSpace);
+        f->color_primaries = AVColorPrimaries(s->colorPrimaries);
+        f->color_trc = AVColorTransferCharacteristic(s->colorTrc);
+        f->pts = s->pts;
+        frame.setTimeBase(AVRational{1, AV_TIME_BASE});
+        return frame;
+    }
+}
+
+quint64 QAVVideoFrameImporter::skippedFrames() const
+{
+    return d_func()->skipped;
+}
+
+QT_END_NAMESPACE
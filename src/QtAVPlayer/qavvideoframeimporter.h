@@ -0,0 +1,50 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVVIDEOFRAMEIMPORTER_H
+#define QAVVIDEOFRAMEIMPORTER_H
+
+#include <QtAVPlayer/qavvideoframe.h>
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+class QAVVideoFrameImporterPrivate;
+// Receives the frames published by QAVVideoFrameExporter.
+// The frames point to the shared memory without copying,
+// the exporter does not reuse a slot while any frame references it
+// unless the importing process has exited.
+// Up to 16 importers can be attached to the same exporter.
+class QAVVideoFrameImporter
+{
+public:
+    QAVVideoFrameImporter();
+    ~QAVVideoFrameImporter();
+
+    bool attach(const QString &key);
+    // Frames already read stay valid
+    void detach();
+    bool isAttached() const;
+
+    // Returns the next published frame, or an empty frame if nothing new has been published
+    QAVVideoFrame read();
+
+    // Frames overwritten before they were read
+    quint64 skippedFrames() const;
+
+protected:
+    std::unique_ptr<QAVVideoFrameImporterPrivate> d_ptr;
+
+private:
+    Q_DISABLE_COPY(QAVVideoFrameImporter)
+    Q_DECLARE_PRIVATE(QAVVideoFrameImporter)
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -0,0 +1,149 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#include "qavvideoframepool_p.h"
+#include <QMutex>
+#include <QList>
+#include <QDebug>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/buffer.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+struct PoolEntry
+{
+    int width = 0;
+    int height = 0;
+    int format = AV_PIX_FMT_NONE;
+    int linesize[4] = {0};
+    intptr_t offsets[4] = {0};
+    int size = 0;
+    AVBufferPool *pool = nullptr;
+};
+
+// Keeps the pools of recently used frame geometries
+struct PoolRegistry
+{
+    ~PoolRegistry()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        for (auto &e : entries)
+            av_buffer_pool_uninit(&e.pool);
+        entries.clear();
+    }
+
+    static const int maxPools = 16;
+    QList<PoolEntry> entries;
+    QMutex mutex;
+};
+
+} // namespace
+
+Q_GLOBAL_STATIC(PoolRegistry, registry)
+
+static int initEntry(PoolEntry &e)
+{
+    const int align = QAVVideoFramePool::alignment;
+    auto fmt = AVPixelFormat(e.format);
+    int ret = av_image_check_size(e.width, e.height, 0, nullptr);
+    if (ret < 0)
+        return ret;
+
+    ret = av_image_fill_linesizes(e.linesize, fmt, FFALIGN(e.width, align));
+    if (ret < 0)
+        return ret;
+    for (int i = 0; i < 4; ++i)
+        e.linesize[i] = FFALIGN(e.linesize[i], align);
+
+    // Some filters and SIMD kernels read past the last line
+    const int paddedHeight = FFALIGN(e.height, 32);
+    uint8_t *data[4] = {nullptr};
+    ret = av_image_fill_pointers(data, fmt, paddedHeight, nullptr, e.linesize);
+    if (ret < 0)
+        return ret;
+
+    // data[0] is null, so the pointers are the offsets of the planes
+    e.offsets[0] = 0;
+    for (int i = 1; i < 4; ++i)
+        e.offsets[i] = data[i] ? reinterpret_cast<intptr_t>(data[i]) : -1;
+    e.size = ret + 16 + align - 1;
+    e.pool = av_buffer_pool_init(e.size, av_buffer_alloc);
+    return e.pool ? 0 : AVERROR(ENOMEM);
+}
+
+int QAVVideoFramePool::getBuffer(AVFrame *frame)
+{
+    if (!frame || frame->width <= 0 || frame->height <= 0 || frame->format == AV_PIX_FMT_NONE)
+        return AVERROR(EINVAL);
+
+    auto r = registry();
+    QMutexLocker locker(&r->mutex);
+    int index = -1;
+    for (int i = 0; i < r->entries.size(); ++i) {
+        const auto &e = r->entries[i];
+        if (e.width == frame->width && e.height == frame->height && e.format == frame->format) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index < 0) {
+        PoolEntry e;
+        e.width = frame->width;
+        e.height = frame->height;
+        e.format = frame->format;
+        int ret = initEntry(e);
+        if (ret < 0)
+            return ret;
+        if (r->entries.size() >= PoolRegistry::maxPools) {
+            // Buffers in use keep the pool alive until they are released
+            av_buffer_pool_uninit(&r->entries.last().pool);
+            r->entries.removeLast();
+        }
+        r->entries.prepend(e);
+        index = 0;
+    } else if (index > 0) {
+        r->entries.move(index, 0);
+        index = 0;
+    }
+
+    const PoolEntry e = r->entries[index];
+    AVBufferRef *buf = av_buffer_pool_get(e.pool);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    locker.unlock();
+
+    av_buffer_unref(&frame->buf[0]);
+    frame->buf[0] = buf;
+    uint8_t *base = reinterpret_cast<uint8_t *>(FFALIGN(reinterpret_cast<uintptr_t>(buf->data), uintptr_t(alignment)));
+    for (int i = 0; i < 4; ++i) {
+        frame->linesize[i] = e.linesize[i];
+        frame->data[i] = e.offsets[i] >= 0 ? base + e.offsets[i] : nullptr;
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+void QAVVideoFramePool::clear()
+{
+    auto r = registry();
+    QMutexLocker locker(&r->mutex);
+    r->clear();
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,43 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVVIDEOFRAMEPOOL_P_H
+#define QAVVIDEOFRAMEPOOL_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtAVPlayer/qtavplayerglobal.h>
+
+QT_BEGIN_NAMESPACE
+
+struct AVFrame;
+class QAVVideoFramePool
+{
+public:
+    // Alignment of each plane and line in bytes
+    static const int alignment = 64;
+
+    // Allocates the planes of the frame from a pool shared by frames
+    // with the same width, height and pixel format.
+    // The buffer returns to the pool when the last reference is dropped.
+    static int getBuffer(AVFrame *frame);
+    // Releases unused pools
+    static void clear();
+};
+
+QT_END_NAMESPACE
+
+#endif
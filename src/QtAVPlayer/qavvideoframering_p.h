@@ -0,0 +1,114 @@
+/*********************************************************
+ * Copyright (C) 2026, Val Doroshchuk <valbok@gmail.com> *
+ *                                                       *
+ * This file is part of QtAVPlayer.                      *
+ * Free Qt Media Player based on FFmpeg.                 *
+ *********************************************************/
+
+#ifndef QAVVIDEOFRAMERING_P_H
+#define QAVVIDEOFRAMERING_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API. It exists purely as an
+// implementation detail. This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtAVPlayer/qtavplayerglobal.h>
+#include <atomic>
+
+QT_BEGIN_NAMESPACE
+
+// Layout of the shared memory used by QAVVideoFrameExporter and QAVVideoFrameImporter:
+// Header followed by the slots, each slot is Slot followed by the planes.
+namespace QAVVideoFrameRing
+{
+
+const quint32 magic = 0x51415652;
+const quint32 version = 2;
+const int alignment = 64;
+const int maxImporters = 16;
+
+static_assert(std::atomic<quint64>::is_always_lock_free, "Shared memory needs address-free atomics");
+static_assert(std::atomic<qint32>::is_always_lock_free, "Shared memory needs address-free atomics");
+static_assert(std::atomic<qint64>::is_always_lock_free, "Shared memory needs address-free atomics");
+
+struct Importer
+{
+    // Process of the importer, 0 if the entry is free and -1 while it is being reclaimed
+    std::atomic<qint64> pid{0};
+    // Increased when the references of an exited importer are dropped
+    std::atomic<quint32> generation{0};
+};
+
+struct alignas(alignment) Header
+{
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 slots = 0;
+    qint32 slotBytes = 0;
+    // Number of published frames
+    std::atomic<quint64> written{0};
+    Importer importers[maxImporters];
+};
+
+struct alignas(alignment) Slot
+{
+    // 2 * n when n-th frame is published, odd while it is being written
+    std::atomic<quint64> seq{0};
+    // Frames referencing the slot by each importer
+    std::atomic<qint32> readers[maxImporters] = {};
+    qint32 format = -1;
+    qint32 width = 0;
+    qint32 height = 0;
+    qint32 bytesPerLine[4] = {0};
+    qint32 offset[4] = {0};
+    qint32 colorRange = 0;
+    qint32 colorSpace = 0;
+    qint32 colorPrimaries = 0;
+    qint32 colorTrc = 0;
+    // In AV_TIME_BASE units
+    qint64 pts = 0;
+};
+
+inline qint64 align(qint64 v)
+{
+    return (v + alignment - 1) & ~qint64(alignment - 1);
+}
+
+inline qint64 slotStride(int slotBytes)
+{
+    return align(sizeof(Slot)) + align(slotBytes);
+}
+
+inline qint64 size(int slots, int slotBytes)
+{
+    return align(sizeof(Header)) + slots * slotStride(slotBytes);
+}
+
+inline Header *header(void *base)
+{
+    return static_cast<Header *>(base);
+}
+
+inline Slot *slot(void *base, int i)
+{
+    auto h = header(base);
+    return reinterpret_cast<Slot *>(static_cast<char *>(base) + align(sizeof(Header)) + i * slotStride(h->slotBytes));
+}
+
+inline uchar *slotData(Slot *s)
+{
+    return reinterpret_cast<uchar *>(s) + align(sizeof(Slot));
+}
+
+} // namespace QAVVideoFrameRing
+
+QT_END_NAMESPACE
+
+#endif
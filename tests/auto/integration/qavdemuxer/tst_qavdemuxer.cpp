@@ -11,9 +11,13 @@
 #include "qaviodevice.h"
 #include "qavvideocodec_p.h"
 #include "qavaudiocodec_p.h"
+#include "qavtimeshiftbuffer_p.h"
+#include "qavrecorder_p.h"
+#include "qavseekindex_p.h"
 
 #include <QDebug>
 #include <QtTest/QtTest>
+#include <vector>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -40,6 +44,11 @@ private slots:
     void metadata();
     void videoCodecs();
     void inputOptions();
+    void packetData();
+    void timeshiftBuffer();
+    void recorder();
+    void seekIndex();
+    void seekIndexDiscontinuity();
 };
 
 void tst_QAVDemuxer::construction()
@@ -434,5 +443,357 @@ void tst_QAVDemuxer::inputOptions()
     QVERIFY(d.load(file.absoluteFilePath()) >= 0);
 }
 
+
+void tst_QAVDemuxer::packetData()
+{
+    QAVDemuxer d;
+    QVERIFY(d.load(testData("colors.mp4")) >= 0);
+    QVERIFY(!d.currentVideoStreams().isEmpty());
+    const int index = d.currentVideoStreams().first().index();
+
+    QAVPacket p;
+    while ((p = d.read()) && p.packet()->stream_index != index);
+    QVERIFY(p);
+
+    // Padded byte array is referenced
+    QByteArray padded(reinterpret_cast<const char *>(p.packet()->data), p.packet()->size);
+    const int size = padded.size();
+    padded.resize(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    padded.fill(0, size + AV_INPUT_BUFFER_PADDING_SIZE);
+    memcpy(padded.data(), p.packet()->data, size);
+    padded.resize(size);
+    {
+        QAVPacket wrapped;
+        QVERIFY(wrapped.setData(padded));
+        QCOMPARE(wrapped.packet()->size, size);
+        QCOMPARE(reinterpret_cast<const char *>(wrapped.packet()->data), padded.constData());
+        QVERIFY(!padded.isDetached());
+        wrapped.packet()->pts = p.packet()->pts;
+        wrapped.packet()->dts = p.packet()->dts;
+        wrapped.packet()->flags = p.packet()->flags;
+        wrapped.setStream(p.stream());
+
+        QList<QAVFrame> fs;
+        d.decode(wrapped, fs);
+        QCOMPARE(fs.size(), 1);
+        QVERIFY(fs[0]);
+    }
+    // Released with the packet
+    QVERIFY(padded.isDetached());
+
+    // Not padded is copied
+    const QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char *>(p.packet()->data), p.packet()->size);
+    QAVPacket copied;
+    QVERIFY(copied.setData(raw));
+    QCOMPARE(copied.packet()->size, size);
+    QVERIFY(reinterpret_cast<const char *>(copied.packet()->data) != raw.constData());
+
+    // Any buffer with a release callback
+    bool released = false;
+    std::vector<uint8_t> buf(size + AV_INPUT_BUFFER_PADDING_SIZE, 0);
+    {
+        QAVPacket external;
+        QVERIFY(external.setData(buf.data(), size, [&] { released = true; }));
+        QCOMPARE(external.packet()->data, buf.data());
+        QAVPacket ref = external;
+        external = QAVPacket();
+        QVERIFY(!released);
+    }
+    QVERIFY(released);
+}
+
+void tst_QAVDemuxer::timeshiftBuffer()
+{
+    QAVDemuxer d;
+    QVERIFY(d.load(testData("star_trails.mpeg")) >= 0);
+    QVERIFY(!d.currentVideoStreams().isEmpty());
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QAVTimeshiftBuffer b;
+    b.setDuration(3600);
+    // Most of the packets are spilled
+    b.setMemoryLimit(64 * 1024);
+    b.setDirectory(dir.path());
+    QVERIFY(b.isLive());
+    QVERIFY(!b.read().stream());
+    QVERIFY(b.seek(0) < 0);
+
+    QList<QAVPacket> packets;
+    QAVPacket p;
+    while ((p = d.read())) {
+        b.write(p);
+        packets.append(p);
+    }
+    QVERIFY(packets.size() > 10);
+    QVERIFY(!b.isLive());
+    QVERIFY(b.memoryBytes() <= 64 * 1024);
+    QVERIFY(b.diskBytes() > 0);
+    QVERIFY(!QDir(dir.path()).isEmpty());
+    QVERIFY(b.end() > b.start());
+
+    // Packets are read back from memory and disk as written
+    for (const auto &expected : packets) {
+        const auto pkt = b.read();
+        QVERIFY(pkt);
+        QCOMPARE(pkt.stream(), expected.stream());
+        QCOMPARE(pkt.packet()->stream_index, expected.packet()->stream_index);
+        QCOMPARE(pkt.packet()->pts, expected.packet()->pts);
+        QCOMPARE(pkt.packet()->dts, expected.packet()->dts);
+        QCOMPARE(pkt.packet()->flags, expected.packet()->flags);
+        QCOMPARE(QByteArray(reinterpret_cast<const char *>(pkt.packet()->data), pkt.packet()->size),
+                 QByteArray(reinterpret_cast<const char *>(expected.packet()->data), expected.packet()->size));
+    }
+    QVERIFY(b.isLive());
+
+    // Rewinds to keyframes without reading the source again
+    const double middle = (b.start() + b.end()) / 2;
+    QCOMPARE(b.seek(middle), 0);
+    QVERIFY(b.position() <= middle);
+    const auto key = b.read();
+    QVERIFY(key.packet()->flags & AV_PKT_FLAG_KEY);
+    QCOMPARE(key.stream().stream()->codecpar->codec_type, AVMEDIA_TYPE_VIDEO);
+    QCOMPARE(b.seek(0), 0);
+    QCOMPARE(b.position(), b.start());
+    QCOMPARE(b.seek(b.end()), 0);
+    QVERIFY(!b.isLive());
+
+    // Only the window is kept, starting from a keyframe
+    QAVTimeshiftBuffer w;
+    w.setDuration(1);
+    for (const auto &pkt : packets)
+        w.write(pkt);
+    QVERIFY(w.start() > b.start());
+    QVERIFY(w.end() - w.start() < b.end() - b.start());
+    QCOMPARE(w.diskBytes(), qint64(0));
+    const auto first = w.read();
+    QVERIFY(first.packet()->flags & AV_PKT_FLAG_KEY);
+
+    // Oldest GOPs are dropped if the packets cannot be spilled
+    QAVTimeshiftBuffer f;
+    f.setDuration(3600);
+    f.setMemoryLimit(64 * 1024);
+    f.setDirectory(dir.path() + QLatin1String("/missing"));
+    qint64 total = 0;
+    for (const auto &pkt : packets) {
+        f.write(pkt);
+        total += pkt.packet()->size;
+    }
+    QCOMPARE(f.diskBytes(), qint64(0));
+    QVERIFY(f.memoryBytes() < total);
+    QVERIFY(f.start() > b.start());
+    QCOMPARE(f.end(), b.end());
+    QVERIFY(f.read().packet()->flags & AV_PKT_FLAG_KEY);
+
+    b.clear();
+    QVERIFY(b.isLive());
+    QCOMPARE(b.memoryBytes(), qint64(0));
+    QCOMPARE(b.diskBytes(), qint64(0));
+}
+
+void tst_QAVDemuxer::recorder()
+{
+    QAVDemuxer d;
+    QVERIFY(d.load(testData("star_trails.mpeg")) >= 0);
+    QVERIFY(!d.currentVideoStreams().isEmpty());
+    const auto streams = d.currentVideoStreams() + d.currentAudioStreams();
+    const int video = d.currentVideoStreams().first().index();
+
+    QList<QAVPacket> packets;
+    QAVPacket p;
+    while ((p = d.read()))
+        packets.append(p);
+    QVERIFY(packets.size() > 10);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath("out.mkv");
+    QAVRecorder r;
+    QVERIFY(!r.isRecording());
+    QVERIFY(!r.start(dir.filePath("out.unknown"), {}, streams));
+    QVERIFY(r.start(fileName, {}, streams));
+    QVERIFY(r.isRecording());
+
+    // Starts from the first keyframe and stops before the next keyframe after the half
+    int expected = 0;
+    bool started = false;
+    bool stopping = false;
+    for (int i = 0; i < packets.size(); ++i) {
+        const auto pkt = packets[i].packet();
+        const bool key = pkt->stream_index == video && (pkt->flags & AV_PKT_FLAG_KEY);
+        if (i == packets.size() / 2) {
+            r.stop();
+            stopping = started;
+        }
+        if (key && stopping)
+            stopping = started = false;
+        if (key && i < packets.size() / 2)
+            started = true;
+        if ((started || stopping) && pkt->stream_index == video)
+            ++expected;
+        r.write(packets[i]);
+    }
+    r.wait();
+    QVERIFY(!r.isRecording());
+    QVERIFY(expected > 0);
+    QCOMPARE(r.bytesDropped(), qint64(0));
+    QCOMPARE(r.bytesWritten(), QFileInfo(fileName).size());
+
+    QAVDemuxer out;
+    QVERIFY(out.load(fileName) >= 0);
+    QCOMPARE(out.currentVideoStreams().size(), 1);
+    const int outVideo = out.currentVideoStreams().first().index();
+    int written = 0;
+    while ((p = out.read())) {
+        if (p.packet()->stream_index != outVideo)
+            continue;
+        if (!written)
+            QVERIFY(p.packet()->flags & AV_PKT_FLAG_KEY);
+        ++written;
+    }
+    QCOMPARE(written, expected);
+
+    // Full queue drops the packets
+    r.setMaxQueueBytes(0);
+    QVERIFY(r.start(fileName, QLatin1String("matroska"), streams));
+    for (const auto &pkt : packets)
+        r.write(pkt);
+    r.stop(false);
+    r.wait();
+    QVERIFY(r.bytesDropped() > 0);
+
+    // Stops without the next keyframe if it does not come in time
+    r.setMaxQueueBytes(32 * 1024 * 1024);
+    r.setStopTimeout(100);
+    QVERIFY(r.start(fileName, {}, streams));
+    int keys = 0;
+    for (const auto &pkt : packets) {
+        if (pkt.packet()->stream_index == video && (pkt.packet()->flags & AV_PKT_FLAG_KEY) && ++keys > 1)
+            break;
+        r.write(pkt);
+    }
+    r.stop();
+    QTRY_VERIFY(!r.isRecording());
+    QCOMPARE(r.bytesWritten(), QFileInfo(fileName).size());
+
+    // Muxers opening the files themselves have no output context
+    const QString segments = dir.filePath("out%03d.ts");
+    QVERIFY(r.start(segments, QLatin1String("segment"), streams));
+    for (const auto &pkt : packets)
+        r.write(pkt);
+    r.stop(false);
+    r.wait();
+    QVERIFY(!r.isRecording());
+    QVERIFY(r.bytesWritten() > 0);
+    QVERIFY(QFileInfo::exists(dir.filePath("out000.ts")));
+}
+
+void tst_QAVDemuxer::seekIndex()
+{
+    // Program stream has no index
+    const QString fileName = testData("star_trails.mpeg");
+    QTemporaryDir cache;
+    QVERIFY(cache.isValid());
+
+    QAVDemuxer d;
+    d.setSeekIndexDirectory(cache.path());
+    d.setSeekIndexPrescan(true);
+    QVERIFY(d.load(fileName) >= 0);
+    QVERIFY(d.seekIndexSize() >= 0);
+    QTRY_VERIFY(d.isSeekIndexComplete());
+    const int keyframes = d.seekIndexSize();
+    QVERIFY(keyframes > 1);
+    QTRY_VERIFY(!QDir(cache.path()).isEmpty());
+
+    // Reads from the last keyframe before the position
+    const int video = d.currentVideoStreams().first().index();
+    const double target = d.duration() / 2;
+    QCOMPARE(d.seekIndexHits(), 0);
+    QVERIFY(d.seek(target) >= 0);
+    QCOMPARE(d.seekIndexHits(), 1);
+    QAVPacket p;
+    while ((p = d.read()) && p.packet()->stream_index != video);
+    QVERIFY(p);
+    QVERIFY(p.packet()->flags & AV_PKT_FLAG_KEY);
+    QVERIFY(p.pts() <= target);
+    while ((p = d.read()) && !(p.packet()->stream_index == video && (p.packet()->flags & AV_PKT_FLAG_KEY)));
+    QVERIFY(p);
+    QVERIFY(p.pts() > target);
+
+    // Loaded from the cache
+    QAVDemuxer c;
+    c.setSeekIndexDirectory(cache.path());
+    QVERIFY(c.load(fileName) >= 0);
+    QVERIFY(c.isSeekIndexComplete());
+    QCOMPARE(c.seekIndexSize(), keyframes);
+    QVERIFY(c.seek(target) >= 0);
+    QCOMPARE(c.seekIndexHits(), 1);
+
+    // Built while reading
+    QAVDemuxer r;
+    QVERIFY(r.load(fileName) >= 0);
+    QVERIFY(!r.isSeekIndexComplete());
+    while (r.read());
+    QVERIFY(r.isSeekIndexComplete());
+    QCOMPARE(r.seekIndexSize(), keyframes);
+    QVERIFY(r.seek(target) >= 0);
+    QCOMPARE(r.seekIndexHits(), 1);
+
+    // Saved in background after unloading
+    QTemporaryDir later;
+    QVERIFY(later.isValid());
+    QAVDemuxer u;
+    u.setSeekIndexDirectory(later.path());
+    QVERIFY(u.load(fileName) >= 0);
+    while (u.read());
+    u.unload();
+    QTRY_VERIFY(!QDir(later.path()).isEmpty());
+
+    // Not needed if the format has the index
+    QAVDemuxer mp4;
+    QVERIFY(mp4.load(testData("colors.mp4")) >= 0);
+    QCOMPARE(mp4.seekIndexSize(), -1);
+    QVERIFY(mp4.seek(1) >= 0);
+    QCOMPARE(mp4.seekIndexHits(), 0);
+}
+
+void tst_QAVDemuxer::seekIndexDiscontinuity()
+{
+    // Timestamps restart in the middle of the file
+    QAVSeekIndex index;
+    index.add(0, 0, false);
+    index.add(2, 100, true);
+    index.add(4, 200, true);
+    index.add(1, 300, true);
+    index.add(3, 400, true);
+    QCOMPARE(index.size(), 5);
+
+    // The first range having the time is used
+    int64_t pos = -1;
+    QVERIFY(index.find(3, pos));
+    QCOMPARE(pos, int64_t(100));
+    QVERIFY(index.find(1, pos));
+    QCOMPARE(pos, int64_t(0));
+    QVERIFY(index.find(5, pos));
+    QCOMPARE(pos, int64_t(200));
+
+    // Same pts at another offset is not merged
+    index.add(2, 500, true);
+    QCOMPARE(index.size(), 6);
+    index.add(2, 500, true);
+    QCOMPARE(index.size(), 6);
+
+    // Keyframes could be missing before an offset added after a seek
+    QAVSeekIndex gaps;
+    gaps.add(0, 0, false);
+    gaps.add(4, 200, false);
+    // The end is not known yet
+    QVERIFY(!gaps.find(5, pos));
+    gaps.setComplete();
+    QVERIFY(!gaps.find(2, pos));
+    QVERIFY(gaps.find(5, pos));
+    QCOMPARE(pos, int64_t(200));
+}
+
 QTEST_MAIN(tst_QAVDemuxer)
 #include "tst_qavdemuxer.moc"
@@ -7,13 +7,31 @@
 
 #include "qavplayer.h"
 #include "qavaudiooutput.h"
+#include "qavaudiooutputdevice.h"
+#include "qavaudioconverter.h"
 #include "qaviodevice.h"
+#include "qavvideoframeexporter.h"
+#include "qavvideoframeimporter.h"
+#include "qavtimestretch_p.h"
+#include "qavaudiomixer_p.h"
+#include "qavaudiometer.h"
+#include "qavaudiowaveform.h"
+#include "qavsegmentdecoder.h"
+#include "qavdemuxer_p.h"
 
 #include <QDebug>
 #include <QtTest/QtTest>
+#include <QProcess>
+#include <QtConcurrent/qtconcurrentrun.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
+#include <libavformat/avio.h>
+#include <libavformat/avformat.h>
 }
 
 #ifndef TEST_DATA_DIR
@@ -22,6 +40,50 @@ extern "C" {
 
 QT_USE_NAMESPACE
 
+Q_DECLARE_METATYPE(QAVIODevice::ReadMode)
+
+class TestFrameAllocator : public QAVVideoFrameAllocator
+{
+public:
+    bool allocate(Planes &planes) override
+    {
+        QMutexLocker locker(&mutex);
+        int size = 0;
+        for (int i = 0; i < planes.count; ++i)
+            size += planes.bytes[i] + alignment;
+        auto raw = new uchar[size];
+        planes.opaque = raw;
+        uchar *p = raw;
+        for (int i = 0; i < planes.count; ++i) {
+            planes.data[i] = reinterpret_cast<uchar *>((reinterpret_cast<uintptr_t>(p) + alignment - 1) & ~uintptr_t(alignment - 1));
+            p = planes.data[i] + planes.bytes[i];
+            data.insert(planes.data[i]);
+        }
+        ++allocated;
+        return true;
+    }
+
+    void release(const Planes &planes) override
+    {
+        QMutexLocker locker(&mutex);
+        for (int i = 0; i < planes.count; ++i)
+            data.remove(planes.data[i]);
+        delete [] static_cast<uchar *>(planes.opaque);
+        ++released;
+    }
+
+    bool contains(const uchar *p) const
+    {
+        QMutexLocker locker(&mutex);
+        return data.contains(p);
+    }
+
+    mutable QMutex mutex;
+    QSet<const uchar *> data;
+    QAtomicInt allocated;
+    QAtomicInt released;
+};
+
 class tst_QAVPlayer : public QObject
 {
     Q_OBJECT
@@ -36,11 +98,31 @@ private slots:
     void playIncorrectSource();
     void playAudio();
     void playAudioOutput();
+    void audioPreferredFormats();
     void pauseAudio();
     void stopAudio();
     void seekAudio();
     void speedAudio();
+    void timeStretch_data();
+    void timeStretch();
+    void timeStretchFrames_data();
+    void timeStretchFrames();
+    void timeStretchBenchmark_data();
+    void timeStretchBenchmark();
+    void audioMixer();
+    void audioMixedStreams();
+    void audioMeter_data();
+    void audioMeter();
+    void audioLevels();
+    void audioWaveform();
+    void segmentDecoder();
+    void segmentDecoderFiles_data();
+    void segmentDecoderFiles();
+    void segmentDecoderBenchmark_data();
+    void segmentDecoderBenchmark();
     void audioPositionWithCover();
+    void audioConverterReuse();
+    void audioConverterBenchmark();
     void playVideo();
     void pauseVideo();
     void seekVideo();
@@ -54,6 +136,16 @@ private slots:
     void files_io();
     void convert_data();
     void convert();
+    void convertColorSpace_data();
+    void convertColorSpace();
+    void framePool();
+    void frameAllocator();
+    void sharedMemoryFrames();
+    void sharedMemoryImporterProcess();
+    void sharedMemoryProcesses();
+#ifdef QT_AVPLAYER_MULTIMEDIA
+    void toImage();
+#endif
     void map_data();
     void map();
     void stepForward();
@@ -62,7 +154,15 @@ private slots:
 #ifdef QT_AVPLAYER_MULTIMEDIA
     void cast2QVideoFrame_data();
     void cast2QVideoFrame();
+    void cast2QVideoFrameFormats_data();
+    void cast2QVideoFrameFormats();
     void audioOutput();
+    void audioOutputDevice();
+    void audioOutputPlayedPts();
+    void audioOutputPlayOverBuffer();
+    void audioOutputPlayBenchmark();
+    void audioOutputLatency_data();
+    void audioOutputLatency();
     void multiPlayers();
 #endif
     void setEmptySource();
@@ -77,6 +177,22 @@ private slots:
     void filesIO();
     void filesIOSequential_data();
     void filesIOSequential();
+    void filesIOReadMode_data();
+    void filesIOReadMode();
+    void filesIOReadModeBenchmark_data();
+    void filesIOReadModeBenchmark();
+    void filesIOMapped();
+    void filesIOBufferSize_data();
+    void filesIOBufferSize();
+    void filesIOBufferSizeBenchmark_data();
+    void filesIOBufferSizeBenchmark();
+    void filesIOReadAhead_data();
+    void filesIOReadAhead();
+    void pushData();
+    void pushPacket();
+    void timeshift();
+    void recording_data();
+    void recording();
     void subfile();
     void subfileTar();
     void subtitles();
@@ -309,6 +425,54 @@ void tst_QAVPlayer::playAudioOutput()
     QCOMPARE(p.position(), p.duration());
 }
 
+void tst_QAVPlayer::audioPreferredFormats()
+{
+    QAVPlayer p;
+
+    QFileInfo file(testData("test.mp3"));
+    p.setSource(file.absoluteFilePath());
+
+    QMutex mutex;
+    QAVAudioFrame frame;
+    std::atomic_bool received {false};
+    QObject::connect(&p, &QAVPlayer::audioFrame, &p, [&](const QAVAudioFrame &f) {
+        QMutexLocker locker(&mutex);
+        if (!received)
+            frame = f;
+        received = true;
+    }, Qt::DirectConnection);
+    p.play();
+    QTRY_VERIFY(received);
+    p.stop();
+    QMutexLocker locker(&mutex);
+
+    auto f = frame.frame();
+    if (f->format != AV_SAMPLE_FMT_FLTP)
+        QSKIP("The decoder does not produce planar float");
+
+    const int channels = frame.format().channelCount();
+    const int planeSize = f->nb_samples * int(sizeof(float));
+    QCOMPARE(frame.format().sampleFormat(), QAVAudioFormat::Int32);
+
+    // Decoded format is returned as is
+    frame.setPreferredSampleFormats({QAVAudioFormat::Float, QAVAudioFormat::FloatPlanar});
+    QCOMPARE(frame.format().sampleFormat(), QAVAudioFormat::FloatPlanar);
+    QCOMPARE(frame.format().sampleRate(), f->sample_rate);
+    auto data = frame.data();
+    QCOMPARE(data.size(), planeSize * channels);
+    for (int i = 0; i < channels; ++i)
+        QVERIFY(memcmp(data.constData() + i * planeSize, f->extended_data[i], planeSize) == 0);
+
+    // Interleaved by the first preferred format
+    frame.setPreferredSampleFormats({QAVAudioFormat::Float, QAVAudioFormat::Int16});
+    QCOMPARE(frame.format().sampleFormat(), QAVAudioFormat::Float);
+    data = frame.data();
+    QCOMPARE(data.size(), planeSize * channels);
+    auto samples = reinterpret_cast<const float *>(data.constData());
+    for (int i = 0; i < channels; ++i)
+        QCOMPARE(samples[i], reinterpret_cast<const float *>(f->extended_data[i])[0]);
+}
+
 void tst_QAVPlayer::pauseAudio()
 {
     QAVPlayer p;
@@ -436,6 +600,637 @@ void tst_QAVPlayer::speedAudio()
     QTRY_COMPARE(p.mediaStatus(), QAVPlayer::EndOfMedia);
 }
 
+static std::vector<float> sine(int rate, int channels, double freq, double seconds)
+{
+    const int frames = int(rate * seconds);
+    std::vector<float> samples(size_t(frames) * channels);
+    for (int i = 0; i < frames; ++i) {
+        for (int c = 0; c < channels; ++c)
+            samples[size_t(i) * channels + c] = float(0.5 * sin(2 * 3.14159265358979 * freq * i / rate));
+    }
+    return samples;
+}
+
+static QAVFrame sineFrame(AVSampleFormat format, int rate, int channels, double amplitude, int samples)
+{
+    QAVFrame frame;
+    auto f = frame.frame();
+    f->format = format;
+    f->sample_rate = rate;
+    f->nb_samples = samples;
+#if LIBAVUTIL_VERSION_INT <= AV_VERSION_INT(57, 23, 0)
+    f->channel_layout = av_get_default_channel_layout(channels);
+    f->channels = channels;
+#else
+    av_channel_layout_default(&f->ch_layout, channels);
+#endif
+    av_frame_get_buffer(f, 0);
+    const bool planar = av_sample_fmt_is_planar(format);
+    for (int i = 0; i < samples; ++i) {
+        const double v = amplitude * sin(2 * 3.14159265358979 * 1000 * i / rate);
+        for (int c = 0; c < channels; ++c) {
+            const int idx = planar ? i : i * channels + c;
+            uint8_t *plane = f->extended_data[planar ? c : 0];
+            switch (av_get_packed_sample_fmt(format)) {
+            case AV_SAMPLE_FMT_S16:
+                reinterpret_cast<int16_t *>(plane)[idx] = int16_t(lrint(v * 32767));
+                break;
+            case AV_SAMPLE_FMT_S32:
+                reinterpret_cast<int32_t *>(plane)[idx] = int32_t(lrint(v * 2147483647.0));
+                break;
+            case AV_SAMPLE_FMT_DBL:
+                reinterpret_cast<double *>(plane)[idx] = v;
+                break;
+            default:
+                reinterpret_cast<float *>(plane)[idx] = float(v);
+                break;
+            }
+        }
+    }
+    f->pts = 0;
+    frame.setTimeBase({1, rate});
+    return frame;
+}
+
+void tst_QAVPlayer::timeStretch_data()
+{
+    QTest::addColumn<double>("speed");
+
+    QTest::newRow("0.5") << 0.5;
+    QTest::newRow("1.5") << 1.5;
+    QTest::newRow("2.0") << 2.0;
+    QTest::newRow("3.0") << 3.0;
+}
+
+void tst_QAVPlayer::timeStretch()
+{
+    QFETCH(double, speed);
+
+    const int rate = 48000;
+    const double freq = 440;
+    const auto in = sine(rate, 2, freq, 2.0);
+    QAVTimeStretch stretch;
+    stretch.setFormat(rate, 2);
+    stretch.setSpeed(speed);
+
+    std::vector<float> out;
+    const int chunk = 1024;
+    const int frames = int(in.size() / 2);
+    for (int i = 0; i < frames; i += chunk)
+        stretch.process(in.data() + i * 2, qMin(chunk, frames - i), out);
+
+    // Duration is changed by the speed
+    const double duration = double(out.size() / 2) / rate;
+    QVERIFY2(qAbs(duration - 2.0 / speed) < 0.1, qPrintable(QString::number(duration)));
+
+    // Pitch is kept: the same number of zero crossings per second
+    int crossings = 0;
+    for (size_t i = 2; i < out.size(); i += 2) {
+        if ((out[i - 2] < 0) != (out[i] < 0))
+            ++crossings;
+    }
+    const double measured = crossings / 2.0 / duration;
+    QVERIFY2(qAbs(measured - freq) < freq * 0.05, qPrintable(QString::number(measured)));
+}
+
+void tst_QAVPlayer::timeStretchFrames_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<int>("channels");
+    QTest::addColumn<double>("speed");
+
+    QTest::newRow("s16 2ch 0.5x") << int(AV_SAMPLE_FMT_S16) << 2 << 0.5;
+    QTest::newRow("s16p 6ch 2x") << int(AV_SAMPLE_FMT_S16P) << 6 << 2.0;
+    QTest::newRow("s32 1ch 1.5x") << int(AV_SAMPLE_FMT_S32) << 1 << 1.5;
+    QTest::newRow("fltp 2ch 3x") << int(AV_SAMPLE_FMT_FLTP) << 2 << 3.0;
+}
+
+void tst_QAVPlayer::timeStretchFrames()
+{
+    QFETCH(int, format);
+    QFETCH(int, channels);
+    QFETCH(double, speed);
+
+    const int rate = 48000;
+    const int samples = 1024;
+    const int count = 94;
+    QAVTimeStretch stretch;
+    qint64 outSamples = 0;
+    float peak = 0;
+    double expectedPts = NAN;
+    for (int i = 0; i < count; ++i) {
+        auto frame = sineFrame(AVSampleFormat(format), rate, channels, 0.5, samples);
+        frame.frame()->pts = qint64(i) * samples;
+        const auto out = stretch.process(frame, speed);
+        if (!out)
+            continue;
+
+        // Any sample format is stretched to interleaved float of the same layout
+        QCOMPARE(out.frame()->format, int(AV_SAMPLE_FMT_FLT));
+        QCOMPARE(out.frame()->sample_rate, rate);
+        QCOMPARE(QAVAudioFrame(out).format().channelCount(), channels);
+
+        // Pts are in the media time, each output moves it by speed * duration
+        if (!std::isnan(expectedPts))
+            QVERIFY2(qAbs(out.pts() - expectedPts) < 0.001, qPrintable(QString::number(out.pts())));
+        const int n = out.frame()->nb_samples;
+        expectedPts = out.pts() + speed * n / rate;
+        outSamples += n;
+
+        const float *data = reinterpret_cast<const float *>(out.frame()->data[0]);
+        for (int j = 0; j < n * channels; ++j)
+            peak = qMax(peak, qAbs(data[j]));
+    }
+
+    const double duration = double(outSamples) / rate;
+    const double expected = double(count) * samples / rate / speed;
+    QVERIFY2(qAbs(duration - expected) < 0.1, qPrintable(QString::number(duration)));
+    QVERIFY2(qAbs(peak - 0.5f) < 0.1f, qPrintable(QString::number(peak)));
+}
+
+void tst_QAVPlayer::timeStretchBenchmark_data()
+{
+    QTest::addColumn<int>("channels");
+    QTest::addColumn<double>("speed");
+
+    for (int channels : {2, 6}) {
+        for (double speed : {0.5, 1.5, 2.0, 3.0}) {
+            const QString name = QString(QLatin1String("%1ch %2x")).arg(channels).arg(speed);
+            QTest::newRow(qPrintable(name)) << channels << speed;
+        }
+    }
+}
+
+void tst_QAVPlayer::timeStretchBenchmark()
+{
+    QFETCH(int, channels);
+    QFETCH(double, speed);
+
+    const int rate = 48000;
+    const auto in = sine(rate, channels, 440, 5.0);
+    const int frames = int(in.size() / channels);
+    std::vector<float> out;
+    qint64 elapsed = 0;
+    int runs = 0;
+    QBENCHMARK {
+        QElapsedTimer timer;
+        timer.start();
+        QAVTimeStretch stretch;
+        stretch.setFormat(rate, channels);
+        stretch.setSpeed(speed);
+        out.clear();
+        for (int i = 0; i < frames; i += 1024)
+            stretch.process(in.data() + i * channels, qMin(1024, frames - i), out);
+        elapsed += timer.nsecsElapsed();
+        ++runs;
+    }
+
+    QVERIFY(!out.empty());
+    // Seconds of input audio processed per second of CPU time
+    qDebug() << "Realtime factor:" << 5.0 * runs * 1e9 / qMax<qint64>(elapsed, 1);
+}
+
+static QAVFrame floatFrame(int index, float value, int samples, qint64 pts)
+{
+    const int rate = 48000;
+    QAVFrame frame;
+    frame.setStream(QAVStream(index));
+    auto f = frame.frame();
+    f->format = AV_SAMPLE_FMT_FLT;
+    f->sample_rate = rate;
+    f->nb_samples = samples;
+#if LIBAVUTIL_VERSION_INT <= AV_VERSION_INT(57, 23, 0)
+    f->channel_layout = av_get_default_channel_layout(2);
+    f->channels = 2;
+#else
+    av_channel_layout_default(&f->ch_layout, 2);
+#endif
+    av_frame_get_buffer(f, 0);
+    auto data = reinterpret_cast<float *>(f->data[0]);
+    std::fill(data, data + samples * 2, value);
+    f->pts = pts;
+    frame.setTimeBase({1, rate});
+    return frame;
+}
+
+static int mixedSamples(const QList<QAVFrame> &frames, float value)
+{
+    int samples = 0;
+    for (const auto &frame : frames) {
+        auto f = frame.frame();
+        auto data = reinterpret_cast<const float *>(f->data[0]);
+        for (int i = 0; i < f->nb_samples * 2; ++i) {
+            if (!qFuzzyCompare(data[i], value))
+                return -1;
+        }
+        samples += f->nb_samples;
+    }
+    return samples;
+}
+
+void tst_QAVPlayer::audioMixer()
+{
+    float dst[7] = {1, 1, 1, 1, 1, 1, 1};
+    const float src[7] = {1, 2, 3, 4, 5, 6, 7};
+    QAVAudioMixer::mix(dst, src, 7, 0.5f);
+    for (int i = 0; i < 7; ++i)
+        QCOMPARE(dst[i], 1 + src[i] * 0.5f);
+
+    QAVAudioMixer mixer;
+    mixer.setStreams({QAVStream(0), QAVStream(1)});
+    mixer.setGains({{0, 0.5}, {1, 0.25}});
+
+    // Waits for the second stream
+    QVERIFY(mixer.write(floatFrame(0, 1, 1024, 0)).isEmpty());
+    auto frames = mixer.write(floatFrame(1, 2, 1024, 0));
+    QCOMPARE(mixedSamples(frames, 1.0f), 1024);
+    QCOMPARE(frames[0].pts(), 0.0);
+    QCOMPARE(mixer.sampleRate(), 48000);
+    QCOMPARE(mixer.channels(), 2);
+    QAVAudioFrame audio = frames[0];
+    QCOMPARE(audio.format().sampleRate(), 48000);
+    QCOMPARE(audio.format().channelCount(), 2);
+
+    // Aligned by pts whatever the order of frames
+    QVERIFY(mixer.write(floatFrame(1, 2, 1024, 1024)).isEmpty());
+    frames = mixer.write(floatFrame(0, 1, 1024, 1024));
+    QCOMPARE(mixedSamples(frames, 1.0f), 1024);
+    QCOMPARE(frames[0].pts(), 1024 / 48000.0);
+
+    // The second stream is silent
+    QVERIFY(mixer.write(floatFrame(0, 1, 1024, 2048)).isEmpty());
+    frames = mixer.flush();
+    QCOMPARE(mixedSamples(frames, 0.5f), 1024);
+    QVERIFY(mixer.flush().isEmpty());
+
+    // Pts jump restarts the mixing
+    QVERIFY(mixer.write(floatFrame(1, 2, 1024, 480000)).isEmpty());
+    frames = mixer.write(floatFrame(0, 1, 1024, 480000));
+    QCOMPARE(mixedSamples(frames, 1.0f), 1024);
+    QCOMPARE(frames[0].pts(), 10.0);
+}
+
+void tst_QAVPlayer::audioMixedStreams()
+{
+    QAVPlayer p;
+    QFileInfo file(testData("guido.mp4"));
+
+    QMutex mutex;
+    QSet<int> streams;
+    qint64 samples = 0;
+    int sampleRate = 0;
+    QAVAudioFormat::SampleFormat sampleFormat = QAVAudioFormat::Unknown;
+    QObject::connect(&p, &QAVPlayer::audioFrame, &p, [&](const QAVAudioFrame &f) {
+        QAVAudioFrame frame = f;
+        frame.setPreferredSampleFormats({QAVAudioFormat::Float});
+        QMutexLocker locker(&mutex);
+        streams.insert(frame.stream().index());
+        samples += frame.frame()->nb_samples;
+        sampleRate = frame.format().sampleRate();
+        sampleFormat = frame.format().sampleFormat();
+    }, Qt::DirectConnection);
+
+    p.setSource(file.absoluteFilePath());
+    QTRY_COMPARE(p.mediaStatus(), QAVPlayer::LoadedMedia);
+    QCOMPARE(p.availableAudioStreams().size(), 2);
+    p.setAudioStreams(p.availableAudioStreams());
+    QVERIFY(!p.isAudioMixed());
+    p.setAudioMixed(true);
+    QVERIFY(p.isAudioMixed());
+    QCOMPARE(p.audioStreamGain(p.availableAudioStreams()[1]), 1.0);
+    p.setAudioStreamGain(p.availableAudioStreams()[1], 0.5);
+    QCOMPARE(p.audioStreamGain(p.availableAudioStreams()[1]), 0.5);
+    p.setSynced(false);
+    p.play();
+
+    // Both streams are 3 seconds long and played at the same time
+    auto duration = [&] {
+        QMutexLocker locker(&mutex);
+        return sampleRate > 0 ? double(samples) / sampleRate : 0.0;
+    };
+    QTRY_COMPARE(p.mediaStatus(), QAVPlayer::EndOfMedia);
+    QTRY_VERIFY(qAbs(duration() - 3.0) < 0.1);
+
+    QMutexLocker locker(&mutex);
+    QCOMPARE(streams.size(), 1);
+    QCOMPARE(sampleFormat, QAVAudioFormat::Float);
+    QVERIFY(sampleRate > 0);
+}
+
+void tst_QAVPlayer::audioMeter_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<int>("channels");
+
+    QTest::newRow("flt stereo") << int(AV_SAMPLE_FMT_FLT) << 2;
+    QTest::newRow("fltp stereo") << int(AV_SAMPLE_FMT_FLTP) << 2;
+    QTest::newRow("flt 3ch") << int(AV_SAMPLE_FMT_FLT) << 3;
+    QTest::newRow("s16 stereo") << int(AV_SAMPLE_FMT_S16) << 2;
+    QTest::newRow("s16 3ch") << int(AV_SAMPLE_FMT_S16) << 3;
+    QTest::newRow("s16p mono") << int(AV_SAMPLE_FMT_S16P) << 1;
+    QTest::newRow("s32 stereo") << int(AV_SAMPLE_FMT_S32) << 2;
+    QTest::newRow("s32p 4ch") << int(AV_SAMPLE_FMT_S32P) << 4;
+    QTest::newRow("dblp stereo") << int(AV_SAMPLE_FMT_DBLP) << 2;
+}
+
+void tst_QAVPlayer::audioMeter()
+{
+    QFETCH(int, format);
+    QFETCH(int, channels);
+
+    const int rate = 48000;
+    QAVAudioMeter meter;
+    meter.setLoudnessEnabled(true);
+    // 1 second of 1 kHz sine at -6 dBFS
+    for (int i = 0; i < 10; ++i)
+        meter.process(sineFrame(AVSampleFormat(format), rate, channels, 0.5, rate / 10));
+    QCOMPARE(meter.duration(), 1.0);
+
+    auto levels = meter.takeLevels();
+    QCOMPARE(levels.peak.size(), channels);
+    QCOMPARE(levels.rms.size(), channels);
+    for (int c = 0; c < channels; ++c) {
+        QVERIFY2(qAbs(levels.peak[c] - 0.5f) < 0.001f, qPrintable(QString::number(levels.peak[c])));
+        QVERIFY2(qAbs(levels.rms[c] - 0.5f / sqrtf(2)) < 0.001f, qPrintable(QString::number(levels.rms[c])));
+    }
+    // The loudness of a full scale 1 kHz sine in one channel is -3.01 LUFS
+    const double expected = -3.01 - 6.02 + 10 * log10(channels);
+    QVERIFY2(qAbs(levels.momentaryLoudness - expected) < 0.2, qPrintable(QString::number(levels.momentaryLoudness)));
+
+    QCOMPARE(meter.duration(), 0.0);
+    meter.setLoudnessEnabled(false);
+    meter.process(sineFrame(AVSampleFormat(format), rate, channels, 0.25, rate / 10));
+    levels = meter.takeLevels();
+    QVERIFY(qAbs(levels.peak[0] - 0.25f) < 0.001f);
+    QVERIFY(qIsNaN(levels.momentaryLoudness));
+}
+
+void tst_QAVPlayer::audioLevels()
+{
+    QAVPlayer p;
+    QFileInfo file(testData("test.mp3"));
+
+    QMutex mutex;
+    QList<QAVAudioLevels> levels;
+    QObject::connect(&p, &QAVPlayer::audioLevels, &p, [&](const QAVAudioLevels &l) {
+        QMutexLocker locker(&mutex);
+        levels.append(l);
+    }, Qt::DirectConnection);
+
+    p.setSource(file.absoluteFilePath());
+    QCOMPARE(p.audioLevelsInterval(), 0);
+    p.setAudioLevelsInterval(100);
+    QCOMPARE(p.audioLevelsInterval(), 100);
+    p.setAudioLoudnessEnabled(true);
+    QVERIFY(p.isAudioLoudnessEnabled());
+    p.setSynced(false);
+    p.play();
+
+    QTRY_COMPARE(p.mediaStatus(), QAVPlayer::EndOfMedia);
+    mutex.lock();
+    const auto received = levels;
+    mutex.unlock();
+    QVERIFY(!received.isEmpty());
+    bool loud = false;
+    for (const auto &l : received) {
+        QVERIFY(!l.peak.isEmpty());
+        QCOMPARE(l.peak.size(), l.rms.size());
+        for (int c = 0; c < l.peak.size(); ++c) {
+            QVERIFY(l.peak[c] >= 0 && l.peak[c] <= 1.01f);
+            QVERIFY(l.rms[c] <= l.peak[c] + 0.0001f);
+        }
+        if (!qIsNaN(l.momentaryLoudness))
+            loud = true;
+    }
+    QVERIFY(loud);
+}
+
+void tst_QAVPlayer::audioWaveform()
+{
+    QFileInfo file(testData("test.mp3"));
+    QTemporaryDir cache;
+    QVERIFY(cache.isValid());
+
+    auto generate = [&](int threads, bool cached) {
+        QAVAudioWaveform w;
+        w.setSource(file.absoluteFilePath());
+        w.setResolution(50);
+        w.setThreadCount(threads);
+        if (cached)
+            w.setCacheDirectory(cache.path());
+        QSignalSpy progress(&w, &QAVAudioWaveform::progress);
+        QSignalSpy finished(&w, &QAVAudioWaveform::finished);
+        w.start();
+        if (!finished.wait(10000) || !w.isFinished() || progress.isEmpty() || w.duration() <= 0)
+            return QVector<QAVAudioWaveformBucket>();
+        return w.buckets();
+    };
+
+    const auto single = generate(1, false);
+    const auto parallel = generate(4, true);
+    QVERIFY(!single.isEmpty());
+    QCOMPARE(parallel.size(), single.size());
+
+    int audible = 0;
+    int same = 0;
+    for (int i = 0; i < single.size(); ++i) {
+        const auto &b = single[i];
+        if (b.min > b.max)
+            continue;
+        ++audible;
+        QVERIFY(b.min >= -1.01f && b.max <= 1.01f);
+        QVERIFY(b.rms <= qMax(qAbs(b.min), qAbs(b.max)) + 0.0001f);
+        const auto &p = parallel[i];
+        if (qAbs(p.min - b.min) < 0.01f && qAbs(p.max - b.max) < 0.01f)
+            ++same;
+    }
+    QVERIFY(audible > single.size() * 9 / 10);
+    // Only the buckets near the range boundaries might differ
+    QVERIFY(same > audible * 9 / 10);
+
+    // Loaded from the cache
+    QCOMPARE(QDir(cache.path()).entryList(QDir::Files).size(), 1);
+    const auto cached = generate(4, true);
+    QCOMPARE(cached.size(), parallel.size());
+    for (int i = 0; i < cached.size(); ++i) {
+        QCOMPARE(cached[i].min, parallel[i].min);
+        QCOMPARE(cached[i].max, parallel[i].max);
+        QCOMPARE(cached[i].rms, parallel[i].rms);
+    }
+
+    QAVAudioWaveform w;
+    w.setSource(file.absoluteFilePath());
+    w.setResolution(50);
+    w.setThreadCount(1);
+    QSignalSpy finished(&w, &QAVAudioWaveform::finished);
+    w.start();
+    QTRY_COMPARE(finished.count(), 1);
+
+    // Zoom out from the overview
+    const auto overview = w.buckets(0, w.duration(), 10);
+    QCOMPARE(overview.size(), 10);
+    for (const auto &b : overview)
+        QVERIFY(b.min <= b.max);
+
+    // Zoom in beyond the resolution
+    const auto zoomed = w.decode(1.0, 1.1, 100);
+    QCOMPARE(zoomed.size(), 100);
+    int filled = 0;
+    for (const auto &b : zoomed)
+        filled += b.min <= b.max ? 1 : 0;
+    QVERIFY(filled > 90);
+}
+
+void tst_QAVPlayer::segmentDecoder()
+{
+    QFileInfo file(testData("colors.mp4"));
+
+    QList<double> boundaries;
+    auto decode = [&](int threads, bool ordered) {
+        QAVSegmentDecoder d;
+        d.setSource(file.absoluteFilePath());
+        d.setThreadCount(threads);
+        d.setOrdered(ordered);
+        d.setMaxBufferedBytes(1024 * 1024);
+        QMutex mutex;
+        QList<double> pts;
+        QObject::connect(&d, &QAVSegmentDecoder::videoFrame, &d, [&](const QAVVideoFrame &f) {
+            QMutexLocker locker(&mutex);
+            if (f)
+                pts.append(f.pts());
+        }, Qt::DirectConnection);
+        QSignalSpy finished(&d, &QAVSegmentDecoder::finished);
+        d.start();
+        if (!finished.wait(20000) || !d.isFinished() || d.framesCount() != pts.size())
+            return QList<double>();
+        boundaries = d.boundaries();
+        return pts;
+    };
+
+    const auto single = decode(1, true);
+    QVERIFY(!single.isEmpty());
+    QVERIFY(boundaries.isEmpty());
+    for (int i = 1; i < single.size(); ++i)
+        QVERIFY(single[i] > single[i - 1]);
+
+    // Same frames in the same order
+    const auto ordered = decode(4, true);
+    QCOMPARE(ordered, single);
+    // 15 seconds are split to 4 segments at keyframes, which come every 12 frames at 25 fps
+    QCOMPARE(boundaries.size(), 3);
+    for (int i = 0; i < boundaries.size(); ++i) {
+        QVERIFY(i == 0 || boundaries[i] > boundaries[i - 1]);
+        QVERIFY(boundaries[i] > single.first() && boundaries[i] < single.last());
+        QVERIFY(qAbs(boundaries[i] / 0.48 - qRound(boundaries[i] / 0.48)) < 0.001);
+    }
+
+    // Same frames, each one exactly once
+    auto unordered = decode(4, false);
+    std::sort(unordered.begin(), unordered.end());
+    QCOMPARE(unordered, single);
+
+    // Aborted while the frames are buffered
+    QAVSegmentDecoder d;
+    d.setSource(file.absoluteFilePath());
+    d.setThreadCount(4);
+    d.setMaxBufferedBytes(1);
+    std::atomic_int frames{0};
+    QObject::connect(&d, &QAVSegmentDecoder::videoFrame, &d, [&](const QAVVideoFrame &) {
+        ++frames;
+        QThread::msleep(10);
+    }, Qt::DirectConnection);
+    d.start();
+    QTRY_VERIFY(frames > 0);
+    d.abort();
+    QVERIFY(!d.isFinished());
+    QVERIFY(d.framesCount() < single.size());
+}
+
+void tst_QAVPlayer::segmentDecoderFiles_data()
+{
+    QTest::addColumn<QString>("path");
+
+    QTest::newRow("colors.mp4") << testData("colors.mp4");
+    QTest::newRow("small.mp4") << testData("small.mp4");
+    QTest::newRow("dv") << testData("dv25_pal__411_4-3_2ch_32k_bars_sine.dv");
+}
+
+void tst_QAVPlayer::segmentDecoderFiles()
+{
+    QFETCH(QString, path);
+
+    QFileInfo file(path);
+    auto decode = [&](int threads) {
+        QAVSegmentDecoder d;
+        d.setSource(file.absoluteFilePath());
+        d.setThreadCount(threads);
+        d.setOrdered(false);
+        QMutex mutex;
+        QList<double> pts;
+        QObject::connect(&d, &QAVSegmentDecoder::videoFrame, &d, [&](const QAVVideoFrame &f) {
+            QMutexLocker locker(&mutex);
+            if (f)
+                pts.append(f.pts());
+        }, Qt::DirectConnection);
+        QSignalSpy finished(&d, &QAVSegmentDecoder::finished);
+        d.start();
+        if (!finished.wait(60000) || d.framesCount() != pts.size() || d.boundaries().size() >= threads)
+            return QList<double>();
+        std::sort(pts.begin(), pts.end());
+        return pts;
+    };
+
+    // Each frame is decoded once whatever the segments are
+    const auto single = decode(1);
+    QVERIFY(!single.isEmpty());
+    QCOMPARE(decode(qMax(2, QThread::idealThreadCount())), single);
+}
+
+void tst_QAVPlayer::segmentDecoderBenchmark_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<int>("threads");
+    QTest::addColumn<bool>("ordered");
+
+    const int ideal = qMax(2, QThread::idealThreadCount());
+    for (const char *name : {"colors.mp4", "small.mp4", "dv25_pal__411_4-3_2ch_32k_bars_sine.dv"}) {
+        for (int threads : {1, ideal}) {
+            for (bool ordered : {true, false}) {
+                const QString row = QString(QLatin1String("%1 %2 threads %3"))
+                    .arg(QLatin1String(name)).arg(threads).arg(QLatin1String(ordered ? "ordered" : "unordered"));
+                QTest::newRow(qPrintable(row)) << testData(name) << threads << ordered;
+            }
+        }
+    }
+}
+
+void tst_QAVPlayer::segmentDecoderBenchmark()
+{
+    QFETCH(QString, path);
+    QFETCH(int, threads);
+    QFETCH(bool, ordered);
+
+    QFileInfo file(path);
+    qint64 frames = 0;
+    qint64 elapsed = 0;
+    QBENCHMARK {
+        QElapsedTimer timer;
+        timer.start();
+        QAVSegmentDecoder d;
+        d.setSource(file.absoluteFilePath());
+        d.setThreadCount(threads);
+        d.setOrdered(ordered);
+        QSignalSpy finished(&d, &QAVSegmentDecoder::finished);
+        d.start();
+        QVERIFY(finished.wait(60000));
+        frames += d.framesCount();
+        elapsed += timer.nsecsElapsed();
+    }
+
+    QVERIFY(frames > 0);
+    qDebug() << "Decoded frames per second:" << frames * 1e9 / qMax<qint64>(elapsed, 1);
+}
+
 void tst_QAVPlayer::audioPositionWithCover()
 {
     QAVPlayer p;
@@ -453,6 +1248,81 @@ void tst_QAVPlayer::audioPositionWithCover()
     QVERIFY(pos > 0);
 }
 
+void tst_QAVPlayer::audioConverterReuse()
+{
+    QAVPlayer p;
+    QList<QAVAudioFrame> frames;
+    QObject::connect(&p, &QAVPlayer::audioFrame, &p, [&frames](const QAVAudioFrame &f) { frames.append(f); });
+
+    QFileInfo file(testData("test.mp3"));
+    p.setSource(file.absoluteFilePath());
+    p.setSynced(false);
+    p.play();
+    QTRY_COMPARE(p.mediaStatus(), QAVPlayer::EndOfMedia);
+    QVERIFY(!frames.isEmpty());
+
+    QAVAudioConverter converter;
+    QByteArray prev;
+    QByteArray prevCopy;
+    for (const auto &frame : frames) {
+        const auto data = converter.data(frame);
+        const int channels = frame.format().channelCount();
+        QCOMPARE(data.size(), frame.frame()->nb_samples * channels * int(sizeof(qint32)));
+        // Same as a new converter since only the sample format is changed
+        QCOMPARE(data, QAVAudioConverter().data(frame));
+        // The reused scratch buffer does not change the returned data
+        QCOMPARE(prev, prevCopy);
+        prev = data;
+        prevCopy = QByteArray(data.constData(), data.size());
+    }
+
+    // Converting the same frame again gives the same data
+    QAVAudioFrame copy = frames.first();
+    QCOMPARE(copy.data(), frames.first().data());
+
+    // Consumers reading the frames of the stream in order and in different formats
+    for (int i = 1; i < frames.size(); ++i) {
+        QAVAudioFrame first = frames[i];
+        QAVAudioFrame second = frames[i];
+        QAVAudioFrame floats = frames[i];
+        floats.setPreferredSampleFormats({QAVAudioFormat::Float});
+        QCOMPARE(floats.format().sampleFormat(), QAVAudioFormat::Float);
+        const auto expected = QAVAudioConverter().data(frames[i]);
+        QCOMPARE(first.data(), expected);
+        QCOMPARE(floats.data(), QAVAudioConverter().data(floats));
+        QCOMPARE(second.data(), expected);
+    }
+}
+
+void tst_QAVPlayer::audioConverterBenchmark()
+{
+    QAVPlayer p;
+    QList<QAVAudioFrame> frames;
+    QObject::connect(&p, &QAVPlayer::audioFrame, &p, [&frames](const QAVAudioFrame &f) { frames.append(f); });
+
+    QFileInfo file(testData("test.mp3"));
+    p.setSource(file.absoluteFilePath());
+    p.setSynced(false);
+    p.play();
+    QTRY_COMPARE(p.mediaStatus(), QAVPlayer::EndOfMedia);
+    QVERIFY(!frames.isEmpty());
+
+    qint64 samples = 0;
+    qint64 elapsed = 0;
+    QBENCHMARK {
+        QElapsedTimer timer;
+        timer.start();
+        QAVAudioConverter converter;
+        for (const auto &frame : frames) {
+            QVERIFY(!converter.data(frame).isEmpty());
+            samples += frame.frame()->nb_samples;
+        }
+        elapsed += timer.nsecsElapsed();
+    }
+
+    qDebug() << "Converted samples per second:" << qint64(samples * 1e9 / qMax<qint64>(elapsed, 1));
+}
+
 void tst_QAVPlayer::playVideo()
 {
     QAVPlayer p;
@@ -1399,6 +2269,283 @@ void tst_QAVPlayer::convert()
     QCOMPARE(converted.format(), to);
 }
 
+void tst_QAVPlayer::convertColorSpace_data()
+{
+    QTest::addColumn<int>("colorSpace");
+    QTest::addColumn<int>("colorRange");
+    QTest::addColumn<double>("kr");
+    QTest::addColumn<double>("kb");
+
+    QTest::newRow("bt601 limited") << int(AVCOL_SPC_SMPTE170M) << int(AVCOL_RANGE_MPEG) << 0.299 << 0.114;
+    QTest::newRow("bt709 limited") << int(AVCOL_SPC_BT709) << int(AVCOL_RANGE_MPEG) << 0.2126 << 0.0722;
+    QTest::newRow("bt709 full") << int(AVCOL_SPC_BT709) << int(AVCOL_RANGE_JPEG) << 0.2126 << 0.0722;
+    QTest::newRow("bt2020 limited") << int(AVCOL_SPC_BT2020_NCL) << int(AVCOL_RANGE_MPEG) << 0.2627 << 0.0593;
+}
+
+void tst_QAVPlayer::convertColorSpace()
+{
+    QFETCH(int, colorSpace);
+    QFETCH(int, colorRange);
+    QFETCH(double, kr);
+    QFETCH(double, kb);
+
+    const int y = 120;
+    const int u = 90;
+    const int v = 170;
+    QAVVideoFrame frame(QSize(64, 64), AV_PIX_FMT_YUV420P);
+    auto f = frame.frame();
+    f->colorspace = AVColorSpace(colorSpace);
+    f->color_range = AVColorRange(colorRange);
+    for (int i = 0; i < f->height; ++i)
+        memset(f->data[0] + i * f->linesize[0], y, f->width);
+    for (int i = 0; i < f->height / 2; ++i) {
+        memset(f->data[1] + i * f->linesize[1], u, f->width / 2);
+        memset(f->data[2] + i * f->linesize[2], v, f->width / 2);
+    }
+
+    auto rgb = frame.convertTo(AV_PIX_FMT_RGB24);
+    QCOMPARE(rgb.format(), AV_PIX_FMT_RGB24);
+    QVERIFY(rgb.frame()->data[0] != nullptr);
+    QCOMPARE(rgb.frame()->color_range, AVCOL_RANGE_JPEG);
+
+    // Reference conversion
+    const bool full = colorRange == AVCOL_RANGE_JPEG;
+    const double yf = full ? y : (y - 16) * 255.0 / 219.0;
+    const double cb = full ? u - 128.0 : (u - 128) * 255.0 / 224.0;
+    const double cr = full ? v - 128.0 : (v - 128) * 255.0 / 224.0;
+    const double r = yf + 2 * (1 - kr) * cr;
+    const double b = yf + 2 * (1 - kb) * cb;
+    const double g = (yf - kr * r - kb * b) / (1 - kr - kb);
+
+    const uchar *px = rgb.frame()->data[0] + 32 * rgb.frame()->linesize[0] + 32 * 3;
+    QVERIFY2(qAbs(px[0] - qBound(0.0, r, 255.0)) <= 3, qPrintable(QString::number(px[0]) + " vs " + QString::number(r)));
+    QVERIFY2(qAbs(px[1] - qBound(0.0, g, 255.0)) <= 3, qPrintable(QString::number(px[1]) + " vs " + QString::number(g)));
+    QVERIFY2(qAbs(px[2] - qBound(0.0, b, 255.0)) <= 3, qPrintable(QString::number(px[2]) + " vs " + QString::number(b)));
+}
+
+void tst_QAVPlayer::framePool()
+{
+    const QSize size(321, 241);
+    uint8_t *data = nullptr;
+    {
+        QAVVideoFrame frame(size, AV_PIX_FMT_YUV420P);
+        QCOMPARE(frame.size(), size);
+        for (int i = 0; i < 3; ++i) {
+            QVERIFY(frame.frame()->data[i] != nullptr);
+            QCOMPARE(frame.frame()->linesize[i] % 64, 0);
+            QCOMPARE(reinterpret_cast<uintptr_t>(frame.frame()->data[i]) % 64, uintptr_t(0));
+        }
+        data = frame.frame()->data[0];
+
+        QAVVideoFrame ref = frame;
+        QCOMPARE(ref.frame()->data[0], data);
+    }
+
+    // The buffer is returned to the pool when the last reference is dropped
+    QAVVideoFrame frame(size, AV_PIX_FMT_YUV420P);
+    QCOMPARE(frame.frame()->data[0], data);
+    QAVVideoFrame other(size, AV_PIX_FMT_YUV420P);
+    QVERIFY(other.frame()->data[0] != data);
+
+    QAVVideoFrame rgb(size, AV_PIX_FMT_RGB32);
+    QVERIFY(rgb.frame()->data[0] != nullptr);
+    QCOMPARE(rgb.frame()->linesize[0] % 64, 0);
+    QVERIFY(rgb.frame()->linesize[0] >= size.width() * 4);
+}
+
+void tst_QAVPlayer::frameAllocator()
+{
+    QSharedPointer<TestFrameAllocator> allocator(new TestFrameAllocator);
+    {
+        QAVPlayer p;
+        p.setVideoFrameAllocator(allocator);
+        QCOMPARE(p.videoFrameAllocator(), allocator);
+
+        QFileInfo file(testData("colors.mp4"));
+        p.setSource(file.absoluteFilePath());
+
+        QMutex mutex;
+        QAVVideoFrame frame;
+        std::atomic_bool received {false};
+        std::atomic_bool allocated {true};
+        QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &f) {
+            if (!f.frame()->hw_frames_ctx && !allocator->contains(f.frame()->data[0]))
+                allocated = false;
+            QMutexLocker locker(&mutex);
+            frame = f;
+            received = true;
+        }, Qt::DirectConnection);
+
+        p.play();
+        QTRY_VERIFY(received);
+        p.stop();
+        QVERIFY(allocated);
+        QMutexLocker locker(&mutex);
+        QVERIFY(!frame.size().isEmpty());
+        if (!frame.frame()->hw_frames_ctx)
+            QVERIFY(allocator->allocated.loadAcquire() > 0);
+        frame = {};
+    }
+
+    // All buffers are returned when the frames and the decoder are gone
+    QCOMPARE(allocator->released.loadAcquire(), allocator->allocated.loadAcquire());
+}
+
+void tst_QAVPlayer::sharedMemoryFrames()
+{
+    const QSize size(320, 240);
+    const QString key = QString(QLatin1String("tst_qavplayer_%1")).arg(QCoreApplication::applicationPid());
+    QAVVideoFrameExporter exporter;
+    QVERIFY(exporter.create(key, 2, QAVVideoFrameExporter::frameBytes(size, AV_PIX_FMT_YUV420P)));
+
+    QAVVideoFrameImporter importer;
+    QVERIFY(importer.attach(key));
+    QVERIFY(importer.read().size().isEmpty());
+
+    auto frameWith = [&](uchar y) {
+        QAVVideoFrame frame(size, AV_PIX_FMT_YUV420P);
+        memset(frame.frame()->data[0], y, frame.frame()->linesize[0] * size.height());
+        frame.frame()->pts = y;
+        frame.setTimeBase({1, 1000});
+        return frame;
+    };
+
+    QVERIFY(exporter.write(frameWith(16)));
+    QAVVideoFrame frame = importer.read();
+    QCOMPARE(frame.size(), size);
+    QCOMPARE(frame.format(), AV_PIX_FMT_YUV420P);
+    QCOMPARE(frame.frame()->data[0][size.width() * size.height() / 2], uchar(16));
+    QCOMPARE(frame.pts(), 0.016);
+    QVERIFY(importer.read().size().isEmpty());
+
+    // The slot referenced by the imported frame is skipped, not overwritten
+    QVERIFY(exporter.write(frameWith(32)));
+    QVERIFY(exporter.write(frameWith(48)));
+    QCOMPARE(exporter.droppedFrames(), quint64(0));
+    QCOMPARE(frame.frame()->data[0][0], uchar(16));
+    QAVVideoFrame held = importer.read();
+    QCOMPARE(held.frame()->data[0][0], uchar(48));
+    // Frame 32 is overwritten and the number of the skipped slot is never published
+    QCOMPARE(importer.skippedFrames(), quint64(2));
+
+    // Dropped only if all slots are referenced
+    QVERIFY(!exporter.write(frameWith(64)));
+    QCOMPARE(exporter.droppedFrames(), quint64(1));
+    QCOMPARE(frame.frame()->data[0][0], uchar(16));
+    QCOMPARE(held.frame()->data[0][0], uchar(48));
+    frame = {};
+    held = {};
+    QVERIFY(exporter.write(frameWith(64)));
+    QCOMPARE(exporter.writtenFrames(), quint64(4));
+    QCOMPARE(importer.read().frame()->data[0][0], uchar(64));
+
+    // Lagging importer skips the overwritten frames
+    for (uchar y = 100; y < 105; ++y)
+        QVERIFY(exporter.write(frameWith(y)));
+    QCOMPARE(importer.read().frame()->data[0][0], uchar(103));
+    QCOMPARE(importer.skippedFrames(), quint64(5));
+    QCOMPARE(importer.read().frame()->data[0][0], uchar(104));
+
+    QVERIFY(!exporter.write(QAVVideoFrame(QSize(640, 480), AV_PIX_FMT_YUV420P)));
+}
+
+void tst_QAVPlayer::sharedMemoryImporterProcess()
+{
+    // Started by sharedMemoryProcesses() in a child process
+    const QString key = qEnvironmentVariable("QAV_IMPORTER_KEY");
+    if (key.isEmpty())
+        QSKIP("Runs only as the importer process of sharedMemoryProcesses");
+
+    QAVVideoFrameImporter importer;
+    QVERIFY(importer.attach(key));
+    printf("attached\n");
+    fflush(stdout);
+
+    QAVVideoFrame frame;
+    QTRY_VERIFY(!(frame = importer.read()).size().isEmpty());
+    printf("imported %d\n", frame.frame()->data[0][0]);
+    fflush(stdout);
+
+    // Exits holding the frame as if crashed
+    std::_Exit(0);
+}
+
+void tst_QAVPlayer::sharedMemoryProcesses()
+{
+    const QSize size(320, 240);
+    const QString key = QString(QLatin1String("tst_qavplayer_proc_%1")).arg(QCoreApplication::applicationPid());
+    QAVVideoFrameExporter exporter;
+    QVERIFY(exporter.create(key, 2, QAVVideoFrameExporter::frameBytes(size, AV_PIX_FMT_YUV420P)));
+
+    auto frameWith = [&](uchar y) {
+        QAVVideoFrame frame(size, AV_PIX_FMT_YUV420P);
+        memset(frame.frame()->data[0], y, frame.frame()->linesize[0] * size.height());
+        return frame;
+    };
+
+    QProcess importer;
+    auto env = QProcessEnvironment::systemEnvironment();
+    env.insert(QLatin1String("QAV_IMPORTER_KEY"), key);
+    importer.setProcessEnvironment(env);
+    importer.start(QCoreApplication::applicationFilePath(), {QLatin1String("sharedMemoryImporterProcess")});
+    QVERIFY(importer.waitForStarted());
+
+    QByteArray output;
+    auto waitFor = [&](const QByteArray &line) {
+        while (!output.contains(line)) {
+            if (!importer.waitForReadyRead(10000))
+                return false;
+            output += importer.readAllStandardOutput();
+        }
+        return true;
+    };
+
+    QVERIFY2(waitFor("attached\n"), output.constData());
+    QVERIFY(exporter.write(frameWith(16)));
+    QVERIFY2(waitFor("imported 16\n"), output.constData());
+    QVERIFY(importer.waitForFinished());
+
+    // The slot held by the exited importer is reused
+    QVERIFY(exporter.write(frameWith(32)));
+    QVERIFY(exporter.write(frameWith(48)));
+    QCOMPARE(exporter.droppedFrames(), quint64(0));
+
+    // The importer entry is free again
+    QAVVideoFrameImporter local;
+    QVERIFY(local.attach(key));
+    QVERIFY(exporter.write(frameWith(64)));
+    QCOMPARE(local.read().frame()->data[0][0], uchar(64));
+}
+
+#ifdef QT_AVPLAYER_MULTIMEDIA
+void tst_QAVPlayer::toImage()
+{
+    const QSize size(64, 48);
+    QImage image;
+    const uchar *data = nullptr;
+    quint64 fallbacks = QAVVideoFrame::conversionFallbackCount();
+    {
+        QAVVideoFrame frame(size, AV_PIX_FMT_RGB24);
+        memset(frame.frame()->data[0], 0x7f, frame.frame()->linesize[0] * size.height());
+        data = frame.frame()->data[0];
+        image = frame.toImage();
+    }
+
+    // No copy, the image keeps the buffer alive
+    QCOMPARE(image.format(), QImage::Format_RGB888);
+    QCOMPARE(image.size(), size);
+    QCOMPARE(image.constBits(), data);
+    QCOMPARE(image.pixel(10, 10), qRgb(0x7f, 0x7f, 0x7f));
+    QCOMPARE(QAVVideoFrame::conversionFallbackCount(), fallbacks);
+
+    QAVVideoFrame yuv(size, AV_PIX_FMT_YUV420P);
+    image = yuv.toImage();
+    QVERIFY(!image.isNull());
+    QCOMPARE(image.size(), size);
+    QCOMPARE(QAVVideoFrame::conversionFallbackCount(), fallbacks + 1);
+}
+#endif
+
 void tst_QAVPlayer::map_data()
 {
     QTest::addColumn<QString>("path");
@@ -1855,6 +3002,52 @@ void tst_QAVPlayer::cast2QVideoFrame()
 #endif
 }
 
+void tst_QAVPlayer::cast2QVideoFrameFormats_data()
+{
+    QTest::addColumn<AVPixelFormat>("from");
+
+    QTest::newRow("yuvj420p") << AV_PIX_FMT_YUVJ420P;
+    QTest::newRow("nv21") << AV_PIX_FMT_NV21;
+    QTest::newRow("uyvy422") << AV_PIX_FMT_UYVY422;
+    QTest::newRow("yuyv422") << AV_PIX_FMT_YUYV422;
+    QTest::newRow("gray8") << AV_PIX_FMT_GRAY8;
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    QTest::newRow("rgb24") << AV_PIX_FMT_RGB24;
+    QTest::newRow("rgb565") << AV_PIX_FMT_RGB565;
+#else
+    QTest::newRow("rgba") << AV_PIX_FMT_RGBA;
+    QTest::newRow("bgr0") << AV_PIX_FMT_BGR0;
+    QTest::newRow("p010") << AV_PIX_FMT_P010;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 4, 0)
+    QTest::newRow("yuv420p10") << AV_PIX_FMT_YUV420P10;
+#endif
+#endif
+}
+
+void tst_QAVPlayer::cast2QVideoFrameFormats()
+{
+    QFETCH(AVPixelFormat, from);
+
+    QAVPlayer p;
+    QFileInfo file(testData("colors.mp4"));
+    p.setSource(file.absoluteFilePath());
+
+    QAVVideoFrame frame;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&frame](const QAVVideoFrame &f) { frame = f; });
+
+    p.pause();
+    QTRY_VERIFY(frame);
+
+    auto converted = frame.convertTo(from);
+    QCOMPARE(converted.format(), from);
+    const quint64 fallbacks = QAVVideoFrame::conversionFallbackCount();
+    QVideoFrame q = converted;
+    QVERIFY(q.isValid());
+    QCOMPARE(q.size(), frame.size());
+    // Mapped directly without CPU conversion
+    QCOMPARE(QAVVideoFrame::conversionFallbackCount(), fallbacks);
+}
+
 void tst_QAVPlayer::audioOutput()
 {
     QFileInfo file1(testData("guido.mp4"));
@@ -1891,6 +3084,217 @@ void tst_QAVPlayer::audioOutput()
     QCOMPARE(af.data(), frame.data());
 }
 
+void tst_QAVPlayer::audioOutputDevice()
+{
+    QAVAudioFormat fmt;
+    fmt.setSampleFormat(QAVAudioFormat::Int16);
+    fmt.setSampleRate(48000);
+    fmt.setChannelCount(2);
+
+    QAVAudioOutputDevice dev;
+    dev.setCapacity(10000);
+    QCOMPARE(dev.capacity(), 10000);
+    dev.open(QIODevice::ReadOnly);
+    dev.start();
+
+    char buf[6000];
+    dev.play(QAVAudioFrame(fmt, QByteArray(4000, 1)));
+    QCOMPARE(dev.bytesInQueue(), quint64(4000));
+    QCOMPARE(dev.readData(buf, 3000), 3000);
+    QCOMPARE(QByteArray(buf, 3000), QByteArray(3000, 1));
+    QCOMPARE(dev.underruns(), quint64(0));
+
+    // Not enough data is filled by silence
+    QCOMPARE(dev.readData(buf, 2000), 2000);
+    QCOMPARE(QByteArray(buf, 1000), QByteArray(1000, 1));
+    QCOMPARE(QByteArray(buf + 1000, 1000), QByteArray(1000, 0));
+    QCOMPARE(dev.underruns(), quint64(1));
+    QCOMPARE(dev.readData(buf, 100), 100);
+    QCOMPARE(dev.underruns(), quint64(1));
+
+    // Wraps around the ring
+    dev.play(QAVAudioFrame(fmt, QByteArray(6000, 2)));
+    dev.play(QAVAudioFrame(fmt, QByteArray(3000, 3)));
+    QCOMPARE(dev.bytesInQueue(), quint64(9000));
+    QCOMPARE(dev.readData(buf, 6000), 6000);
+    QCOMPARE(QByteArray(buf, 6000), QByteArray(6000, 2));
+    QCOMPARE(dev.readData(buf, 3000), 3000);
+    QCOMPARE(QByteArray(buf, 3000), QByteArray(3000, 3));
+    QCOMPARE(dev.underruns(), quint64(1));
+
+    // The producer waits for free space until nothing reads the data anymore
+    dev.play(QAVAudioFrame(fmt, QByteArray(10000, 5)));
+    std::atomic_bool played {false};
+    auto future = QtConcurrent::run([&] {
+        dev.play(QAVAudioFrame(fmt, QByteArray(1000, 6)));
+        played = true;
+    });
+    QTest::qWait(50);
+    QVERIFY(!played);
+    QCOMPARE(dev.readData(buf, 500), 500);
+    QTRY_COMPARE(dev.bytesInQueue(), quint64(10000));
+    QVERIFY(!played);
+    dev.pause();
+    QTRY_VERIFY(played);
+    future.waitForFinished();
+    QCOMPARE(dev.bytesInQueue(), quint64(10000));
+
+    // Resized while nothing writes, the queued data is dropped
+    dev.setCapacity(20000);
+    QCOMPARE(dev.capacity(), 20000);
+    QCOMPARE(dev.bytesInQueue(), quint64(0));
+    dev.start();
+
+    dev.play(QAVAudioFrame(fmt, QByteArray(1000, 4)));
+    dev.stop();
+    QCOMPARE(dev.readData(buf, 500), 500);
+    QCOMPARE(QByteArray(buf, 500), QByteArray(500, 0));
+    QCOMPARE(dev.bytesInQueue(), quint64(0));
+}
+
+void tst_QAVPlayer::audioOutputPlayedPts()
+{
+    QAVPlayer p;
+    QMutex mutex;
+    QList<QAVAudioFrame> frames;
+    std::atomic_int received {0};
+    QObject::connect(&p, &QAVPlayer::audioFrame, &p, [&](const QAVAudioFrame &f) {
+        QMutexLocker locker(&mutex);
+        if (frames.size() < 2)
+            frames.append(f);
+        received = frames.size();
+    }, Qt::DirectConnection);
+
+    std::atomic_int clockCalls {0};
+    p.setMasterClock([&clockCalls] { ++clockCalls; return NAN; });
+
+    QFileInfo file(testData("colors.mp4"));
+    p.setSource(file.absoluteFilePath());
+    p.play();
+    QTRY_COMPARE(received.load(), 2);
+    QTRY_VERIFY(!qIsNaN(p.syncOffset()));
+    QVERIFY(clockCalls > 0);
+    p.stop();
+    QMutexLocker locker(&mutex);
+
+    QAVAudioOutputDevice dev;
+    dev.open(QIODevice::ReadOnly);
+    dev.start();
+    QVERIFY(qIsNaN(dev.playedPts()));
+
+    auto &f = frames.first();
+    const double duration = double(f.frame()->nb_samples) / f.format().sampleRate();
+    const int bytes = f.data().size();
+    dev.play(f);
+    dev.play(frames.last());
+    QCOMPARE(dev.playedPts(), f.pts());
+
+    QVector<char> buf(bytes);
+    dev.readData(buf.data(), bytes / 2);
+    QVERIFY(qAbs(dev.playedPts() - (f.pts() + duration / 2)) < 0.001);
+
+    // The sink still keeps the data
+    dev.setSinkBufferSize(bytes / 2);
+    QCOMPARE(dev.playedPts(), f.pts());
+}
+
+void tst_QAVPlayer::audioOutputPlayOverBuffer()
+{
+    QAVAudioFormat fmt;
+    fmt.setSampleFormat(QAVAudioFormat::Int16);
+    fmt.setSampleRate(48000);
+    fmt.setChannelCount(2);
+    const QAVAudioFrame frame(fmt, QByteArray(64, 0));
+    fmt.setSampleRate(44100);
+    const QAVAudioFrame other(fmt, QByteArray(64, 0));
+
+    QAVAudioOutput out;
+    out.setVolume(0);
+    // The queue is always over the buffer size, every frame checks if the output must be reset
+    out.setBufferSize(64);
+    std::atomic<int> played {0};
+    auto future = QtConcurrent::run([&] {
+        for (int i = 0; i < 1000; ++i) {
+            // One frame in another format, the output is recreated for it and back
+            if (out.play(i == 500 ? other : frame))
+                ++played;
+        }
+    });
+
+    // The ring is not reallocated under a running sink, it is resized when the output is recreated
+    QTRY_VERIFY(played > 100);
+    out.setBufferSize(0);
+    out.setBufferSize(1024 * 1024);
+
+    // Neither the pending resets nor a missing audio device block the producer
+    QTRY_VERIFY(future.isFinished());
+    QCOMPARE(played.load(), 1000);
+    out.stop();
+}
+
+void tst_QAVPlayer::audioOutputPlayBenchmark()
+{
+    QAVAudioFormat fmt;
+    fmt.setSampleFormat(QAVAudioFormat::Int16);
+    fmt.setSampleRate(48000);
+    fmt.setChannelCount(2);
+    const QAVAudioFrame frame(fmt, QByteArray(64, 0));
+
+    QAVAudioOutput out;
+    out.setVolume(0);
+    // The queue is always over the buffer size, every frame checks if the output must be reset
+    out.setBufferSize(64);
+    QVERIFY(out.play(frame));
+    QBENCHMARK {
+        for (int i = 0; i < 100; ++i)
+            out.play(frame);
+    }
+    out.stop();
+}
+
+void tst_QAVPlayer::audioOutputLatency_data()
+{
+    QTest::addColumn<int>("sampleRate");
+    QTest::addColumn<int>("channels");
+    QTest::addColumn<int>("sampleFormat");
+
+    QTest::newRow("48 kHz stereo") << 48000 << 2 << int(QAVAudioFormat::Int16);
+    // More than the ring is sized for before the format is known
+    QTest::newRow("192 kHz 8ch") << 192000 << 8 << int(QAVAudioFormat::Float);
+}
+
+void tst_QAVPlayer::audioOutputLatency()
+{
+    QFETCH(int, sampleRate);
+    QFETCH(int, channels);
+    QFETCH(int, sampleFormat);
+
+    QAVAudioFormat fmt;
+    fmt.setSampleFormat(QAVAudioFormat::SampleFormat(sampleFormat));
+    fmt.setSampleRate(sampleRate);
+    fmt.setChannelCount(channels);
+    const int bytes = sampleFormat == QAVAudioFormat::Float ? 4 : 2;
+    // 10 ms
+    const QAVAudioFrame frame(fmt, QByteArray(sampleRate * channels * bytes / 100, 0));
+
+    QAVAudioOutput out;
+    out.setVolume(0);
+    QCOMPARE(out.latency(), 0);
+    QCOMPARE(out.measuredLatency(), -1);
+    const int latency = 40;
+    out.setLatency(latency);
+    QCOMPARE(out.latency(), latency);
+
+    for (int i = 0; i < 50; ++i) {
+        QVERIFY(out.play(frame));
+        QVERIFY(out.measuredLatency() >= 0);
+    }
+    // Half of the latency is queued, the rest is in the sink which could round its buffer up
+    const int measured = out.measuredLatency();
+    QVERIFY2(measured >= latency / 2 - 1 && measured <= latency + 25, qPrintable(QString::number(measured)));
+    out.stop();
+}
+
 void tst_QAVPlayer::multiPlayers()
 {
     QFileInfo file(testData("av_sample.mkv"));
@@ -2595,6 +3999,592 @@ void tst_QAVPlayer::filesIOSequential()
     QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
 }
 
+void tst_QAVPlayer::filesIOReadMode_data()
+{
+    QTest::addColumn<QAVIODevice::ReadMode>("mode");
+    QTest::addColumn<bool>("buffer");
+    QTest::addColumn<bool>("direct");
+
+    QTest::newRow("auto") << QAVIODevice::AutoRead << false << true;
+    QTest::newRow("owner thread") << QAVIODevice::OwnerThreadRead << false << false;
+    QTest::newRow("direct") << QAVIODevice::DirectRead << false << true;
+    QTest::newRow("mapped") << QAVIODevice::MappedRead << false << true;
+    QTest::newRow("auto buffer") << QAVIODevice::AutoRead << true << false;
+    QTest::newRow("direct buffer") << QAVIODevice::DirectRead << true << true;
+}
+
+void tst_QAVPlayer::filesIOReadMode()
+{
+    QFETCH(QAVIODevice::ReadMode, mode);
+    QFETCH(bool, buffer);
+    QFETCH(bool, direct);
+
+    QFileInfo fileInfo(testData("colors.mp4"));
+    QSharedPointer<QIODevice> file(new QFile(fileInfo.absoluteFilePath()));
+    if (!file->open(QIODevice::ReadOnly)) {
+        QFAIL("Could not open");
+        return;
+    }
+    if (buffer) {
+        QSharedPointer<QBuffer> data(new QBuffer);
+        data->setData(file->readAll());
+        QVERIFY(data->open(QIODevice::ReadOnly));
+        file = data;
+    }
+
+    int expected = 0;
+    {
+        QAVDemuxer d;
+        QVERIFY(d.load(fileInfo.absoluteFilePath()) >= 0);
+        while (d.read())
+            ++expected;
+    }
+    QVERIFY(expected > 0);
+
+    QSharedPointer<QAVIODevice> dev(new QAVIODevice(file));
+    dev->setReadMode(mode);
+    QCOMPARE(dev->isDirectRead(), direct);
+
+    // The demuxer runs on its own thread, owner thread reads are served by this event loop
+    int packets = 0;
+    std::unique_ptr<QThread> thread(QThread::create([&] {
+        QAVDemuxer d;
+        if (d.load(fileInfo.fileName(), dev.data()) < 0)
+            return;
+        while (d.read())
+            ++packets;
+    }));
+    QEventLoop loop;
+    QObject::connect(thread.get(), &QThread::finished, &loop, &QEventLoop::quit);
+    thread->start();
+    loop.exec();
+    thread->wait();
+    // Every read mode gives the same packets as the demuxer reading the file itself
+    QCOMPARE(packets, expected);
+}
+
+void tst_QAVPlayer::filesIOReadModeBenchmark_data()
+{
+    QTest::addColumn<QAVIODevice::ReadMode>("mode");
+
+    QTest::newRow("owner thread") << QAVIODevice::OwnerThreadRead;
+    QTest::newRow("direct") << QAVIODevice::DirectRead;
+    QTest::newRow("mapped") << QAVIODevice::MappedRead;
+}
+
+void tst_QAVPlayer::filesIOReadModeBenchmark()
+{
+    QFETCH(QAVIODevice::ReadMode, mode);
+
+    QFileInfo fileInfo(testData("colors.mp4"));
+    QSharedPointer<QIODevice> file(new QFile(fileInfo.absoluteFilePath()));
+    QVERIFY(file->open(QIODevice::ReadOnly));
+
+    qint64 bytes = 0;
+    qint64 elapsed = 0;
+    QBENCHMARK {
+        QSharedPointer<QAVIODevice> dev(new QAVIODevice(file));
+        dev->setReadMode(mode);
+        file->seek(0);
+
+        // The demuxer runs on its own thread, owner thread reads are served by this event loop
+        QElapsedTimer timer;
+        timer.start();
+        int packets = 0;
+        std::unique_ptr<QThread> thread(QThread::create([&] {
+            QAVDemuxer d;
+            if (d.load(fileInfo.fileName(), dev.data()) < 0)
+                return;
+            while (d.read())
+                ++packets;
+        }));
+        QEventLoop loop;
+        QObject::connect(thread.get(), &QThread::finished, &loop, &QEventLoop::quit);
+        thread->start();
+        loop.exec();
+        thread->wait();
+        elapsed += timer.nsecsElapsed();
+        bytes += file->size();
+        QVERIFY(packets > 0);
+    }
+
+    qDebug() << "Throughput:" << bytes / 1024.0 / 1024.0 * 1e9 / qMax<qint64>(elapsed, 1) << "MiB/s";
+}
+
+// All bytes from the current position of the context
+static QByteArray avioReadAll(AVIOContext *ctx)
+{
+    QByteArray result;
+    unsigned char buf[4096];
+    int bytes = 0;
+    while ((bytes = avio_read(ctx, buf, sizeof(buf))) > 0)
+        result.append(reinterpret_cast<const char *>(buf), bytes);
+    return result;
+}
+
+void tst_QAVPlayer::filesIOMapped()
+{
+    QFile source(testData("colors.mp4"));
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    const QByteArray data = source.readAll();
+    const int half = data.size() / 2;
+
+    QTemporaryDir dir;
+    const QString path = dir.filePath(QLatin1String("colors.mp4"));
+    QFile writer(path);
+    QVERIFY(writer.open(QIODevice::WriteOnly));
+    QCOMPARE(writer.write(data.constData(), half), qint64(half));
+    writer.flush();
+
+    QSharedPointer<QFile> file(new QFile(path));
+    QVERIFY(file->open(QIODevice::ReadOnly));
+    QAVIODevice mapped(file);
+    mapped.setReadMode(QAVIODevice::MappedRead);
+    QVERIFY(mapped.isDirectRead());
+
+    QSharedPointer<QFile> regularFile(new QFile(path));
+    QVERIFY(regularFile->open(QIODevice::ReadOnly));
+    QAVIODevice regular(regularFile);
+    regular.setReadMode(QAVIODevice::DirectRead);
+
+    // Seeked after mapping, both start from there
+    QVERIFY(file->seek(100));
+    QVERIFY(regularFile->seek(100));
+    const QByteArray first = avioReadAll(mapped.ctx());
+    QCOMPARE(first, data.mid(100, half - 100));
+    QCOMPARE(avioReadAll(regular.ctx()), first);
+
+    // The file grows while it is read
+    QCOMPARE(writer.write(data.constData() + half, data.size() - half), qint64(data.size() - half));
+    writer.flush();
+    avio_seek(mapped.ctx(), 0, SEEK_SET);
+    avio_seek(regular.ctx(), 0, SEEK_SET);
+    QCOMPARE(avio_size(mapped.ctx()), avio_size(regular.ctx()));
+    QCOMPARE(avio_size(mapped.ctx()), qint64(data.size()));
+    const QByteArray all = avioReadAll(mapped.ctx());
+    QCOMPARE(all.size(), data.size());
+    QVERIFY(all == data);
+    QVERIFY(avioReadAll(regular.ctx()) == all);
+}
+
+// Float PCM wav with silence
+static bool writeWav(const QString &path, int rate, int channels, int seconds)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    const quint32 bytes = quint32(rate) * channels * 4 * seconds;
+    QByteArray header;
+    QDataStream out(&header, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.writeRawData("RIFF", 4);
+    out << quint32(36 + bytes);
+    out.writeRawData("WAVEfmt ", 8);
+    out << quint32(16) << quint16(3) << quint16(channels) << quint32(rate)
+        << quint32(rate * channels * 4) << quint16(channels * 4) << quint16(32);
+    out.writeRawData("data", 4);
+    out << bytes;
+    file.write(header);
+    const QByteArray second(rate * channels * 4, 0);
+    for (int i = 0; i < seconds; ++i)
+        file.write(second);
+    return true;
+}
+
+class CountingFile : public QFile
+{
+public:
+    using QFile::QFile;
+    int reads = 0;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        ++reads;
+        return QFile::readData(data, maxSize);
+    }
+};
+
+void tst_QAVPlayer::filesIOBufferSize_data()
+{
+    QTest::addColumn<int>("bufferSize");
+    QTest::addColumn<bool>("adaptive");
+
+    QTest::newRow("64 KiB") << 64 * 1024 << false;
+    QTest::newRow("1 MiB") << 1024 * 1024 << false;
+    QTest::newRow("adaptive") << 64 * 1024 << true;
+}
+
+void tst_QAVPlayer::filesIOBufferSize()
+{
+    QFETCH(int, bufferSize);
+    QFETCH(bool, adaptive);
+
+    // 8 float channels at 384 kHz is about 100 Mbit/s
+    QTemporaryDir dir;
+    const QString path = dir.filePath(QLatin1String("100mbit.wav"));
+    QVERIFY(writeWav(path, 384000, 8, 3));
+
+    QSharedPointer<CountingFile> file(new CountingFile(path));
+    QVERIFY(file->open(QIODevice::ReadOnly));
+    QAVIODevice dev(file);
+    dev.setBufferSize(bufferSize);
+    dev.setAdaptiveBufferSize(adaptive);
+    QCOMPARE(dev.ctx()->buffer_size, bufferSize);
+    // The context is used by the demuxer now
+    dev.setBufferSize(bufferSize * 2);
+    QCOMPARE(int(dev.bufferSize()), bufferSize);
+
+    QAVDemuxer d;
+    QVERIFY(d.load(QLatin1String("100mbit.wav"), &dev) >= 0);
+    qint64 bytes = 0;
+    QAVPacket packet;
+    while ((packet = d.read()))
+        bytes += packet.packet()->size;
+    // All samples are read
+    QCOMPARE(bytes, qint64(384000) * 8 * 4 * 3);
+
+    // The device is read in chunks of the buffer size, or bigger ones while adaptive
+    const qint64 chunks = file->size() / bufferSize;
+    if (adaptive)
+        QVERIFY2(file->reads < chunks / 4, qPrintable(QString::number(file->reads)));
+    else
+        QVERIFY2(file->reads <= chunks * 2 + 16, qPrintable(QString::number(file->reads)));
+}
+
+void tst_QAVPlayer::filesIOBufferSizeBenchmark_data()
+{
+    QTest::addColumn<int>("bufferSize");
+    QTest::addColumn<bool>("adaptive");
+    QTest::addColumn<QAVIODevice::ReadMode>("mode");
+
+    QTest::newRow("64 KiB") << 64 * 1024 << false << QAVIODevice::DirectRead;
+    QTest::newRow("1 MiB") << 1024 * 1024 << false << QAVIODevice::DirectRead;
+    QTest::newRow("adaptive") << 64 * 1024 << true << QAVIODevice::DirectRead;
+    QTest::newRow("64 KiB owner thread") << 64 * 1024 << false << QAVIODevice::OwnerThreadRead;
+    QTest::newRow("adaptive owner thread") << 64 * 1024 << true << QAVIODevice::OwnerThreadRead;
+}
+
+void tst_QAVPlayer::filesIOBufferSizeBenchmark()
+{
+    QFETCH(int, bufferSize);
+    QFETCH(bool, adaptive);
+    QFETCH(QAVIODevice::ReadMode, mode);
+
+    // 8 float channels at 384 kHz is about 100 Mbit/s
+    QTemporaryDir dir;
+    const QString path = dir.filePath(QLatin1String("100mbit.wav"));
+    QVERIFY(writeWav(path, 384000, 8, 3));
+
+    qint64 bytes = 0;
+    qint64 elapsed = 0;
+    int reads = 0;
+    QBENCHMARK {
+        QSharedPointer<CountingFile> file(new CountingFile(path));
+        QVERIFY(file->open(QIODevice::ReadOnly));
+        QAVIODevice dev(file);
+        dev.setBufferSize(bufferSize);
+        dev.setAdaptiveBufferSize(adaptive);
+        dev.setReadMode(mode);
+
+        // The demuxer runs on its own thread, owner thread reads are served by this event loop
+        QElapsedTimer timer;
+        timer.start();
+        qint64 demuxed = 0;
+        std::unique_ptr<QThread> thread(QThread::create([&] {
+            QAVDemuxer d;
+            if (d.load(QLatin1String("100mbit.wav"), &dev) < 0)
+                return;
+            QAVPacket packet;
+            while ((packet = d.read()))
+                demuxed += packet.packet()->size;
+        }));
+        QEventLoop loop;
+        QObject::connect(thread.get(), &QThread::finished, &loop, &QEventLoop::quit);
+        thread->start();
+        loop.exec();
+        thread->wait();
+        elapsed += timer.nsecsElapsed();
+        QCOMPARE(demuxed, qint64(384000) * 8 * 4 * 3);
+        bytes += file->size();
+        reads += file->reads;
+    }
+
+    qDebug() << "Throughput:" << bytes / 1024.0 / 1024.0 * 1e9 / qMax<qint64>(elapsed, 1) << "MiB/s"
+             << "reads:" << reads;
+}
+
+// Slow storage: every read takes time and returns at most 32 KiB
+class ThrottledDevice : public QIODevice
+{
+public:
+    ThrottledDevice(const QByteArray &data) : m_data(data) { }
+    bool isSequential() const override { return false; }
+    qint64 size() const override { return m_data.size(); }
+    std::atomic<int> reads{0};
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        ++reads;
+        QThread::msleep(2);
+        const qint64 bytes = qMin(qMin<qint64>(maxSize, 32 * 1024), m_data.size() - pos());
+        memcpy(data, m_data.constData() + pos(), size_t(qMax<qint64>(bytes, 0)));
+        return qMax<qint64>(bytes, 0);
+    }
+
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    QByteArray m_data;
+};
+
+void tst_QAVPlayer::filesIOReadAhead_data()
+{
+    QTest::addColumn<QAVIODevice::ReadMode>("mode");
+
+    QTest::newRow("direct") << QAVIODevice::DirectRead;
+    // Custom devices are read by the owner's event loop
+    QTest::newRow("owner thread") << QAVIODevice::AutoRead;
+}
+
+void tst_QAVPlayer::filesIOReadAhead()
+{
+    QFETCH(QAVIODevice::ReadMode, mode);
+
+    QFile file(testData("1.dv"));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray data = file.readAll();
+
+    // The demuxer runs on its own thread, owner thread reads are served by this event loop
+    auto demux = [](QAVIODevice &dev, int &packets) {
+        bool ok = false;
+        std::unique_ptr<QThread> thread(QThread::create([&] {
+            QAVDemuxer d;
+            if (d.load(QLatin1String("1.dv"), &dev) < 0)
+                return;
+            packets = 0;
+            while (d.read())
+                ++packets;
+            // Short backward seek is served from the ring
+            if (d.seek(0) < 0)
+                return;
+            int again = 0;
+            while (d.read())
+                ++again;
+            ok = again == packets;
+        }));
+        QEventLoop loop;
+        QObject::connect(thread.get(), &QThread::finished, &loop, &QEventLoop::quit);
+        thread->start();
+        loop.exec();
+        thread->wait();
+        return ok;
+    };
+
+    QSharedPointer<ThrottledDevice> direct(new ThrottledDevice(data));
+    QVERIFY(direct->open(QIODevice::ReadOnly));
+    QAVIODevice directDev(direct);
+    directDev.setReadMode(QAVIODevice::DirectRead);
+    int directPackets = 0;
+    QVERIFY(demux(directDev, directPackets));
+    QCOMPARE(directDev.readAheadSize(), 0);
+    QCOMPARE(directDev.cacheHits(), 0u);
+
+    QSharedPointer<ThrottledDevice> throttled(new ThrottledDevice(data));
+    QVERIFY(throttled->open(QIODevice::ReadOnly));
+    QAVIODevice dev(throttled);
+    dev.setReadAheadSize(8 * 1024 * 1024);
+    // The ring is refilled on the thread of the new mode
+    dev.setReadMode(mode);
+    QCOMPARE(dev.readAheadSize(), 8 * 1024 * 1024);
+    int packets = 0;
+    QVERIFY(demux(dev, packets));
+    QCOMPARE(packets, directPackets);
+    QVERIFY(dev.cacheHits() > 0);
+    // The whole file fits into the ring, it is read from the device once
+    QVERIFY2(throttled->reads < direct->reads, qPrintable(QString::number(throttled->reads.load())));
+}
+
+void tst_QAVPlayer::pushData()
+{
+    // Program stream could be demuxed without seeking
+    QFile file(testData("star_trails.mpeg"));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+
+    QAVPlayer p;
+    // Smaller than the file to hit the backpressure
+    p.setPushBufferSize(16 * 1024);
+    std::atomic<int> full {0};
+    std::atomic<int> ready {0};
+    QObject::connect(&p, &QAVPlayer::pushBufferFull, &p, [&] { ++full; }, Qt::DirectConnection);
+    QObject::connect(&p, &QAVPlayer::pushBufferReady, &p, [&] { ++ready; }, Qt::DirectConnection);
+    int framesCount = 0;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &f) { if (f) ++framesCount; });
+    QSignalSpy spy(&p, &QAVPlayer::sourceChanged);
+
+    QVERIFY(!p.pushData(QByteArray(10, 0)));
+    p.setPushSource();
+    QCOMPARE(p.source(), QLatin1String("push:"));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toString(), QLatin1String("push:"));
+    // Restarted without changing the source
+    p.setPushSource();
+    QCOMPARE(spy.count(), 1);
+    p.play();
+
+    while (!file.atEnd()) {
+        const auto bytes = file.read(4 * 1024);
+        QTRY_VERIFY(p.pushData(bytes));
+    }
+    p.endPush();
+
+    QTRY_VERIFY(framesCount > 10);
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QVERIFY(full.load() > 0);
+    QVERIFY(ready.load() > 0);
+}
+
+void tst_QAVPlayer::pushPacket()
+{
+    QAVDemuxer d;
+    QVERIFY(d.load(testData("colors.mp4")) >= 0);
+    QVERIFY(!d.currentVideoStreams().isEmpty());
+    const auto stream = d.currentVideoStreams().first();
+
+    QAVPlayer p;
+    const int index = p.addPushStream(stream.stream()->codecpar, stream.stream()->time_base);
+    QCOMPARE(index, 0);
+    int framesCount = 0;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &f) { if (f) ++framesCount; });
+    p.setPushSource();
+    QTRY_COMPARE(p.mediaStatus(), QAVPlayer::LoadedMedia);
+    QCOMPARE(p.availableVideoStreams().size(), 1);
+    QVERIFY(p.availableAudioStreams().isEmpty());
+    // Pushed packets are recorded as demuxed ones
+    QTemporaryDir dir;
+    const QString path = dir.filePath(QLatin1String("pushed.mkv"));
+    QVERIFY(p.startRecording(path));
+    p.play();
+
+    int pushed = 0;
+    QAVPacket pkt;
+    while ((pkt = d.read())) {
+        if (pkt.packet()->stream_index != stream.index())
+            continue;
+        QTRY_VERIFY(p.pushPacket(index, pkt.packet()));
+        ++pushed;
+    }
+    QVERIFY(pushed > 0);
+    p.endPush();
+
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QCOMPARE(framesCount, pushed);
+
+    p.stopRecording(false);
+    QTRY_VERIFY(!p.isRecording());
+    QVERIFY(p.recordedBytes() > 0);
+    QCOMPARE(p.recordedBytes(), QFileInfo(path).size());
+    QAVDemuxer out;
+    QVERIFY(out.load(path) >= 0);
+    QCOMPARE(out.currentVideoStreams().size(), 1);
+}
+
+void tst_QAVPlayer::timeshift()
+{
+    // Pushed program stream is a live source without seeking
+    QFile file(testData("star_trails.mpeg"));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray data = file.readAll();
+
+    QAVPlayer p;
+    QCOMPARE(p.timeshiftDuration(), 0);
+    p.setTimeshiftDuration(60);
+    QCOMPARE(p.timeshiftDuration(), 60);
+
+    QAVVideoFrame frame;
+    int framesCount = 0;
+    QObject::connect(&p, &QAVPlayer::videoFrame, &p, [&](const QAVVideoFrame &f) { frame = f; ++framesCount; });
+    qint64 seekPos = -1;
+    QObject::connect(&p, &QAVPlayer::seeked, &p, [&](qint64 pos) { seekPos = pos; });
+
+    p.setPushSource();
+    p.play();
+    const int half = data.size() / 2;
+    for (int i = 0; i < half; i += 4 * 1024)
+        QTRY_VERIFY(p.pushData(data.mid(i, qMin(4 * 1024, half - i))));
+    QTRY_VERIFY(framesCount > 5);
+
+    p.pause();
+    QTRY_COMPARE(p.state(), QAVPlayer::PausedState);
+    const double pausedPts = frame.pts();
+    const qint64 pausedEnd = p.timeshiftEnd();
+    // The source is read while paused
+    for (int i = half; i < data.size(); i += 4 * 1024)
+        QTRY_VERIFY(p.pushData(data.mid(i, 4 * 1024)));
+    p.endPush();
+    QTRY_VERIFY(p.timeshiftEnd() > pausedEnd);
+    QVERIFY(p.timeshiftStart() < p.timeshiftEnd());
+    QCOMPARE(p.mediaStatus(), QAVPlayer::LoadedMedia);
+
+    // Rewinds within the buffer
+    p.play();
+    p.seek(p.timeshiftStart());
+    QTRY_VERIFY(seekPos >= 0);
+    framesCount = 0;
+    QTRY_VERIFY(framesCount > 0);
+    QVERIFY(frame.pts() < pausedPts);
+
+    // Catches up to live and reaches the end
+    p.seek(-1);
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+}
+
+void tst_QAVPlayer::recording_data()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<QString>("format");
+
+    QTest::newRow("mp4") << QString("out.mp4") << QString();
+    QTest::newRow("mkv") << QString("out.mkv") << QString();
+    QTest::newRow("ts") << QString("out.ts") << QString();
+    QTest::newRow("format") << QString("out") << QString("matroska");
+}
+
+void tst_QAVPlayer::recording()
+{
+    QFETCH(QString, fileName);
+    QFETCH(QString, format);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(fileName);
+
+    QAVPlayer p;
+    QVERIFY(!p.startRecording(path, format));
+    p.setSource(testData("colors.mp4"));
+    QTRY_COMPARE(p.mediaStatus(), QAVPlayer::LoadedMedia);
+    QVERIFY(p.startRecording(path, format));
+    QVERIFY(p.isRecording());
+    p.play();
+
+    // Stops at the end of media
+    QTRY_COMPARE_WITH_TIMEOUT(p.mediaStatus(), QAVPlayer::EndOfMedia, 20000);
+    QTRY_VERIFY(!p.isRecording());
+    QVERIFY(p.recordedBytes() > 0);
+    QCOMPARE(p.recordedBytes(), QFileInfo(path).size());
+    QCOMPARE(p.droppedRecordingBytes(), qint64(0));
+
+    QAVDemuxer src;
+    QVERIFY(src.load(testData("colors.mp4")) >= 0);
+    QAVDemuxer out;
+    QVERIFY(out.load(path) >= 0);
+    QCOMPARE(out.currentVideoStreams().size(), src.currentVideoStreams().size());
+    QCOMPARE(out.currentAudioStreams().size(), src.currentAudioStreams().size());
+    QVERIFY(qAbs(out.duration() - src.duration()) < 1);
+}
+
 void tst_QAVPlayer::subfile()
 {
     QAVPlayer p;